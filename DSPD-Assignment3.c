@@ -2,29 +2,95 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <time.h>
+#include <limits.h>
+
+// x86 builds get SSE2/AVX2 node search kernels, picked at runtime
+#if defined(__GNUC__) && defined(__SSE2__)
+#include <immintrin.h>
+#define KEY_SEARCH_SIMD 1
+#endif
+
+// Cache prefetch hint; a no-op on compilers without the builtin
+#if defined(__GNUC__)
+#define PREFETCH(addr) __builtin_prefetch(addr)
+#else
+#define PREFETCH(addr) ((void)(addr))
+#endif
 
 #define MAX_NAME_LENGTH 50
-#define MAX_MEMBERS 4
+#define SCAN_MEMBERS 4 // Users one scan filter or member cursor takes; larger families go a group at a time
+#define FAMILY_INLINE_MEMBERS 2 // Members a family holds in place; more move to a heap array
 #define MAX_KEYS 4
-#define MIN_KEYS 3
+#define MIN_KEYS 1 // Fewest keys in a non-root family node; the delete's merges need 2*MIN_KEYS+1 <= MAX_KEYS
 #define DATE_LENGTH 11
-#define MAX_USERS 1000
 #define MAX_FAMILIES 100
-#define MAX_EXPENSES 1000
 #define MAX_CHILDREN 5
 #define MAX_CATEGORY 5
 //#define MAX_KEYS (MAX_CHILDREN-1) // Max keys in a B-Tree Node
 
+// Fanout of the expense B+ tree, independent of the family B-tree's MAX_KEYS.
+// Override at build time, e.g. -DEXPENSE_LEAF_KEYS=64 -DEXPENSE_INNER_KEYS=256
+#ifndef EXPENSE_LEAF_KEYS
+#define EXPENSE_LEAF_KEYS 32   // Expense records per leaf
+#endif
+#ifndef EXPENSE_INNER_KEYS
+#define EXPENSE_INNER_KEYS 64  // Separator keys per internal node
+#endif
+#if EXPENSE_LEAF_KEYS < 3 || EXPENSE_INNER_KEYS < 3
+#error "Expense B+ tree needs at least 3 keys per node"
+#endif
+#define EXPENSE_INNER_CHILDREN (EXPENSE_INNER_KEYS + 1)
+#define EXPENSE_LEAF_MIN (EXPENSE_LEAF_KEYS / 2)   // Fewest records a non-root leaf keeps after a delete
+#define EXPENSE_INNER_MIN (EXPENSE_INNER_KEYS / 2) // Fewest keys a non-root internal node keeps after a delete
+// How full bulkInsert packs each node, in percent (lower leaves room for later inserts)
+#ifndef EXPENSE_BULK_FILL_PERCENT
+#define EXPENSE_BULK_FILL_PERCENT 100
+#endif
+
+//Money amounts and incomes are held as whole cents in a long long, so totals are exact
+//whatever the number of rows or the order they are added in; they are only turned into
+//rupees (centsToUnits) to be printed with %.2f, and read in by parseAmountField/unitsToCents
+
 //Structure for the AVL-Tree Node (Users) 
 typedef struct UserNode {
     int user_id; //Unique id:1-1000
     char user_name[MAX_NAME_LENGTH];
-    float income;
+    long long income; //cents
     struct UserNode *left;
     struct UserNode *right;
     int height; //for checking the height of the every updated subtree
+    int slot; //entry in the user slot table
 }UserNode;
 
+// Handle to a user: a slot in the user slot table plus the generation the slot had when
+// the handle was made, so a handle to a deleted user resolves to NULL instead of to
+// whichever user reuses the slot
+typedef struct UserHandle {
+    int slot; // -1 for no user
+    unsigned generation;
+} UserHandle;
+
+#define NO_USER_HANDLE ((UserHandle){ -1, 0 })
+
+// Structure for one slot of the user slot table
+typedef struct UserSlot {
+    UserNode* user;        // NULL while the slot is free
+    unsigned generation;   // Bumped every time the slot is freed
+    int next_free;         // Next free slot while this one is free
+} UserSlot;
+
+// Table of every live user, indexed by slot; the AVL tree indexes the same users by
+// user_id. Freed slots are reused through a free list
+typedef struct UserSlotTable {
+    UserSlot* slots;
+    int capacity;
+    int used;
+    int free_head;
+} UserSlotTable;
+
+UserSlotTable userSlots = {NULL, 0, 0, -1};
+
 //creating an enum for the expense category
 typedef enum
 {
@@ -40,31 +106,284 @@ typedef struct Expense{
     int expense_id;
     int user_id;
     ExpenseCategory category;
-    float amount;
+    long long amount; //cents
     char date[11]; //Format: YYYY-MM-DD
+    int date_key; //date packed as YYYYMMDD by packDate() wherever a record is read in
 }Expense;
 
+//Growable buffer of expense records, used for query results of any size
+typedef struct ExpenseList
+{
+    Expense *items;
+    int count;
+    int capacity;
+} ExpenseList;
+
+//Group-by-day aggregation: expense totals per packed date in an open-addressing table that
+//grows as new days appear, for reports that bucket expenses by day
+typedef struct DayTotal
+{
+    int date_key;   //YYYYMMDD
+    int count;      //records that day; 0 marks an empty slot
+    long long total; //cents
+} DayTotal;
+
+typedef struct DayTotals
+{
+    DayTotal *slots;    //linear probing
+    int capacity;       //power of two
+    int days;
+} DayTotals;
+
+//Top-K selection: a bounded heap holding the K highest scores offered so far, so ranking
+//expenses, users, families or days costs O(n log K) time and K entries of memory
+typedef struct RankedItem
+{
+    int id;         //expense, user or family ID, or a packed date
+    int count;      //records behind the score
+    long long score; //cents
+} RankedItem;
+
+typedef struct TopK
+{
+    RankedItem *items;  //min-heap on the score until topKFinish sorts it
+    int k;
+    int count;
+} TopK;
+
+//What a top-K report ranks
+typedef enum
+{
+    RANK_EXPENSES = 1,
+    RANK_USERS,
+    RANK_FAMILIES,
+    RANK_DAYS
+} RankingKind;
 
+
+//Common header of every B+ tree node; cast to ExpenseInnerNode or ExpenseLeafNode by is_leaf
 typedef struct ExpenseNode
 {
     int num_keys;
-    int keys[MAX_KEYS];
-    Expense expenses[MAX_KEYS];
-    struct ExpenseNode *children[MAX_CHILDREN];
-
-    struct ExpenseNode *next; //for doubly linked list at leaf level
-    struct ExpenseNode *prev;
     int is_leaf;
 } ExpenseNode;
 
+//Summary of a set of expense records: how many there are, their total and the extreme amounts
+typedef struct ExpenseAggregate
+{
+    int count;
+    long long sum; //cents, like the amounts
+    long long min; //min and max are only meaningful when count > 0
+    long long max;
+} ExpenseAggregate;
+
+//Internal node: separator keys, child pointers and a summary of each child's subtree
+typedef struct ExpenseInnerNode
+{
+    ExpenseNode header;
+    int keys[EXPENSE_INNER_KEYS];
+    ExpenseNode *children[EXPENSE_INNER_CHILDREN];
+    ExpenseAggregate aggs[EXPENSE_INNER_CHILDREN]; //aggs[i] covers every record under children[i]
+} ExpenseInnerNode;
+
+//Leaf node: one column per Expense field, so scans only touch the fields they filter on
+typedef struct ExpenseLeafNode
+{
+    ExpenseNode header;
+    int keys[EXPENSE_LEAF_KEYS]; //expense_id column
+    int user_ids[EXPENSE_LEAF_KEYS];
+    ExpenseCategory categories[EXPENSE_LEAF_KEYS];
+    long long amounts[EXPENSE_LEAF_KEYS]; //cents
+    char dates[EXPENSE_LEAF_KEYS][DATE_LENGTH];
+    int date_keys[EXPENSE_LEAF_KEYS]; //packed dates, compared and filtered on instead of the strings
+
+    struct ExpenseLeafNode *next; //for doubly linked list at leaf level
+    struct ExpenseLeafNode *prev;
+} ExpenseLeafNode;
+
+#define EXP_INNER(node) ((ExpenseInnerNode *)(node))
+#define EXP_LEAF(node) ((ExpenseLeafNode *)(node))
+
+//Position of one record in the leaf chain; leaf is NULL once the cursor runs off either end
+typedef struct ExpenseCursor
+{
+    ExpenseLeafNode *leaf;
+    int index;
+} ExpenseCursor;
+
+// Cached rightmost path of the expense tree, used to append increasing IDs without a descent
+#define EXPENSE_MAX_HEIGHT 48
+typedef struct ExpenseTailHint
+{
+    ExpenseNode *root;
+    ExpenseNode *spine[EXPENSE_MAX_HEIGHT]; //spine[0] is the root, spine[height-1] the tail leaf
+    int height;
+    unsigned long version; //expenseTreeVersion the spine was taken at
+} ExpenseTailHint;
+
+ExpenseTailHint expenseTailHint = {NULL};
+unsigned long expenseTreeVersion = 0; //bumped by every split, merge, rebuild or free
+int expenseAppendFastPath = 1;
+
+// Secondary indexes over the expense tree. Keys pack (major, expense_id) into one
+// 64-bit value, e.g. (user_id, expense_id), and the expense_id leads back to the record.
+#ifndef EXPENSE_INDEX_KEYS
+#define EXPENSE_INDEX_KEYS 64 // Keys per secondary index node
+#endif
+#define EXPENSE_INDEX_MIN (EXPENSE_INDEX_KEYS / 2)
+
+typedef struct ExpenseIndexNode
+{
+    int num_keys;
+    int is_leaf;
+    long long keys[EXPENSE_INDEX_KEYS];
+    struct ExpenseIndexNode *children[EXPENSE_INDEX_KEYS + 1]; //internal nodes only
+    struct ExpenseIndexNode *next; //leaf chain, leaves only
+    struct ExpenseIndexNode *prev;
+} ExpenseIndexNode;
+
+typedef struct ExpenseIndex
+{
+    ExpenseIndexNode *root;
+    long count;
+    int attached; //kept in step with the expense tree's insert, delete and update paths while set
+} ExpenseIndex;
+
+typedef struct ExpenseIndexCursor
+{
+    ExpenseIndexNode *leaf;
+    int index;
+} ExpenseIndexCursor;
+
+ExpenseIndex userExpenseIndex = {NULL, 0, 0}; //(user_id, expense_id)
+ExpenseIndex dateExpenseIndex = {NULL, 0, 0}; //(date_key, expense_id)
+
+//Per-category bitmaps over expense IDs, roaring style: IDs are split on their high 16 bits
+//into containers, each a sorted array of low halves while sparse and a 65536-bit map once
+//it holds more than BITMAP_ARRAY_MAX of them. A category filter is then a membership test
+//that does not touch the expense leaves.
+#define BITMAP_ARRAY_MAX 4096
+#define BITMAP_WORDS 1024 // 65536 bits
+
+typedef struct BitmapContainer
+{
+    int high;                  //expense_id >> 16
+    int cardinality;
+    int capacity;              //of values, while an array container
+    unsigned short *values;    //sorted low halves; NULL once converted to bits
+    unsigned long long *bits;  //BITMAP_WORDS words; NULL while an array container
+} BitmapContainer;
+
+typedef struct CategoryBitmap
+{
+    BitmapContainer *containers; //sorted by high
+    int count;
+    int capacity;
+    long cardinality;
+} CategoryBitmap;
+
+CategoryBitmap categoryBitmaps[MAX_CATEGORY + 1]; //indexed by category; slot 0 unused
+int categoryBitmapsAttached = 0;
+
+//Row filter for the leaf scan kernel: the owner is one of user_ids, the packed date is in
+//[date_from, date_to] and bit c of category_mask is set for the category c
+#define SCAN_ANY_CATEGORY 0xFFFFFFFFu //lets every category through, even ones out of range
+#define SCAN_MASK_WORDS ((EXPENSE_LEAF_KEYS + 63) / 64)
+
+typedef struct ExpenseScanFilter
+{
+    int member_count;
+    int user_ids[SCAN_MEMBERS]; //a user listed twice is kept at its first position only
+    int date_from;
+    int date_to;
+    unsigned int category_mask;
+} ExpenseScanFilter;
+
+//What a scan adds up over the rows that pass its filter, overall and by member position
+typedef struct ExpenseScanTotals
+{
+    int count;
+    long long sum; //cents
+    int member_counts[SCAN_MEMBERS];
+    long long member_sums[SCAN_MEMBERS];
+} ExpenseScanTotals;
+
+//Walks the expenses of a set of users (one user, or a family's members) that pass a scan
+//filter, in ascending expense ID order, through userExpenseIndex when it is attached,
+//else leaf by leaf with the scan kernel
+typedef struct MemberExpenseCursor
+{
+    ExpenseNode *root;
+    ExpenseScanFilter filter;
+    ExpenseIndexCursor heads[SCAN_MEMBERS]; //next index entry of each member
+    int use_index;
+    ExpenseCursor rec;  //the current record in the expense tree
+    int member;         //which of filter.user_ids the current record belongs to
+    const CategoryBitmap *category; //when set, IDs outside this category are skipped without a visit
+    ExpenseLeafNode *selected_leaf; //the leaf whose rows the kernel last selected
+    unsigned long long selected[SCAN_MASK_WORDS];
+} MemberExpenseCursor;
+
+//Optional month partitions: one B+ tree per calendar month holding that month's records,
+//so month-scoped reports scan only their month. The main tree stays the record of truth
+//(ID lookups, ID-ordered reports, saving), and the partitions follow it through the same
+//maintenance hooks as the secondary indexes.
+typedef struct ExpensePartition
+{
+    int month_key;       //YYYYMM
+    int count;           //records in this month, whether or not its tree is loaded
+    ExpenseNode *root;   //NULL while unloaded
+    int loaded;
+    int frozen;          //compacted by freezeExpensePartition; an insert or delete thaws it
+} ExpensePartition;
+
+typedef struct ExpensePartitionDirectory
+{
+    ExpensePartition *parts; //sorted by month_key
+    int count;
+    int capacity;
+    int attached;
+} ExpensePartitionDirectory;
+
+ExpensePartitionDirectory expensePartitions = {NULL, 0, 0, 0};
+
+//Rollup cube: per (user_id, month, category) sum and count, kept current by applying each
+//insert, delete and edit as a delta. Month 0 holds a user's all-time totals and category 0
+//totals over every category, so each report, and each ranking of users, is a few lookups.
+#ifndef EXPENSE_ROLLUP_INITIAL_SLOTS
+#define EXPENSE_ROLLUP_INITIAL_SLOTS 1024 // Power of two; the table doubles past 70% full
+#endif
+
+typedef struct RollupCell
+{
+    long long key;  //makeIndexKey(user_id, month_key * 8 + category)
+    long long sum;   //cents
+    int count;
+    int used;
+} RollupCell;
+
+typedef struct ExpenseRollup
+{
+    RollupCell *cells;  //open addressing with linear probing
+    int capacity;
+    int used;
+    int attached;
+} ExpenseRollup;
+
+ExpenseRollup expenseRollup = {NULL, 0, 0, 0};
+
 // Structure for Family
 typedef struct Family {
     int family_id;
-    char family_name[MAX_NAME_LENGTH];
     int member_count;
-    UserNode* members[MAX_MEMBERS];  // Array of pointers to UserNode
-    float total_income;
-    float total_monthly_expense;
+    int member_capacity;  // FAMILY_INLINE_MEMBERS while the members are held inline
+    char* family_name;  // Allocated to the name's length
+    long long total_income; //cents
+    long long total_monthly_expense;
+    union {
+        UserHandle inline_members[FAMILY_INLINE_MEMBERS];
+        UserHandle* spilled;  // member_capacity handles once the family outgrows the inline slots
+    } members;  // Handles to the member users, read through familyMemberHandles
 } Family;
 
 // Structure for a B-tree node for families
@@ -83,81 +402,395 @@ typedef struct FamilyTree {
     int count;  // Count of families in the tree
 } FamilyTree;
 
+// Structure for one entry of the user-to-family map (family NULL marks an empty slot)
+typedef struct FamilyOfUser {
+    int user_id;
+    Family* family;
+} FamilyOfUser;
+
+// Hash map from user_id to the family holding that user, kept up to date by family
+// create, load, member removal and delete so lookups don't walk the family tree
+typedef struct UserFamilyMap {
+    FamilyOfUser* slots;
+    int capacity; // Power of two
+    int used;
+} UserFamilyMap;
+
+UserFamilyMap userFamilies = {NULL, 0, 0};
+
+// Family tree whose total_monthly_expense fields the expense hooks keep up to date, or NULL
+FamilyTree* maintainedFamilies = NULL;
+
+// Slab allocator for fixed-size tree nodes: nodes are carved in order from large
+// aligned slabs and recycled through a free list, one pool per node type
+#ifndef NODE_POOL_SLAB_NODES
+#define NODE_POOL_SLAB_NODES 256 // Nodes carved from each slab
+#endif
+
+typedef struct NodeSlab {
+    struct NodeSlab *next; // Slabs are kept in allocation order
+} NodeSlab;
+
+typedef struct NodePool {
+    const char *name;
+    size_t node_size;
+    size_t align;        // Power of two; each node starts on this boundary
+    size_t stride;       // node_size rounded up to align, set on first use
+    NodeSlab *slabs;
+    NodeSlab *current;   // Slab nodes are being carved from
+    char *bump;          // Next never-used node in the current slab
+    char *bump_end;
+    void *free_list;     // Released nodes, linked through their first word
+    long slab_count;
+    long in_use;
+    long peak_in_use;
+    long allocations;    // poolAlloc calls served
+    long releases;       // poolFree calls
+} NodePool;
+
+// stride stays 0 until the first poolAlloc rounds node_size up to align
+#define NODE_POOL_INIT(pool_name, type, pool_align) { \
+    .name = pool_name, .node_size = sizeof(type), .align = pool_align, .stride = 0, \
+    .slabs = NULL, .current = NULL, .bump = NULL, .bump_end = NULL, .free_list = NULL, \
+    .slab_count = 0, .in_use = 0, .peak_in_use = 0, .allocations = 0, .releases = 0 }
+
+NodePool expenseLeafPool = NODE_POOL_INIT("expense leaf", ExpenseLeafNode, 64);
+NodePool expenseInnerPool = NODE_POOL_INIT("expense inner", ExpenseInnerNode, 64);
+NodePool familyNodePool = NODE_POOL_INIT("family node", FamilyNode, 64);
+NodePool userNodePool = NODE_POOL_INIT("user node", UserNode, 8);
+NodePool expenseIndexPool = NODE_POOL_INIT("expense index", ExpenseIndexNode, 64);
+
+//Function prototypes for the node pools
+void* poolAlloc(NodePool* pool);
+void poolFree(NodePool* pool, void* node);
+void poolReleaseAll(NodePool* pool);
+void releaseNodePools(void);
+void printNodePoolStats(void);
+
+// Buffered line reader for the data files: the file is read in large blocks and
+// handed out one line at a time, so the loaders never copy or rescan a line
+#ifndef LOADER_BLOCK_SIZE
+#define LOADER_BLOCK_SIZE (1 << 16) // Bytes read from the file at a time
+#endif
+
+typedef struct LineReader {
+    FILE *file;
+    char *buf;
+    size_t capacity;     // Grows past LOADER_BLOCK_SIZE only for longer lines
+    size_t len;          // Bytes held in buf
+    size_t pos;          // Start of the next line in buf
+    int eof;
+    int line;            // 1-based number of the line last returned, for error messages
+    long bytes;          // Bytes read so far
+} LineReader;
+
+//Function prototypes for the data file tokenizer
+int lineReaderOpen(LineReader *reader, const char *filename);
+int lineReaderNext(LineReader *reader, const char **start, const char **end);
+void lineReaderClose(LineReader *reader);
+void skipBlanks(const char **p, const char *end);
+int isBlankLine(const char *p, const char *end);
+int expectSeparator(const char **p, const char *end, char separator);
+int atLineEnd(const char **p, const char *end);
+int parseIntField(const char **p, const char *end, int *out);
+int parseAmountField(const char **p, const char *end, long long *out);
+double centsToUnits(long long cents);
+long long unitsToCents(double units);
+int parseDateField(const char **p, const char *end, char *date, int *date_key);
+int parseNameField(const char **p, const char *end, char *name);
+
+//Function prototypes for the shared node search kernel (expense and family trees)
+int keyLowerBoundScalar(const int* keys, int n, int key);
+int keyLowerBound(const int* keys, int n, int key);
+int keyUpperBound(const int* keys, int n, int key);
+const char* keySearchKernelName(void);
+
+//Function prototypes for the user slot table
+int acquireUserSlot(UserNode* user);
+void releaseUserSlot(int slot);
+UserHandle userHandleOf(const UserNode* user);
+UserNode* resolveUser(UserHandle handle);
+void releaseUserSlots(void);
+
 //Function prototypes for Users using AVL Trees
-UserNode *createUserNode(int user_id, char* user_name,float income);
-void writeUserToFile(const char* filename, int user_id, char* user_name, float income);
+UserNode *createUserNode(int user_id, char* user_name,long long income);
+void writeUserToFile(const char* filename, int user_id, char* user_name, long long income);
 int getHeight(UserNode *node);
 int getBalanceFactor(UserNode* node);
 struct UserNode *rightRotate(UserNode *y);
 struct UserNode* leftRotate(UserNode* x);
-struct UserNode* insertUser(UserNode* root, int user_id, char* user_name, float income);
+struct UserNode* insertUser(UserNode* root, int user_id, char* user_name, long long income);
 int searchUser(UserNode *root,int user_id);
 struct UserNode* loadUsersFromFile(const char* filename,UserNode* root);
+int parseUserLine(const char *p, const char *end, int *user_id, char *user_name, long long *income);
 void printUserTable(UserNode* root);
-UserNode* updateUser(UserNode* root, int user_id, char* new_name, float new_income);
+UserNode* updateUser(UserNode* root, int user_id, char* new_name, long long new_income);
 UserNode* deleteUserNode(UserNode* root, int user_id);
+UserNode* rebalanceUserNode(UserNode* root);
+UserNode* detachMinUser(UserNode* root, UserNode** minOut);
 void bulkInsert(ExpenseNode** root, Expense* expenses, int count);
-void removeUserFromFamilies(FamilyTree* tree, int user_id);
-// Add this function prototype before removeUserFromFamilies
-void traverseAndUpdateFamilies(FamilyNode* node, int user_id, int* familiesToDelete, int* deleteCount);
+void sortExpensesByID(Expense* expenses, int count);
+ExpenseNode* buildExpenseTree(const Expense* sorted, int count);
+void freeExpenseTree(ExpenseNode* node);
+void freeExpenseNode(ExpenseNode* node);
+void removeUserFromFamilies(FamilyTree* tree, ExpenseNode* expenseRoot, int user_id);
+void removeUsersFromFamilies(FamilyTree* tree, ExpenseNode* expenseRoot, const int* user_ids, int count);
 
 // Function prototypes for Family using B Trees
 Family* createFamilyN(int family_id, const char* family_name);
+int setFamilyName(Family* family, const char* family_name);
+UserHandle* familyMemberHandles(const Family* family);
+int addFamilyMember(Family* family, UserHandle member);
+void removeFamilyMemberAt(Family* family, int j);
+void freeFamily(Family* family);
 FamilyNode* createFamilyNode();
 FamilyTree* createFamilyTree();
-int isUserInAnyFamily(FamilyNode* node, int user_id);
-float calculateTotalMonthlyExpense(ExpenseNode* expenseRoot, Family* family);
+long long calculateTotalMonthlyExpense(ExpenseNode* expenseRoot, Family* family);
 Family* searchFamily(FamilyNode* node, int family_id);
 int findPosition(ExpenseNode *node, int key);
+int findChildIndex(ExpenseNode *node, int key);
 void splitChild(FamilyNode* parent, int index, FamilyNode* child);
 void insertNonFull(FamilyNode* node, int family_id, Family* family);
 void insertFamily(FamilyTree* tree, int family_id, Family* family);
 void writeFamiliesRecursive(FamilyNode* node, FILE* file);
 FamilyTree* loadFamiliesFromFile(const char* filename, UserNode* userRoot);
+int parseFamilyLine(const char *p, const char *end, Family *family, char *name, int *members, int max_members);
 void printFamiliesInNode(FamilyNode* node);
 void printFamiliesTable(FamilyTree* tree);
-void collectExpensesInIDRange(ExpenseNode* node, int start_id, int end_id, int user_id, Expense** expenses, int* count);
-void mergeFamilyNodes(FamilyTree* tree, FamilyNode* parent, int index);
-FamilyNode* findParentNode(FamilyNode* root, FamilyNode* child);
-void balanceFamilyTree(FamilyTree* tree, FamilyNode* node);
-int findFamilyNode(FamilyNode* root, int family_id, FamilyNode** nodeOut, int* indexOut);
+void collectExpensesInIDRange(ExpenseNode* node, int start_id, int end_id, int user_id, ExpenseList* out);
+void borrowFamilyFromLeft(FamilyNode* node, int index);
+void borrowFamilyFromRight(FamilyNode* node, int index);
+void mergeFamilyNodes(FamilyNode* node, int index);
+int fillFamilyChild(FamilyNode* node, int index);
+Family* removeFamilyFromNode(FamilyNode* node, int family_id);
 int deleteFamilyFromTree(FamilyTree* familyTree, int family_id);
+int collectFamilies(FamilyNode* node, Family** out, int count);
+void freeFamilyNodes(FamilyNode* node);
+FamilyNode* buildFamilySubtree(Family** sorted, int count, int height);
+FamilyNode* buildFamilyTree(Family** sorted, int count);
+int deleteFamiliesFromTree(FamilyTree* familyTree, const int* family_ids, int count);
 void Update_or_delete_individual_Family_details(UserNode** userRoot, FamilyTree* familyTree, ExpenseNode* expenseRoot, int id, int is_family, int operation);
-void TraverseAndUpdateFamilies(FamilyNode* node, ExpenseNode* expenses, int user_id);
+
+//Function prototypes for the user-to-family map
+Family* familyOfUser(int user_id);
+int growUserFamilies(void);
+int setFamilyOfUser(int user_id, Family* family);
+void clearFamilyOfUser(int user_id, Family* family);
+void mapFamilyMembers(Family* family);
+void unmapFamilyMembers(Family* family);
+int findMemberIndex(const Family* family, int user_id);
+UserNode* familyMember(const Family* family, int j);
+long long familyMemberIncome(const Family* family);
+void releaseUserFamilies(void);
+
+//Function prototypes for the maintained family expense totals
+void resetFamilyExpenseTotals(FamilyNode* node);
+void attachFamilyExpenseTotals(FamilyTree* tree, ExpenseNode* root);
+void detachFamilyExpenseTotals(void);
+void familyExpenseChanged(const Expense* expense, int sign);
+long long userExpenseTotal(ExpenseNode* root, int user_id);
+void familyMemberLeaving(Family* family, ExpenseNode* root, int user_id);
+void verifyFamilyTotalsInNode(FamilyNode* node, ExpenseNode* root, int* mismatches);
+int verifyFamilyExpenseTotals(FamilyTree* tree, ExpenseNode* root);
 
 
 //Function prototypes for Expenses using B + Trees
 ExpenseNode *createLeafNode();
+ExpenseNode *createExpenseNode(int isLeaf);
+int *expenseNodeKeys(ExpenseNode *node);
+Expense getLeafExpense(ExpenseLeafNode *leaf, int i);
+void setLeafExpense(ExpenseLeafNode *leaf, int i, Expense expense);
+void copyLeafRow(ExpenseLeafNode *to, int dst, ExpenseLeafNode *from, int src);
+void combineExpenseAggregate(ExpenseAggregate *into, const ExpenseAggregate *from);
+void addAmountToAggregate(ExpenseAggregate *into, long long amount);
+ExpenseAggregate leafRowsAggregate(const ExpenseLeafNode *leaf, int from, int to);
+ExpenseAggregate expenseNodeAggregate(ExpenseNode *node);
+void refreshChildAggregate(ExpenseInnerNode *parent, int index);
+void refreshExpenseAggregatesOnPath(ExpenseNode *node, int expense_id);
+void aggregateExpenseSubtree(ExpenseNode *node, int start_id, int end_id, int check_start, int check_end, ExpenseAggregate *out);
+ExpenseAggregate aggregateExpenseRange(ExpenseNode *root, int start_id, int end_id);
+ExpenseLeafNode *leftmostExpenseLeaf(ExpenseNode *root);
+ExpenseLeafNode *findExpenseLeaf(ExpenseNode *root, int expense_id);
+ExpenseLeafNode *rightmostExpenseLeaf(ExpenseNode *root);
+void prefetchExpenseLeaf(const ExpenseLeafNode *leaf);
+ExpenseCursor expenseCursorFirst(ExpenseNode *root);
+ExpenseCursor expenseCursorLast(ExpenseNode *root);
+ExpenseCursor expenseCursorSeek(ExpenseNode *root, int expense_id);
+int expenseCursorValid(const ExpenseCursor *cursor);
+void expenseCursorNext(ExpenseCursor *cursor);
+void expenseCursorPrev(ExpenseCursor *cursor);
+int expenseCursorKey(const ExpenseCursor *cursor);
+Expense expenseCursorGet(const ExpenseCursor *cursor);
+int expenseCursorNextBatch(ExpenseCursor *cursor, Expense *out, int max);
+int expenseCursorPrevBatch(ExpenseCursor *cursor, Expense *out, int max);
 int SearchExpenseID(ExpenseNode *root,int expense_id);
+void insertIntoLeaf(ExpenseLeafNode *leaf, Expense newExpense);
+ExpenseLeafNode *splitLeafNode(ExpenseLeafNode *leaf, Expense newExpense, int *pNewKey);
+ExpenseLeafNode *splitLeafNodeAt(ExpenseLeafNode *leaf, Expense newExpense, int splitPoint, int *pNewKey);
+void insertIntoInternal(ExpenseInnerNode *node, int key, ExpenseNode *rightChild, int pos);
+ExpenseInnerNode *splitInternalNode(ExpenseInnerNode *node, int key, ExpenseNode *rightChild, int pos, int *pNewKey);
+ExpenseInnerNode *splitInternalNodeAt(ExpenseInnerNode *node, int key, ExpenseNode *rightChild, int pos, int mid, int *pNewKey);
+void refreshExpenseTailHint(ExpenseNode *root);
+ExpenseNode *appendExpenseToTail(ExpenseNode *root, Expense newExpense);
+ExpenseNode *InsertExpenseRoot(ExpenseNode *root, Expense newExpense, int *pDuplicate);
+ExpenseNode *insertExpenseIntoTree(ExpenseNode *root, Expense newExpense, int *pDuplicate);
+int removeExpenseFromTree(ExpenseNode **root, int expense_id);
+int storeExpenseInTree(ExpenseNode *root, Expense updated, Expense *previous);
+int ValidateExpenseTree(ExpenseNode *node, int is_root, int *min_key, int *max_key);
+int ExpenseTreeHeight(ExpenseNode *root);
 int CountExpenses(ExpenseNode *root);
 ExpenseNode *InsertExpense(ExpenseNode *node,Expense newExpense,int *pNewKey,ExpenseNode **pNewChild, int *pDuplicate);
 void writeExpensesToFile(ExpenseNode *root,const char *filename);
 void readExpensesFromFile(ExpenseNode **root,const char *filename);
+int parseExpenseLine(const char *p, const char *end, Expense *out);
 const char* getCategoryName(ExpenseCategory category);
 void printExpensesTable(ExpenseNode* root);
-int isDateInRange(const char* date, const char* start_date, const char* end_date);
+int packDate(const char* date);
+int isDateInRange(int date_key, int start_key, int end_key);
 void printExpenseDetails(Expense expense);
-void collectExpensesInDateRange(ExpenseNode* node, const char* start_date, const char* end_date, Expense** expenses, int* count);
-Expense* FindExpenseByID(ExpenseNode* root, int expense_id);
+void collectExpensesInDateRange(ExpenseNode* node, int start_key, int end_key, ExpenseCategory category, ExpenseList* out);
+void initExpenseList(ExpenseList* list);
+int appendExpenseToList(ExpenseList* list, Expense expense);
+void freeExpenseList(ExpenseList* list);
+unsigned long long mixHash64(unsigned long long h);
+void initDayTotals(DayTotals* totals);
+int growDayTotals(DayTotals* totals);
+int addDayTotal(DayTotals* totals, int date_key, long long amount);
+void freeDayTotals(DayTotals* totals);
+int initTopK(TopK* top, int k);
+int rankedItemAhead(const RankedItem* a, const RankedItem* b);
+void siftDownRanked(RankedItem* heap, int count, int i);
+void topKOffer(TopK* top, int id, int count, long long score);
+int topKFinish(TopK* top);
+void freeTopK(TopK* top);
+void offerDayTotals(const DayTotals* totals, TopK* top);
+int FindExpenseByID(ExpenseNode* root, int expense_id, Expense* out);
+int UpdateExpenseRecord(ExpenseNode* root, Expense updated);
 void DeleteExpense(ExpenseNode** root, int expense_id);
-void UpdateFamilyExpenses(FamilyTree* tree, ExpenseNode* expenses, int user_id);
 void DeleteExpense(ExpenseNode** root, int expense_id);
-void UpdateFamilyExpenses(FamilyTree* tree, ExpenseNode* expenses, int user_id);
+int deleteExpenseFromNode(ExpenseNode* node, int expense_id);
+void rebalanceExpenseChild(ExpenseInnerNode* parent, int index);
+int DeleteExpenseRange(ExpenseNode** root, int start_id, int end_id);
+
+//Function prototypes for the secondary expense indexes
+long long makeIndexKey(int major, int expense_id);
+int indexKeyExpenseID(long long key);
+int indexKeyMajor(long long key);
+ExpenseIndexNode *createIndexNode(int isLeaf);
+int indexKeyLowerBound(const long long *keys, int n, long long key);
+int indexChildIndex(const ExpenseIndexNode *node, long long key);
+ExpenseIndexNode *indexInsertIntoNode(ExpenseIndexNode *node, long long key, long long *pUpKey, int *pAdded);
+void expenseIndexInsert(ExpenseIndex *index, long long key);
+void indexRebalanceChild(ExpenseIndexNode *parent, int index);
+int indexDeleteFromNode(ExpenseIndexNode *node, long long key);
+void expenseIndexDelete(ExpenseIndex *index, long long key);
+void freeIndexNodes(ExpenseIndexNode *node);
+void expenseIndexBuild(ExpenseIndex *index, const long long *sorted, int count);
+ExpenseIndexCursor expenseIndexSeek(const ExpenseIndex *index, long long key);
+int expenseIndexValid(const ExpenseIndexCursor *cursor);
+long long expenseIndexKey(const ExpenseIndexCursor *cursor);
+void expenseIndexNext(ExpenseIndexCursor *cursor);
+void buildIndexFromTree(ExpenseIndex *index, ExpenseNode *root, int byDate);
+void attachExpenseIndexes(ExpenseNode *root);
+void detachExpenseIndexes(void);
+void sortIndexKeys(long long *keys, int count);
+void indexExpenseInserted(const Expense *expense);
+void indexExpenseRemoved(const Expense *expense);
+void indexExpenseUpdated(const Expense *previous, const Expense *updated);
+void reindexExpenses(ExpenseNode *root);
+ExpenseCursor seekExpenseFrom(ExpenseNode *root, ExpenseCursor from, int expense_id);
+void memberCursorSettle(MemberExpenseCursor *cursor);
+MemberExpenseCursor memberCursorOpen(ExpenseNode *root, const ExpenseScanFilter *filter, int start_id, int use_index);
+MemberExpenseCursor memberCursorStart(ExpenseNode *root, const int *user_ids, int count, int start_id);
+int familyMemberIDs(const Family *family, int first, int *user_ids);
+MemberExpenseCursor familyCursorStart(ExpenseNode *root, const Family *family, int first);
+MemberExpenseCursor monthMemberCursorStart(ExpenseNode *root, const int *user_ids, int count, int year, int month);
+int memberCursorValid(const MemberExpenseCursor *cursor);
+void memberCursorNext(MemberExpenseCursor *cursor);
+
+//Function prototypes for the leaf scan kernel
+void initScanFilter(ExpenseScanFilter *filter, const int *user_ids, int count);
+void scanFilterMonth(ExpenseScanFilter *filter, int year, int month);
+int scanRowMember(const ExpenseScanFilter *filter, int user_id, int date_key, int category);
+void scanMarkRows(unsigned long long *selected, int row, unsigned int bits);
+int scanLeafRowsScalar(const ExpenseLeafNode *leaf, int from, int to, const ExpenseScanFilter *filter, unsigned long long *selected, ExpenseScanTotals *totals);
+void selectLeafScanKernel(void);
+int scanLeafRows(const ExpenseLeafNode *leaf, int from, int to, const ExpenseScanFilter *filter, unsigned long long *selected, ExpenseScanTotals *totals);
+const char *leafScanKernelName(void);
+int nextSelectedRow(const unsigned long long *selected, int row, int end);
+const CategoryBitmap *scanFilterBitmap(const ExpenseScanFilter *filter);
+void scanExpenseTotals(ExpenseNode *root, const ExpenseScanFilter *filter, int use_index, ExpenseScanTotals *totals);
+void memberExpenseTotals(ExpenseNode *root, const int *user_ids, int count, ExpenseScanTotals *totals);
+void monthMemberTotals(ExpenseNode *root, const int *user_ids, int count, int year, int month, ExpenseScanTotals *totals);
+void categoryMemberTotals(ExpenseNode *root, const int *user_ids, int count, int category, ExpenseScanTotals *totals);
+
+//Function prototypes for the month partitions
+int expenseMonthKey(int date_key);
+ExpensePartition *findExpensePartition(int month_key, int create);
+void dropExpensePartition(ExpensePartition *part);
+void attachExpensePartitions(ExpenseNode *root);
+void detachExpensePartitions(void);
+void partitionExpenseInserted(const Expense *expense);
+void partitionExpenseRemoved(const Expense *expense);
+void partitionExpenseUpdated(const Expense *expense);
+int loadExpensePartition(ExpenseNode *root, ExpensePartition *part);
+int unloadExpensePartition(int month_key);
+int freezeExpensePartition(ExpenseNode *root, int month_key);
+ExpenseNode *expensePartitionRoot(ExpenseNode *root, int year, int month);
+
+//Function prototypes for the rollup cube
+long long rollupKey(int user_id, int month_key, int category);
+RollupCell *rollupFind(ExpenseRollup *rollup, long long key, int create);
+int rollupGrow(ExpenseRollup *rollup);
+int rollupAdd(ExpenseRollup *rollup, long long key, long long amount, int count);
+int rollupApplyExpense(ExpenseRollup *rollup, const Expense *expense, int sign);
+void rollupExpenseChanged(const Expense *expense, int sign);
+int buildExpenseRollup(ExpenseRollup *rollup, ExpenseNode *root);
+void freeExpenseRollup(ExpenseRollup *rollup);
+void attachExpenseRollup(ExpenseNode *root);
+void detachExpenseRollup(void);
+long long rollupTotal(int user_id, int month_key, int category);
+int verifyExpenseRollup(ExpenseNode *root);
+
+//Function prototypes for the top-K rankings
+void rankExpensesByAmount(ExpenseNode *root, int month_key, TopK *top);
+ExpenseRollup *rankingRollup(ExpenseNode *root, int month_key, ExpenseRollup *scratch);
+int rankUsersBySpend(ExpenseNode *root, const Family *family, int month_key, TopK *top);
+void rankFamilySubtree(FamilyNode *node, ExpenseRollup *rollup, int month_key, TopK *top);
+int rankFamiliesBySpend(FamilyTree *familyTree, ExpenseNode *root, int month_key, TopK *top);
+int rankDaysBySpend(ExpenseNode *root, const Family *family, int month_key, TopK *top);
+
+//Function prototypes for the category bitmaps
+int bitmapLowestBit(unsigned long long word);
+int bitmapFindContainer(const CategoryBitmap *bitmap, int high);
+int bitmapArrayLowerBound(const BitmapContainer *container, int low);
+int bitmapContains(const CategoryBitmap *bitmap, int expense_id);
+int bitmapAdd(CategoryBitmap *bitmap, int expense_id);
+void bitmapRemove(CategoryBitmap *bitmap, int expense_id);
+int bitmapNextFrom(const CategoryBitmap *bitmap, int expense_id, int *next);
+void freeCategoryBitmap(CategoryBitmap *bitmap);
+void categoryExpenseChanged(const Expense *expense, int sign);
+void attachCategoryBitmaps(ExpenseNode *root);
+void detachCategoryBitmaps(void);
+const CategoryBitmap *categoryBitmapFor(int category);
+MemberExpenseCursor categoryMemberCursorStart(ExpenseNode *root, const int *user_ids, int count, int start_id, int category);
+
 // Expense management
 void Update_delete_expense(ExpenseNode** expenseRoot, FamilyTree* familyTree, UserNode* userRoot, const char* expensesFile, const char* familiesFile);
-Expense* FindExpenseByID(ExpenseNode* root, int expense_id);
 void DeleteExpense(ExpenseNode** root, int expense_id);
-void UpdateFamilyExpenses(FamilyTree* tree, ExpenseNode* expenses, int user_id);
 int compareExpenses(const void* a, const void* b);
 
 //Final Functions
 struct UserNode* AddUser(UserNode* root, const char* filename);
 void AddExpense(ExpenseNode** root, const char* filename);
 void get_total_expense(FamilyTree* familyTree, ExpenseNode* expenseRoot, int family_id, int month, int year);
-void get_highest_expense_day(FamilyTree* familyTree, ExpenseNode* expenseRoot, int family_id);
+void get_highest_expense_day(FamilyTree* familyTree, ExpenseNode* expenseRoot, int family_id, int top_k);
+void get_top_rankings(UserNode* userRoot, FamilyTree* familyTree, ExpenseNode* expenseRoot, RankingKind kind, int k, int family_id, int month, int year);
 void get_individual_expense(UserNode* userRoot, ExpenseNode* expenseRoot, int user_id, int month, int year);
 void get_expense_in_period(ExpenseNode* expenseRoot, const char* start_date, const char* end_date);
 void get_expense_in_range(UserNode* userRoot, ExpenseNode* expenseRoot, int expenseID_1, int expenseID_2, int individualID);
+void get_latest_expenses(ExpenseNode* expenseRoot, int n);
+void get_expense_totals_in_range(ExpenseNode* expenseRoot, int expenseID_1, int expenseID_2);
 
 
 void writeUsersRecursive(UserNode* node, FILE* file);
@@ -166,18 +799,266 @@ void writeFamiliesRecursiveToFile(FamilyNode* node, FILE* file);
 void saveFamiliesToFile(FamilyTree* tree, const char* filename,const char* tempFilename);
 
 
+// Scalar lower bound: number of sorted keys strictly smaller than key
+int keyLowerBoundScalar(const int* keys, int n, int key)
+{
+    int i = 0;
+    while (i < n && keys[i] < key) i++;
+    return i;
+}
+
+#ifdef KEY_SEARCH_SIMD
+// SSE2 lower bound: compare 4 keys at a time; the keys are sorted, so the
+// bits set in the movemask are the low lanes and their count is the answer
+int keyLowerBoundSSE2(const int* keys, int n, int key)
+{
+    __m128i needle = _mm_set1_epi32(key);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i block = _mm_loadu_si128((const __m128i*)(keys + i));
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(needle, block)));
+        if (mask != 0xF) return i + __builtin_popcount(mask);
+    }
+    return i + keyLowerBoundScalar(keys + i, n - i, key);
+}
+
+// AVX2 lower bound: same idea with 8 keys per compare
+__attribute__((target("avx2")))
+int keyLowerBoundAVX2(const int* keys, int n, int key)
+{
+    __m256i needle = _mm256_set1_epi32(key);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i block = _mm256_loadu_si256((const __m256i*)(keys + i));
+        int mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(needle, block)));
+        if (mask != 0xFF) return i + __builtin_popcount(mask);
+    }
+    return i + keyLowerBoundSSE2(keys + i, n - i, key);
+}
+#endif
+
+// Kernel chosen on first use from what the CPU supports
+int (*keyLowerBoundImpl)(const int* keys, int n, int key) = NULL;
+const char* keyLowerBoundImplName = "scalar";
+
+void selectKeySearchKernel(void)
+{
+    keyLowerBoundImpl = keyLowerBoundScalar;
+    keyLowerBoundImplName = "scalar";
+#ifdef KEY_SEARCH_SIMD
+    keyLowerBoundImpl = keyLowerBoundSSE2;
+    keyLowerBoundImplName = "sse2";
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        keyLowerBoundImpl = keyLowerBoundAVX2;
+        keyLowerBoundImplName = "avx2";
+    }
+#endif
+}
+
+// Index of the first key >= key (slot of key, or where it would be inserted)
+int keyLowerBound(const int* keys, int n, int key)
+{
+    if (!keyLowerBoundImpl) selectKeySearchKernel();
+    return keyLowerBoundImpl(keys, n, key);
+}
+
+// Index of the first key > key (child to follow when separators go right on equality)
+int keyUpperBound(const int* keys, int n, int key)
+{
+    if (key == INT_MAX) return n;
+    return keyLowerBound(keys, n, key + 1);
+}
+
+// Name of the kernel in use, for reports and benchmarks
+const char* keySearchKernelName(void)
+{
+    if (!keyLowerBoundImpl) selectKeySearchKernel();
+    return keyLowerBoundImplName;
+}
+
+// Start a pool's next slab, reusing slabs kept from before the last reset
+int poolGrow(NodePool* pool)
+{
+    if (pool->stride == 0) {
+        pool->stride = (pool->node_size + pool->align - 1) & ~(pool->align - 1);
+    }
+    NodeSlab* slab = pool->current ? pool->current->next : pool->slabs;
+    if (!slab) {
+        slab = (NodeSlab*)malloc(sizeof(NodeSlab) + pool->align + NODE_POOL_SLAB_NODES * pool->stride);
+        if (!slab) return 0;
+        slab->next = NULL;
+        if (pool->current) {
+            pool->current->next = slab;
+        } else {
+            pool->slabs = slab;
+        }
+        pool->slab_count++;
+    }
+    size_t start = ((size_t)(slab + 1) + pool->align - 1) & ~(pool->align - 1);
+    pool->current = slab;
+    pool->bump = (char*)start;
+    pool->bump_end = pool->bump + NODE_POOL_SLAB_NODES * pool->stride;
+    return 1;
+}
+
+// Take a node from the pool: recycled nodes first, then the next slot of the current slab
+void* poolAlloc(NodePool* pool)
+{
+    void* node = pool->free_list;
+    if (node) {
+        pool->free_list = *(void**)node;
+    } else {
+        if (pool->bump == pool->bump_end && !poolGrow(pool)) return NULL;
+        node = pool->bump;
+        pool->bump += pool->stride;
+    }
+    pool->allocations++;
+    if (++pool->in_use > pool->peak_in_use) pool->peak_in_use = pool->in_use;
+    return node;
+}
+
+// Give a node back to its pool. Once the pool is empty the slabs are carved
+// again from the first one, so a rebuilt tree is laid out in creation order.
+void poolFree(NodePool* pool, void* node)
+{
+    if (!node) return;
+    *(void**)node = pool->free_list;
+    pool->free_list = node;
+    pool->releases++;
+    if (--pool->in_use == 0) {
+        pool->free_list = NULL;
+        pool->current = NULL;
+        pool->bump = pool->bump_end = NULL;
+    }
+}
+
+// Return every slab of a pool to the system at once; all of its nodes become invalid
+void poolReleaseAll(NodePool* pool)
+{
+    NodeSlab* slab = pool->slabs;
+    while (slab) {
+        NodeSlab* next = slab->next;
+        free(slab);
+        slab = next;
+    }
+    pool->slabs = pool->current = NULL;
+    pool->bump = pool->bump_end = NULL;
+    pool->free_list = NULL;
+    pool->slab_count = 0;
+    pool->in_use = 0;
+}
+
+// Release every tree node in the program, e.g. at shutdown
+void releaseNodePools(void)
+{
+    poolReleaseAll(&expenseLeafPool);
+    poolReleaseAll(&expenseInnerPool);
+    poolReleaseAll(&familyNodePool);
+    poolReleaseAll(&userNodePool);
+    releaseUserSlots();
+    poolReleaseAll(&expenseIndexPool);
+    userExpenseIndex.root = NULL;
+    userExpenseIndex.count = 0;
+    dateExpenseIndex.root = NULL;
+    dateExpenseIndex.count = 0;
+    free(expensePartitions.parts); // Their trees went with the pools
+    expensePartitions.parts = NULL;
+    expensePartitions.count = 0;
+    expensePartitions.capacity = 0;
+    expenseTreeVersion++;
+}
+
+// Print memory usage of the node pools
+void printNodePoolStats(void)
+{
+    NodePool* pools[] = { &expenseLeafPool, &expenseInnerPool, &familyNodePool, &userNodePool, &expenseIndexPool };
+    printf("%-14s %10s %10s %8s %12s %12s\n", "Pool", "In use", "Peak", "Slabs", "Reserved KB", "Allocs");
+    for (int i = 0; i < 5; i++) {
+        NodePool* p = pools[i];
+        size_t reserved = p->slab_count * (sizeof(NodeSlab) + p->align + NODE_POOL_SLAB_NODES * p->stride);
+        printf("%-14s %10ld %10ld %8ld %12.1f %12ld\n", p->name, p->in_use, p->peak_in_use,
+               p->slab_count, reserved / 1024.0, p->allocations);
+    }
+}
+
 //Function to create a new user node
-UserNode *createUserNode(int user_id, char* user_name,float income)
+UserNode *createUserNode(int user_id, char* user_name,long long income)
 {
-    UserNode *newNode =(UserNode *)malloc(sizeof(UserNode));
+    UserNode *newNode =(UserNode *)poolAlloc(&userNodePool);
     newNode->user_id=user_id;
     strcpy(newNode->user_name,user_name);
     newNode->income=income;
     newNode->left=newNode->right=NULL;
     newNode->height=1;
+    newNode->slot=acquireUserSlot(newNode);
     return newNode;
 }
 
+// Function to give a user a slot in the slot table; returns the slot, or -1 if memory runs out
+int acquireUserSlot(UserNode* user)
+{
+    if (userSlots.free_head < 0) {
+        int capacity = userSlots.capacity ? userSlots.capacity * 2 : 64;
+        UserSlot* slots = (UserSlot*)realloc(userSlots.slots, capacity * sizeof(UserSlot));
+        if (!slots) {
+            printf("Memory allocation failed\n");
+            return -1;
+        }
+        // Chain the new slots onto the free list, lowest first
+        for (int i = capacity - 1; i >= userSlots.capacity; i--) {
+            slots[i].user = NULL;
+            slots[i].generation = 0;
+            slots[i].next_free = userSlots.free_head;
+            userSlots.free_head = i;
+        }
+        userSlots.slots = slots;
+        userSlots.capacity = capacity;
+    }
+    int slot = userSlots.free_head;
+    userSlots.free_head = userSlots.slots[slot].next_free;
+    userSlots.slots[slot].user = user;
+    userSlots.used++;
+    return slot;
+}
+
+// Function to free a deleted user's slot; bumping the generation makes old handles stale
+void releaseUserSlot(int slot)
+{
+    if (slot < 0 || slot >= userSlots.capacity || !userSlots.slots[slot].user) return;
+    userSlots.slots[slot].user = NULL;
+    userSlots.slots[slot].generation++;
+    userSlots.slots[slot].next_free = userSlots.free_head;
+    userSlots.free_head = slot;
+    userSlots.used--;
+}
+
+// Function to make a handle to a user (NO_USER_HANDLE for NULL)
+UserHandle userHandleOf(const UserNode* user)
+{
+    if (!user || user->slot < 0) return NO_USER_HANDLE;
+    UserHandle handle = { user->slot, userSlots.slots[user->slot].generation };
+    return handle;
+}
+
+// Function to resolve a handle in O(1); NULL if it holds no user or the user was deleted
+UserNode* resolveUser(UserHandle handle)
+{
+    if (handle.slot < 0 || handle.slot >= userSlots.capacity) return NULL;
+    const UserSlot* slot = &userSlots.slots[handle.slot];
+    return slot->generation == handle.generation ? slot->user : NULL;
+}
+
+// Function to drop the slot table, together with the user nodes it points at
+void releaseUserSlots(void)
+{
+    free(userSlots.slots);
+    userSlots.slots = NULL;
+    userSlots.capacity = 0;
+    userSlots.used = 0;
+    userSlots.free_head = -1;
+}
+
 
 int compareExpenses(const void* a, const void* b) {
     const Expense* exp1 = *(const Expense**)a;
@@ -193,16 +1074,12 @@ int CountExpenses(ExpenseNode *root)
     int count=0;
 
     //Find the leftmost leaf node
-    ExpenseNode *node=root;
-    while(node && !node->is_leaf)
-    {
-        node=node->children[0];
-    }
+    ExpenseLeafNode *node=leftmostExpenseLeaf(root);
 
     //Count expenses in all leaf nodes
     while(node)
     {
-        count+=node->num_keys;
+        count+=node->header.num_keys;
         node=node->next;
     }
     return count;
@@ -220,136 +1097,505 @@ void writeExpensesToFile(ExpenseNode *root,const char *filename)
         return;
     }
 
-    ExpenseNode *node = root;
-    while(node && !node->is_leaf)
-    {
-        node = node->children[0];
-    }
-
-    while(node)
+    // Stream the records out in ID order, a batch at a time
+    Expense batch[256];
+    ExpenseCursor cursor = expenseCursorFirst(root);
+    int n;
+    while((n = expenseCursorNextBatch(&cursor, batch, 256)) > 0)
     {
-        for(int i=0; i<node->num_keys;i++)
+        for(int i=0; i<n;i++)
         {
-            fprintf(file, "%d %d %d %.2f %s\n",node->expenses[i].expense_id,node->expenses[i].user_id,node->expenses[i].category,node->expenses[i].amount,node->expenses[i].date);
+            fprintf(file, "%d %d %d %.2f %s\n",batch[i].expense_id,batch[i].user_id,batch[i].category,centsToUnits(batch[i].amount),batch[i].date);
         }
-        node = node->next;
     }
     fclose(file);
 }
 
 //Function to Read Expenses from File
+// Function to open a data file for line-by-line parsing; returns 0 if it cannot be opened
+int lineReaderOpen(LineReader *reader, const char *filename)
+{
+    reader->file = fopen(filename, "rb");
+    if (!reader->file) return 0;
+    reader->buf = (char *)malloc(LOADER_BLOCK_SIZE);
+    if (!reader->buf) {
+        printf("Memory allocation failed\n");
+        fclose(reader->file);
+        return 0;
+    }
+    reader->capacity = LOADER_BLOCK_SIZE;
+    reader->len = 0;
+    reader->pos = 0;
+    reader->eof = 0;
+    reader->line = 0;
+    reader->bytes = 0;
+    return 1;
+}
+
+// Function to get the next line as [*start, *end), without its \n or \r\n;
+// the span stays valid until the next call. Returns 0 at the end of the file
+int lineReaderNext(LineReader *reader, const char **start, const char **end)
+{
+    for (;;) {
+        char *from = reader->buf + reader->pos;
+        char *newline = (char *)memchr(from, '\n', reader->len - reader->pos);
+        if (newline || (reader->eof && reader->pos < reader->len)) {
+            char *stop = newline ? newline : reader->buf + reader->len;
+            reader->pos = stop - reader->buf + (newline ? 1 : 0);
+            if (stop > from && stop[-1] == '\r') stop--;
+            reader->line++;
+            *start = from;
+            *end = stop;
+            return 1;
+        }
+        if (reader->eof) return 0;
+
+        // Keep the partial line at the front and read the next block behind it
+        size_t keep = reader->len - reader->pos;
+        memmove(reader->buf, from, keep);
+        reader->len = keep;
+        reader->pos = 0;
+        if (keep == reader->capacity) {
+            char *grown = (char *)realloc(reader->buf, reader->capacity * 2);
+            if (!grown) {
+                printf("Memory allocation failed\n");
+                reader->eof = 1;
+                continue;
+            }
+            reader->buf = grown;
+            reader->capacity *= 2;
+        }
+        size_t got = fread(reader->buf + reader->len, 1, reader->capacity - reader->len, reader->file);
+        reader->len += got;
+        reader->bytes += (long)got;
+        if (got == 0) reader->eof = 1;
+    }
+}
+
+// Function to close a data file opened with lineReaderOpen
+void lineReaderClose(LineReader *reader)
+{
+    free(reader->buf);
+    reader->buf = NULL;
+    fclose(reader->file);
+    reader->file = NULL;
+}
+
+// Helper function to step over spaces and tabs
+void skipBlanks(const char **p, const char *end)
+{
+    while (*p < end && (**p == ' ' || **p == '\t')) (*p)++;
+}
+
+// Helper function to check for an empty or whitespace-only line
+int isBlankLine(const char *p, const char *end)
+{
+    skipBlanks(&p, end);
+    return p == end;
+}
+
+// Helper function to consume a field separator such as ','
+int expectSeparator(const char **p, const char *end, char separator)
+{
+    skipBlanks(p, end);
+    if (*p == end || **p != separator) return 0;
+    (*p)++;
+    return 1;
+}
+
+// Helper function to check that nothing but blanks is left on the line
+int atLineEnd(const char **p, const char *end)
+{
+    skipBlanks(p, end);
+    return *p == end;
+}
+
+// Function to parse a decimal integer field; returns 0 if there are no digits or it overflows an int
+int parseIntField(const char **p, const char *end, int *out)
+{
+    skipBlanks(p, end);
+    const char *s = *p;
+    int negative = 0;
+    if (s < end && (*s == '-' || *s == '+')) negative = *s++ == '-';
+    const char *digits = s;
+    long long value = 0;
+    while (s < end && *s >= '0' && *s <= '9') {
+        value = value * 10 + (*s++ - '0');
+        if (value > 2147483648LL) return 0;
+    }
+    if (s == digits) return 0;
+    if (negative) value = -value;
+    if (value > INT_MAX) return 0;
+    *out = (int)value;
+    *p = s;
+    return 1;
+}
+
+// Function to parse a fixed-point amount such as 4802.45 into whole cents, rounding any
+// further decimals half away from zero; returns 0 if it has no digits, more than 18 of them,
+// or does not fit
+int parseAmountField(const char **p, const char *end, long long *out)
+{
+    static const long long powersOfTen[] = {
+        1LL, 10LL, 100LL, 1000LL, 10000LL, 100000LL, 1000000LL, 10000000LL, 100000000LL,
+        1000000000LL, 10000000000LL, 100000000000LL, 1000000000000LL, 10000000000000LL,
+        100000000000000LL, 1000000000000000LL, 10000000000000000LL, 100000000000000000LL,
+        1000000000000000000LL
+    };
+    skipBlanks(p, end);
+    const char *s = *p;
+    int negative = 0;
+    if (s < end && (*s == '-' || *s == '+')) negative = *s++ == '-';
+    long long mantissa = 0;
+    int digits = 0, scale = 0;
+    while (s < end && *s >= '0' && *s <= '9') {
+        if (++digits > 18) return 0;
+        mantissa = mantissa * 10 + (*s++ - '0');
+    }
+    if (s < end && *s == '.') {
+        s++;
+        while (s < end && *s >= '0' && *s <= '9') {
+            if (++digits > 18) return 0;
+            mantissa = mantissa * 10 + (*s++ - '0');
+            scale++;
+        }
+    }
+    if (digits == 0) return 0;
+    long long cents;
+    if (scale <= 2) {
+        if (mantissa > LLONG_MAX / powersOfTen[2 - scale]) return 0;
+        cents = mantissa * powersOfTen[2 - scale];
+    } else {
+        cents = (mantissa + 5 * powersOfTen[scale - 3]) / powersOfTen[scale - 2];
+    }
+    *out = negative ? -cents : cents;
+    *p = s;
+    return 1;
+}
+
+// Function to turn cents into rupees for printing; exact to the cent below 2^53 cents
+double centsToUnits(long long cents)
+{
+    return cents / 100.0;
+}
+
+// Function to turn an amount typed in as rupees into cents, rounding to the nearest cent
+long long unitsToCents(double units)
+{
+    return (long long)(units * 100.0 + (units < 0 ? -0.5 : 0.5));
+}
+
+// Function to parse a YYYY-MM-DD date, copying the text and packing it as YYYYMMDD
+int parseDateField(const char **p, const char *end, char *date, int *date_key)
+{
+    skipBlanks(p, end);
+    const char *s = *p;
+    if (end - s < DATE_LENGTH - 1) return 0;
+    int value[3] = {0, 0, 0};
+    int field = 0;
+    for (int i = 0; i < DATE_LENGTH - 1; i++) {
+        if (i == 4 || i == 7) {
+            if (s[i] != '-') return 0;
+            field++;
+        } else if (s[i] >= '0' && s[i] <= '9') {
+            value[field] = value[field] * 10 + (s[i] - '0');
+        } else {
+            return 0;
+        }
+    }
+    if (value[1] < 1 || value[1] > 12 || value[2] < 1 || value[2] > 31) return 0;
+    memcpy(date, s, DATE_LENGTH - 1);
+    date[DATE_LENGTH - 1] = '\0';
+    *date_key = value[0] * 10000 + value[1] * 100 + value[2];
+    *p = s + DATE_LENGTH - 1;
+    return 1;
+}
+
+// Function to parse a name up to the next ',' (or the end of the line), keeping at most
+// MAX_NAME_LENGTH - 1 characters; returns 0 if the name is empty
+int parseNameField(const char **p, const char *end, char *name)
+{
+    skipBlanks(p, end);
+    const char *s = *p;
+    const char *stop = (const char *)memchr(s, ',', end - s);
+    if (!stop) stop = end;
+    if (stop == s) return 0;
+    size_t length = stop - s;
+    if (length > MAX_NAME_LENGTH - 1) length = MAX_NAME_LENGTH - 1;
+    memcpy(name, s, length);
+    name[length] = '\0';
+    *p = stop;
+    return 1;
+}
+
+// Function to parse one expenses.txt line: expense_id user_id category amount YYYY-MM-DD
+int parseExpenseLine(const char *p, const char *end, Expense *out)
+{
+    int category;
+    if (!parseIntField(&p, end, &out->expense_id) ||
+        !parseIntField(&p, end, &out->user_id) ||
+        !parseIntField(&p, end, &category) ||
+        !parseAmountField(&p, end, &out->amount) ||
+        !parseDateField(&p, end, out->date, &out->date_key)) {
+        return 0;
+    }
+    out->category = (ExpenseCategory)category;
+    return atLineEnd(&p, end);
+}
+
 void readExpensesFromFile(ExpenseNode **root,const char *filename)
 {
-    FILE *file = fopen(filename,"r");
-    if(!file) {
+    LineReader reader;
+    if(!lineReaderOpen(&reader, filename)) {
         printf("Could not open file %s\n", filename);
         return;
     }
     if (*root == NULL) {
         *root = createLeafNode();
-        (*root)->is_leaf = 1;
     }
     Expense tempExpense;
-    int tempNewKey;
-    ExpenseNode *tempNewChild = NULL;
-    int duplicate = 0;
     int count = 0;
-    int duplicateCount = 0;
 
-    if(*root == NULL)
+    // Parsed records are collected first and then bulk loaded in one pass
+    int capacity = 256;
+    Expense *parsed = (Expense *)malloc(capacity * sizeof(Expense));
+    if(!parsed)
     {
-        *root = createLeafNode();
+        printf("Memory allocation failed\n");
+        lineReaderClose(&reader);
+        return;
     }
 
-    char line[256]; // Buffer for reading lines
+    const char *line, *lineEnd;
     
     // Read file line by line to avoid getting stuck in any loop
-    while(fgets(line, sizeof(line), file) != NULL)
+    while(lineReaderNext(&reader, &line, &lineEnd))
     {
-        // Check if we have reached the maximum number of expenses
-        if(count >= MAX_EXPENSES)
-        {
-            printf("Warning: Maximum number of expenses (%d) reached. Skipping remaining expenses.\n", MAX_EXPENSES);
-            break;        
-        }
+        if(isBlankLine(line, lineEnd)) continue;
 
         // Parse the line
-        if(sscanf(line, "%d %d %d %f %s", 
-                 &tempExpense.expense_id, 
-                 &tempExpense.user_id, 
-                 (int*)&tempExpense.category, 
-                 &tempExpense.amount, 
-                 tempExpense.date) != 5) {
-            printf("Warning: Invalid format in line. Skipping.\n");
+        if(!parseExpenseLine(line, lineEnd, &tempExpense)) {
+            printf("Warning: Invalid format in %s line %d. Skipping.\n", filename, reader.line);
             continue;
         }
 
-        duplicate = 0;
-        ExpenseNode* tempRoot = *root;
-        ExpenseNode* splitRoot = InsertExpense(tempRoot, tempExpense, &tempNewKey, &tempNewChild, &duplicate);
-        
-        if (duplicate) {
-            duplicateCount++;
-            // Only print the first few duplicate warnings to avoid flooding console
-            if (duplicateCount <= 5) {
-                printf("Warning: Duplicate expense ID %d found in file. Skipping.\n", tempExpense.expense_id);
-            } else if (duplicateCount == 6) {
-                printf("Additional duplicate entries found. Suppressing further warnings.\n");
+        if(count == capacity)
+        {
+            capacity *= 2;
+            Expense *grown = (Expense *)realloc(parsed, capacity * sizeof(Expense));
+            if(!grown)
+            {
+                printf("Memory allocation failed\n");
+                break;
             }
-            continue;
-        }
-        
-        if (splitRoot) {
-            ExpenseNode* newRoot = createLeafNode();
-            newRoot->is_leaf = 0;
-            newRoot->keys[0] = tempNewKey;
-            newRoot->children[0] = tempRoot;
-            newRoot->children[1] = tempNewChild;
-            newRoot->num_keys = 1;
-            *root = newRoot;
+            parsed = grown;
         }
-
-        count++;
+        parsed[count++] = tempExpense;
     }
+    lineReaderClose(&reader);
+
+    int before = CountExpenses(*root);
+    bulkInsert(root, parsed, count);
+    int loaded = CountExpenses(*root) - before;
+    free(parsed);
     
-    printf("Loaded %d expenses from file. Found %d duplicate entries.\n", count, duplicateCount);
-    fclose(file);
+    printf("Loaded %d expenses from file. Found %d duplicate entries.\n", loaded, count - loaded);
 }
 
-
-
-//Function to get category name from enum
-const char* getCategoryName(ExpenseCategory category) {
-    switch(category) {
-        case RENT: return "RENT";
-        case UTILITY: return "UTILITY";
-        case GROCERY: return "GROCERY";
-        case STATIONARY: return "STATIONARY";
-        case LEISURE: return "LEISURE";
-        default: return "UNKNOWN";
+// Stable merge sort of expense records by expense_id (earlier records stay first among equal IDs)
+void sortExpensesByID(Expense* expenses, int count)
+{
+    if (count < 2) return;
+    Expense* temp = (Expense*)malloc(count * sizeof(Expense));
+    if (!temp) {
+        printf("Memory allocation failed\n");
+        exit(1);
+    }
+    for (int width = 1; width < count; width *= 2) {
+        for (int lo = 0; lo < count; lo += 2 * width) {
+            int mid = lo + width < count ? lo + width : count;
+            int hi = lo + 2 * width < count ? lo + 2 * width : count;
+            int i = lo, j = mid, k = lo;
+            while (i < mid && j < hi) {
+                temp[k++] = expenses[j].expense_id < expenses[i].expense_id ? expenses[j++] : expenses[i++];
+            }
+            while (i < mid) temp[k++] = expenses[i++];
+            while (j < hi) temp[k++] = expenses[j++];
+        }
+        memcpy(expenses, temp, count * sizeof(Expense));
     }
+    free(temp);
 }
 
-// Improved search function that prints debug information
-void PrintTreeStructure(ExpenseNode *node, int level) {
-    if (!node) return;
+// Build a B+ tree bottom-up from records sorted by unique expense_id.
+// Nodes are packed to EXPENSE_BULK_FILL_PERCENT and the remainder is spread
+// evenly, so the last node of a level is never left nearly empty.
+ExpenseNode* buildExpenseTree(const Expense* sorted, int count)
+{
+    if (count <= 0) return createLeafNode();
 
-    printf("Level %d: ", level);
-    if (node->is_leaf) {
-        printf("Leaf [");
-    } else {
-        printf("Internal [");
-    }
-    
-    for (int i = 0; i < node->num_keys; i++) {
-        printf("%d", node->keys[i]);
-        if (i < node->num_keys - 1) printf(", ");
+    int perLeaf = EXPENSE_LEAF_KEYS * EXPENSE_BULK_FILL_PERCENT / 100;
+    if (perLeaf < (EXPENSE_LEAF_KEYS + 1) / 2) perLeaf = (EXPENSE_LEAF_KEYS + 1) / 2;
+    if (perLeaf > EXPENSE_LEAF_KEYS) perLeaf = EXPENSE_LEAF_KEYS;
+
+    int nodeCount = (count + perLeaf - 1) / perLeaf;
+    ExpenseNode** level = (ExpenseNode**)malloc(nodeCount * sizeof(ExpenseNode*));
+    int* minKeys = (int*)malloc(nodeCount * sizeof(int));
+    if (!level || !minKeys) {
+        printf("Memory allocation failed\n");
+        exit(1);
     }
-    printf("]\n");
 
-    if (!node->is_leaf) {
+    // Leaf level: fill each leaf and chain it to its neighbours
+    ExpenseLeafNode* prev = NULL;
+    int next = 0;
+    for (int l = 0; l < nodeCount; l++) {
+        int take = count / nodeCount + (l < count % nodeCount ? 1 : 0);
+        ExpenseLeafNode* leaf = EXP_LEAF(createExpenseNode(1));
+        for (int j = 0; j < take; j++) {
+            setLeafExpense(leaf, j, sorted[next++]);
+        }
+        leaf->header.num_keys = take;
+        leaf->prev = prev;
+        if (prev) prev->next = leaf;
+        prev = leaf;
+        level[l] = &leaf->header;
+        minKeys[l] = leaf->keys[0];
+    }
+
+    // Inner levels: group children until a single root remains (arrays are reused in place)
+    int perInner = EXPENSE_INNER_CHILDREN * EXPENSE_BULK_FILL_PERCENT / 100;
+    if (perInner < (EXPENSE_INNER_CHILDREN + 1) / 2) perInner = (EXPENSE_INNER_CHILDREN + 1) / 2;
+    if (perInner > EXPENSE_INNER_CHILDREN) perInner = EXPENSE_INNER_CHILDREN;
+
+    while (nodeCount > 1) {
+        int parents = (nodeCount + perInner - 1) / perInner;
+        int child = 0;
+        for (int p = 0; p < parents; p++) {
+            int take = nodeCount / parents + (p < nodeCount % parents ? 1 : 0);
+            ExpenseInnerNode* inner = EXP_INNER(createExpenseNode(0));
+            int firstKey = minKeys[child];
+            inner->children[0] = level[child];
+            inner->aggs[0] = expenseNodeAggregate(level[child]);
+            for (int k = 1; k < take; k++) {
+                inner->keys[k - 1] = minKeys[child + k];
+                inner->children[k] = level[child + k];
+                inner->aggs[k] = expenseNodeAggregate(level[child + k]);
+            }
+            inner->header.num_keys = take - 1;
+            child += take;
+            level[p] = &inner->header;
+            minKeys[p] = firstKey;
+        }
+        nodeCount = parents;
+    }
+
+    ExpenseNode* root = level[0];
+    free(level);
+    free(minKeys);
+    return root;
+}
+
+// Bulk load expenses: merge with what is already in the tree, sort by ID,
+// drop duplicates in one pass and rebuild the tree bottom-up without splits
+void bulkInsert(ExpenseNode** root, Expense* expenses, int count)
+{
+    int existing = CountExpenses(*root);
+    int total = existing + count;
+    if (total == 0) return;
+
+    Expense* all = (Expense*)malloc(total * sizeof(Expense));
+    if (!all) {
+        printf("Memory allocation failed\n");
+        exit(1);
+    }
+
+    // Existing records go first so they win over duplicates in the new batch
+    ExpenseCursor cursor = expenseCursorFirst(*root);
+    int n = expenseCursorNextBatch(&cursor, all, existing);
+    memcpy(all + n, expenses, count * sizeof(Expense));
+    sortExpensesByID(all, total);
+
+    // Drop duplicates, keeping the first record for each expense_id
+    int unique = 0;
+    int duplicateCount = 0;
+    for (int i = 0; i < total; i++) {
+        if (unique > 0 && all[unique - 1].expense_id == all[i].expense_id) {
+            duplicateCount++;
+            // Only print the first few duplicate warnings to avoid flooding console
+            if (duplicateCount <= 5) {
+                printf("Warning: Duplicate expense ID %d found. Skipping.\n", all[i].expense_id);
+            } else if (duplicateCount == 6) {
+                printf("Additional duplicate entries found. Suppressing further warnings.\n");
+            }
+            continue;
+        }
+        all[unique++] = all[i];
+    }
+
+    // Every record is copied out, so release the old nodes first and let the
+    // new tree reuse their slabs in order
+    freeExpenseTree(*root);
+    *root = buildExpenseTree(all, unique);
+    expenseTreeVersion++;
+    reindexExpenses(*root);
+    free(all);
+}
+
+// Function to free every node of an expense tree
+void freeExpenseTree(ExpenseNode* node)
+{
+    if (!node) return;
+    expenseTreeVersion++;
+    if (!node->is_leaf) {
+        for (int i = 0; i <= node->num_keys; i++) {
+            freeExpenseTree(EXP_INNER(node)->children[i]);
+        }
+    }
+    freeExpenseNode(node);
+}
+
+// Function to return a single expense node to its pool
+void freeExpenseNode(ExpenseNode* node)
+{
+    poolFree(node->is_leaf ? &expenseLeafPool : &expenseInnerPool, node);
+}
+
+
+
+//Function to get category name from enum
+const char* getCategoryName(ExpenseCategory category) {
+    switch(category) {
+        case RENT: return "RENT";
+        case UTILITY: return "UTILITY";
+        case GROCERY: return "GROCERY";
+        case STATIONARY: return "STATIONARY";
+        case LEISURE: return "LEISURE";
+        default: return "UNKNOWN";
+    }
+}
+
+// Improved search function that prints debug information
+void PrintTreeStructure(ExpenseNode *node, int level) {
+    if (!node) return;
+
+    int *keys = expenseNodeKeys(node);
+    printf("Level %d: ", level);
+    if (node->is_leaf) {
+        printf("Leaf [");
+    } else {
+        printf("Internal [");
+    }
+    
+    for (int i = 0; i < node->num_keys; i++) {
+        printf("%d", keys[i]);
+        if (i < node->num_keys - 1) printf(", ");
+    }
+    printf("]\n");
+
+    if (!node->is_leaf) {
         for (int i = 0; i <= node->num_keys; i++) {
-            PrintTreeStructure(node->children[i], level + 1);
+            PrintTreeStructure(EXP_INNER(node)->children[i], level + 1);
         }
     }
 }
@@ -362,30 +1608,23 @@ void printExpensesTable(ExpenseNode* root) {
         return;
     }
     
-    // Find the leftmost leaf node (first node with expenses)
-    ExpenseNode* node = root;
-    while (node && !node->is_leaf) {
-        node = node->children[0];
-    }
-    
     // Print table header
     printf("\n+--------+--------+---------------+----------+------------+\n");
     printf("| Exp ID | User ID |   Category    |  Amount  |    Date    |\n");
     printf("+--------+--------+---------------+----------+------------+\n");
     
-    // Print all expenses in the linked list of leaf nodes
+    // Print all expenses in ID order
     int count = 0;
-    while (node) {
-        for (int i = 0; i < node->num_keys; i++) {
-            printf("| %6d | %6d | %-13s | %8.2f | %-10s |\n", 
-                   node->expenses[i].expense_id, 
-                   node->expenses[i].user_id,
-                   getCategoryName(node->expenses[i].category),
-                   node->expenses[i].amount,
-                   node->expenses[i].date);
-            count++;
-        }
-        node = node->next;
+    for (ExpenseCursor c = expenseCursorFirst(root); expenseCursorValid(&c); expenseCursorNext(&c)) {
+        ExpenseLeafNode* node = c.leaf;
+        int i = c.index;
+        printf("| %6d | %6d | %-13s | %8.2f | %-10s |\n", 
+               node->keys[i], 
+               node->user_ids[i],
+               getCategoryName(node->categories[i]),
+               centsToUnits(node->amounts[i]),
+               node->dates[i]);
+        count++;
     }
     
     // Print table footer
@@ -401,12 +1640,6 @@ void AddExpense(ExpenseNode** root, const char* filename) {
     scanf(" %c", &choice);
     
     while (choice == 'y' || choice == 'Y') {
-        // Check if we've reached the maximum number of expenses
-        if (CountExpenses(*root) >= MAX_EXPENSES) {
-            printf("Maximum number of expenses (%d) reached. Cannot add more.\n", MAX_EXPENSES);
-            return;
-        }
-        
         Expense newExpense;
         int category;
         
@@ -429,31 +1662,22 @@ void AddExpense(ExpenseNode** root, const char* filename) {
         }
         
         printf("Enter Amount: ");
-        scanf("%f", &newExpense.amount);
+        double amount_entered;
+        scanf("%lf", &amount_entered);
+        newExpense.amount = unitsToCents(amount_entered);
         
         printf("Enter Date (YYYY-MM-DD): ");
         scanf("%s", newExpense.date);
+        newExpense.date_key = packDate(newExpense.date);
         
         // Insert the new expense
-        int tempNewKey;
-        ExpenseNode* tempNewChild = NULL;
         int duplicate = 0;
         
-        ExpenseNode* splitRoot = InsertExpense(*root, newExpense, &tempNewKey, &tempNewChild, &duplicate);
+        *root = InsertExpenseRoot(*root, newExpense, &duplicate);
         
         if (duplicate) {
             printf("Warning: Expense ID %d already exists. Please use a different ID.\n", newExpense.expense_id);
         } else {
-            if (splitRoot) {
-                ExpenseNode* newRoot = createLeafNode();
-                newRoot->is_leaf = 0;
-                newRoot->keys[0] = tempNewKey;
-                newRoot->children[0] = *root;
-                newRoot->children[1] = tempNewChild;
-                newRoot->num_keys = 1;
-                *root = newRoot;
-            }
-            
             printf("Added new expense (ID: %d).\n", newExpense.expense_id);
             
             // Save expenses to file
@@ -471,13 +1695,13 @@ void AddExpense(ExpenseNode** root, const char* filename) {
 }
 
 // Function to write a user to the file
-void writeUserToFile(const char* filename, int user_id, char* user_name, float income) {
+void writeUserToFile(const char* filename, int user_id, char* user_name, long long income) {
     FILE* file = fopen(filename, "a");
     if (!file) {
         printf("Error: Unable to open file %s for writing\n", filename);
         return;
     }
-    fprintf(file, "%d, %s, %.2f\n", user_id, user_name, income);
+    fprintf(file, "%d, %s, %.2f\n", user_id, user_name, centsToUnits(income));
     fclose(file);
 }
 
@@ -519,7 +1743,7 @@ struct UserNode* leftRotate(UserNode* x) {
 }
 
 // Insert a node into AVL tree
-struct UserNode* insertUser(UserNode* root, int user_id, char* user_name, float income) 
+struct UserNode* insertUser(UserNode* root, int user_id, char* user_name, long long income) 
 {
     if (!root) return createUserNode(user_id, user_name, income);
 
@@ -564,20 +1788,37 @@ int searchUser(UserNode *root,int user_id)
     return searchUser(root->right,user_id);
 }
 
+// Function to parse one individuals.txt line: user_id, user_name, income
+int parseUserLine(const char *p, const char *end, int *user_id, char *user_name, long long *income)
+{
+    return parseIntField(&p, end, user_id) &&
+           expectSeparator(&p, end, ',') &&
+           parseNameField(&p, end, user_name) &&
+           expectSeparator(&p, end, ',') &&
+           parseAmountField(&p, end, income) &&
+           atLineEnd(&p, end);
+}
+
 // Load users from file and insert into AVL Tree
 struct UserNode* loadUsersFromFile(const char* filename,UserNode* root) {
-    FILE* file = fopen(filename, "r");
-    if (!file) {
+    LineReader reader;
+    if (!lineReaderOpen(&reader, filename)) {
         printf("Error: Unable to open file %s\n", filename);
         return root;
     }
     int user_id;
     char user_name[MAX_NAME_LENGTH];
-    float income;
-    while (fscanf(file, "%d, %49[^,], %f", &user_id, user_name, &income) == 3) {
+    long long income;
+    const char *line, *lineEnd;
+    while (lineReaderNext(&reader, &line, &lineEnd)) {
+        if (isBlankLine(line, lineEnd)) continue;
+        if (!parseUserLine(line, lineEnd, &user_id, user_name, &income)) {
+            printf("Warning: Invalid format in %s line %d. Skipping.\n", filename, reader.line);
+            continue;
+        }
         root = insertUser(root, user_id, user_name, income);
     }
-    fclose(file);
+    lineReaderClose(&reader);
     return root;
 }
 
@@ -586,7 +1827,7 @@ struct UserNode* AddUser(UserNode* root, const char* filename)
 {
     int user_id;
     char user_name[MAX_NAME_LENGTH];
-    float income;
+    double income_entered;
     
     printf("Enter User ID: ");
     scanf("%d", &user_id);
@@ -599,7 +1840,8 @@ struct UserNode* AddUser(UserNode* root, const char* filename)
     printf("Enter User Name: ");
     scanf("%49s", user_name);
     printf("Enter Income: ");
-    scanf("%f", &income);
+    scanf("%lf", &income_entered);
+    long long income = unitsToCents(income_entered);
     
     root = insertUser(root, user_id, user_name, income);
     printf("Successfully inserted a new user!\n");
@@ -611,7 +1853,7 @@ struct UserNode* AddUser(UserNode* root, const char* filename)
 void inOrder(UserNode* root) {
     if (root) {
         inOrder(root->left);
-        printf("| %-5d | %-20s | %-10.2f |\n", root->user_id, root->user_name, root->income);
+        printf("| %-5d | %-20s | %-10.2f |\n", root->user_id, root->user_name, centsToUnits(root->income));
         inOrder(root->right);
     }
 }
@@ -632,22 +1874,43 @@ Family* createFamilyN(int family_id, const char* family_name) {
     Family* family = (Family*)malloc(sizeof(Family));
     if (family) {
         family->family_id = family_id;
-        strncpy(family->family_name, family_name, MAX_NAME_LENGTH - 1);
-        family->family_name[MAX_NAME_LENGTH - 1] = '\0';
+        family->family_name = NULL;
         family->member_count = 0;
-        family->total_income = 0.0;
-        family->total_monthly_expense = 0.0;
-        for (int i = 0; i < MAX_MEMBERS; i++) {
-            family->members[i] = NULL;
+        family->member_capacity = FAMILY_INLINE_MEMBERS;
+        family->total_income = 0;
+        family->total_monthly_expense = 0;
+        for (int i = 0; i < FAMILY_INLINE_MEMBERS; i++) {
+            family->members.inline_members[i] = NO_USER_HANDLE;
+        }
+        if (!setFamilyName(family, family_name)) {
+            free(family);
+            return NULL;
         }
     }
     return family;
 }
 
+// Function to give a family a name, stored at its own length (at most MAX_NAME_LENGTH - 1
+// characters); returns 0 and keeps the old name if memory runs out
+int setFamilyName(Family* family, const char* family_name) {
+    size_t length = strlen(family_name);
+    if (length > MAX_NAME_LENGTH - 1) length = MAX_NAME_LENGTH - 1;
+    char* name = (char*)malloc(length + 1);
+    if (!name) {
+        printf("Memory allocation failed\n");
+        return 0;
+    }
+    memcpy(name, family_name, length);
+    name[length] = '\0';
+    free(family->family_name);
+    family->family_name = name;
+    return 1;
+}
+
 //Function to create a new FamilyNode (B-Tree Node)
 FamilyNode *createFamilyNode()
 {
-    FamilyNode *newNode = (FamilyNode *)malloc(sizeof(FamilyNode));
+    FamilyNode *newNode = (FamilyNode *)poolAlloc(&familyNodePool);
     if(!newNode)
     {
         printf("Memory allocation failed for family node\n");
@@ -687,64 +1950,189 @@ FamilyTree *createFamilyTree()
     return newTree;
 }
 
-// Helper function to check if a user already belongs to any family
-int isUserInAnyFamily(FamilyNode* node, int user_id) {
-    if (!node) return 0;
-    
-    // Check all families in current node
-    for (int i = 0; i < node->num_keys; i++) {
-        Family* family = node->families[i];
-        for (int j = 0; j < family->member_count; j++) {
-            if (family->members[j] && family->members[j]->user_id == user_id) {
-                return 1; // User found in this family
-            }
-        }
+// Function to look up the family a user belongs to, or NULL if the user has none
+Family* familyOfUser(int user_id) {
+    if (userFamilies.capacity == 0) return NULL;
+    int mask = userFamilies.capacity - 1;
+    int slot = (int)(mixHash64((unsigned long long)(unsigned)user_id) & mask);
+    while (userFamilies.slots[slot].family) {
+        if (userFamilies.slots[slot].user_id == user_id) return userFamilies.slots[slot].family;
+        slot = (slot + 1) & mask;
     }
-    
-    // Check all children if not a leaf node
-    if (!node->is_leaf) {
-        for (int i = 0; i <= node->num_keys; i++) {
-            if (isUserInAnyFamily(node->children[i], user_id)) {
-                return 1;
-            }
+    return NULL;
+}
+
+// Helper function to double the user-to-family map and rehash its entries; returns 0 if memory runs out
+int growUserFamilies(void) {
+    int capacity = userFamilies.capacity ? userFamilies.capacity * 2 : 64;
+    FamilyOfUser* slots = (FamilyOfUser*)calloc(capacity, sizeof(FamilyOfUser));
+    if (!slots) {
+        printf("Memory allocation failed\n");
+        return 0;
+    }
+    for (int i = 0; i < userFamilies.capacity; i++) {
+        if (!userFamilies.slots[i].family) continue;
+        int slot = (int)(mixHash64((unsigned long long)(unsigned)userFamilies.slots[i].user_id) & (capacity - 1));
+        while (slots[slot].family) slot = (slot + 1) & (capacity - 1);
+        slots[slot] = userFamilies.slots[i];
+    }
+    free(userFamilies.slots);
+    userFamilies.slots = slots;
+    userFamilies.capacity = capacity;
+    return 1;
+}
+
+// Function to record the family a user belongs to; returns 0 if memory runs out
+int setFamilyOfUser(int user_id, Family* family) {
+    // Keep the map at most 70% full
+    if ((userFamilies.used + 1) * 10 > userFamilies.capacity * 7 && !growUserFamilies()) return 0;
+    int mask = userFamilies.capacity - 1;
+    int slot = (int)(mixHash64((unsigned long long)(unsigned)user_id) & mask);
+    while (userFamilies.slots[slot].family && userFamilies.slots[slot].user_id != user_id) {
+        slot = (slot + 1) & mask;
+    }
+    if (!userFamilies.slots[slot].family) userFamilies.used++;
+    userFamilies.slots[slot].user_id = user_id;
+    userFamilies.slots[slot].family = family;
+    return 1;
+}
+
+// Function to forget a user's family, only if the map still points the user at that family
+void clearFamilyOfUser(int user_id, Family* family) {
+    if (userFamilies.capacity == 0) return;
+    int mask = userFamilies.capacity - 1;
+    int slot = (int)(mixHash64((unsigned long long)(unsigned)user_id) & mask);
+    while (userFamilies.slots[slot].family && userFamilies.slots[slot].user_id != user_id) {
+        slot = (slot + 1) & mask;
+    }
+    if (userFamilies.slots[slot].family != family || !family) return;
+
+    // Shift later entries of the probe run back so lookups never stop at the hole
+    int hole = slot;
+    for (int next = (hole + 1) & mask; userFamilies.slots[next].family; next = (next + 1) & mask) {
+        int home = (int)(mixHash64((unsigned long long)(unsigned)userFamilies.slots[next].user_id) & mask);
+        // Move the entry unless its home slot lies cyclically between the hole and its slot
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            userFamilies.slots[hole] = userFamilies.slots[next];
+            hole = next;
         }
     }
-    
-    return 0; // User not found in any family
+    userFamilies.slots[hole].family = NULL;
+    userFamilies.used--;
 }
 
-//Function to calculate total monthly expenses for a family
-float calculateTotalMonthlyExpense(ExpenseNode *expenseRoot,Family *family)
-{
-    if(!expenseRoot || !family) return 0.0;
+// Function to point every linked member of a family at it
+void mapFamilyMembers(Family* family) {
+    for (int i = 0; i < family->member_count; i++) {
+        UserNode* member = familyMember(family, i);
+        if (member) setFamilyOfUser(member->user_id, family);
+    }
+}
 
-    float totalExpense = 0.0;
+// Function to drop every member of a family from the map before the family goes away
+void unmapFamilyMembers(Family* family) {
+    for (int i = 0; i < family->member_count; i++) {
+        UserNode* member = familyMember(family, i);
+        if (member) clearFamilyOfUser(member->user_id, family);
+    }
+}
 
-    //Find the leftmost leaf node
-    ExpenseNode *node = expenseRoot;
-    while(node && !node->is_leaf)
-    {
-        node = node->children[0];
+// Helper function to find a user's slot in a family's member array, or -1
+int findMemberIndex(const Family* family, int user_id) {
+    for (int j = 0; j < family->member_count; j++) {
+        UserNode* member = familyMember(family, j);
+        if (member && member->user_id == user_id) return j;
     }
+    return -1;
+}
 
-    //Traverse all expense nodes
-    while (node)
-    {
-        for(int i = 0;i < node->num_keys;i++)
-        {
-            //check if the expense belongs to any family member
-            for(int j = 0;j < family->member_count;j++)
-            {
-                if(family->members[j] && node->expenses[i].user_id == family->members[j]->user_id)
-                {
-                    totalExpense += node->expenses[i].amount;
-                }
-            }
+// Function to get a family's member handles, from the inline slots or the heap array
+UserHandle* familyMemberHandles(const Family* family) {
+    if (family->member_capacity > FAMILY_INLINE_MEMBERS) return family->members.spilled;
+    return (UserHandle*)family->members.inline_members;
+}
+
+// Function to append a member to a family. Past the inline slots the members move to a heap
+// array, which doubles as it fills; returns 0 if memory runs out
+int addFamilyMember(Family* family, UserHandle member) {
+    if (family->member_count == family->member_capacity) {
+        int capacity = family->member_capacity * 2;
+        UserHandle* grown;
+        if (family->member_capacity > FAMILY_INLINE_MEMBERS) {
+            grown = (UserHandle*)realloc(family->members.spilled, capacity * sizeof(UserHandle));
+        } else {
+            grown = (UserHandle*)malloc(capacity * sizeof(UserHandle));
+            if (grown) memcpy(grown, family->members.inline_members, sizeof(family->members.inline_members));
+        }
+        if (!grown) {
+            printf("Memory allocation failed\n");
+            return 0;
         }
-        node = node->next;
+        family->members.spilled = grown;
+        family->member_capacity = capacity;
+    }
+    familyMemberHandles(family)[family->member_count++] = member;
+    return 1;
+}
+
+// Function to remove member j of a family, shifting the later members left
+void removeFamilyMemberAt(Family* family, int j) {
+    UserHandle* members = familyMemberHandles(family);
+    for (int k = j; k < family->member_count - 1; k++) {
+        members[k] = members[k + 1];
+    }
+    family->member_count--;
+    members[family->member_count] = NO_USER_HANDLE;
+}
+
+// Function to free a family record along with its name and member array
+void freeFamily(Family* family) {
+    if (!family) return;
+    if (family->member_capacity > FAMILY_INLINE_MEMBERS) free(family->members.spilled);
+    free(family->family_name);
+    free(family);
+}
+
+// Function to resolve member j of a family; NULL for an empty slot or a deleted user
+UserNode* familyMember(const Family* family, int j) {
+    return resolveUser(familyMemberHandles(family)[j]);
+}
+
+// Helper function to add up the incomes of a family's members
+long long familyMemberIncome(const Family* family) {
+    long long total = 0;
+    for (int k = 0; k < family->member_count; k++) {
+        UserNode* member = familyMember(family, k);
+        if (member) total += member->income;
+    }
+    return total;
+}
+
+// Function to release the user-to-family map
+void releaseUserFamilies(void) {
+    free(userFamilies.slots);
+    userFamilies.slots = NULL;
+    userFamilies.capacity = 0;
+    userFamilies.used = 0;
+}
+
+//Function to calculate total monthly expenses for a family
+long long calculateTotalMonthlyExpense(ExpenseNode *expenseRoot,Family *family)
+{
+    if(!expenseRoot || !family) return 0;
+
+    //Add up the family members' expenses, SCAN_MEMBERS members at a time, through the user
+    //index or with the scan kernel
+    long long total = 0;
+    for (int first = 0; first < family->member_count; first += SCAN_MEMBERS) {
+        int member_ids[SCAN_MEMBERS];
+        int member_count = familyMemberIDs(family, first, member_ids);
+        ExpenseScanTotals totals;
+        memberExpenseTotals(expenseRoot, member_ids, member_count, &totals);
+        total += totals.sum;
     }
 
-    return totalExpense;
+    return total;
 }
 
 //Function to search for a family by ID in a B-tree
@@ -752,11 +2140,7 @@ Family *searchFamily(FamilyNode *node,int family_id)
 {
     if(!node) return NULL;
 
-    int i = 0;
-    while(i < node->num_keys && family_id > node->keys[i])
-    {
-        i++;
-    }
+    int i = keyLowerBound(node->keys, node->num_keys, family_id);
 
     if(i < node->num_keys && family_id == node->keys[i])
     {
@@ -847,7 +2231,6 @@ void insertNonFull(FamilyNode* node, int family_id, Family* family) {
         node->keys[i+1] = family_id;
         node->families[i+1] = family;
         node->num_keys++;
-        printf("Inserted family %d into leaf node\n", family_id); // Debug
     } else {
         // Find child position
         while (i >= 0 && family_id < node->keys[i]) i--;
@@ -912,13 +2295,14 @@ void writeFamiliesRecursive(FamilyNode* node, FILE* file) {
         // Write basic family info
         fprintf(file, "%d,%s,%d,%.2f,%.2f", 
               family->family_id, family->family_name, 
-              family->member_count, family->total_income,
-              family->total_monthly_expense);
+              family->member_count, centsToUnits(family->total_income),
+              centsToUnits(family->total_monthly_expense));
         
         // Write member IDs
         for (int j = 0; j < family->member_count; j++) {
-            if (family->members[j]) {
-                fprintf(file, ",%d", family->members[j]->user_id);
+            UserNode* member = familyMember(family, j);
+            if (member) {
+                fprintf(file, ",%d", member->user_id);
             } else {
                 fprintf(file, ",0");
             }
@@ -995,11 +2379,11 @@ void createFamily(FamilyTree* familyTree, UserNode* userRoot, ExpenseNode* expen
         printf("Enter Family Name: ");
         scanf(" %49[^\n]", family_name);
         
-        printf("How many members (1-4): ");
+        printf("How many members: ");
         scanf("%d", &member_count);
         
-        if (member_count < 1 || member_count > MAX_MEMBERS) {
-            printf("Invalid number of members. Family must have 1-%d members.\n", MAX_MEMBERS);
+        if (member_count < 1) {
+            printf("Invalid number of members. Family must have at least 1 member.\n");
             printf("Do you want to create another family? (y/n): ");
             scanf(" %c", &choice);
             continue;
@@ -1018,10 +2402,6 @@ void createFamily(FamilyTree* familyTree, UserNode* userRoot, ExpenseNode* expen
         printf("\nEnter User IDs for family members:\n");
         newFamily->member_count = 0; // Reset to ensure accurate count
         
-        // Array to track user IDs already added to this family
-        int addedUserIds[MAX_MEMBERS] = {0};
-        int addedCount = 0;
-        
         for (int i = 0; i < member_count; i++) {
             int user_id;
             printf("Member %d User ID: ", i + 1);
@@ -1036,34 +2416,24 @@ void createFamily(FamilyTree* familyTree, UserNode* userRoot, ExpenseNode* expen
             }
             
             // Check if user already belongs to another family
-            if (isUserInAnyFamily(familyTree->root, user_id)) {
+            Family* owner = familyOfUser(user_id);
+            if (owner && owner != newFamily) {
                 printf("Error: User ID %d already belongs to another family. Users cannot be in multiple families.\n", user_id);
                 i--; // Retry this member
                 continue;
             }
             
-            // Check if user is already added to this family
-            int isDuplicate = 0;
-            for (int j = 0; j < addedCount; j++) {
-                if (addedUserIds[j] == user_id) {
-                    isDuplicate = 1;
-                    break;
-                }
-            }
-            
-            if (isDuplicate) {
+            // Check if user is already added to this family (members are mapped as they are added)
+            if (owner == newFamily) {
                 printf("Error: User ID %d is already added to this family. Each user can only be added once.\n", user_id);
                 i--; // Retry this member
                 continue;
             }
             
             // Add user to family
-            newFamily->members[i] = user;
-            newFamily->member_count++;
+            if (!addFamilyMember(newFamily, userHandleOf(user))) break;
             newFamily->total_income += user->income;
-            
-            // Track this user ID as added
-            addedUserIds[addedCount++] = user_id;
+            setFamilyOfUser(user_id, newFamily);
         }
         
         // Calculate total monthly expense
@@ -1076,8 +2446,8 @@ void createFamily(FamilyTree* familyTree, UserNode* userRoot, ExpenseNode* expen
         printf("Family ID: %d\n", newFamily->family_id);
         printf("Family Name: %s\n", newFamily->family_name);
         printf("Member Count: %d\n", newFamily->member_count);
-        printf("Total Income: %.2f\n", newFamily->total_income);
-        printf("Total Monthly Expense: %.2f\n", newFamily->total_monthly_expense);
+        printf("Total Income: %.2f\n", centsToUnits(newFamily->total_income));
+        printf("Total Monthly Expense: %.2f\n", centsToUnits(newFamily->total_monthly_expense));
         
         // Save families to file
         writeFamiliesToFile(familyTree, filename);
@@ -1087,57 +2457,80 @@ void createFamily(FamilyTree* familyTree, UserNode* userRoot, ExpenseNode* expen
     }
 }
 
+// Function to parse one families.txt line:
+// family_id, family_name, member_count, total_income, total_monthly_expense, member IDs...
+// The name goes to name (MAX_NAME_LENGTH bytes) and the IDs to members, which holds max_members
+int parseFamilyLine(const char *p, const char *end, Family *family, char *name, int *members, int max_members)
+{
+    if (!parseIntField(&p, end, &family->family_id) ||
+        !expectSeparator(&p, end, ',') ||
+        !parseNameField(&p, end, name) ||
+        !expectSeparator(&p, end, ',') ||
+        !parseIntField(&p, end, &family->member_count) ||
+        !expectSeparator(&p, end, ',') ||
+        !parseAmountField(&p, end, &family->total_income) ||
+        !expectSeparator(&p, end, ',') ||
+        !parseAmountField(&p, end, &family->total_monthly_expense)) {
+        return 0;
+    }
+    if (family->member_count < 0 || family->member_count > max_members) return 0;
+    for (int i = 0; i < family->member_count; i++) {
+        if (!expectSeparator(&p, end, ',') || !parseIntField(&p, end, &members[i])) return 0;
+    }
+    return atLineEnd(&p, end);
+}
+
 // Simple function to load families from a file with improved error handling
 FamilyTree* loadFamiliesFromFile(const char* filename, UserNode* userRoot) {
     FamilyTree* tree = createFamilyTree();
-    FILE* file = fopen(filename, "r");
-    if (!file) return tree;
-
-    char line[256];
-    while (fgets(line, sizeof(line), file)) {
-        // Skip empty/invalid lines
-        if (strlen(line) < 10) continue;
-
-        // Parse using sscanf for structured data
-        int family_id, member_count;
-        char family_name[MAX_NAME_LENGTH];
-        float total_income, total_monthly_expense;
-        int members[MAX_MEMBERS] = {0};
-
-        // Parse first 5 fixed fields
-        int parsed = sscanf(line, "%d,%49[^,],%d,%f,%f", 
-            &family_id, family_name, &member_count, 
-            &total_income, &total_monthly_expense);
-
-        if (parsed != 5) continue;
-
-        // Parse member IDs
-        char* ptr = strchr(line, ',');
-        for (int i = 0; i < 4; i++) ptr = strchr(ptr+1, ','); // Skip first 5 fields
-        ptr++;
+    LineReader reader;
+    if (!lineReaderOpen(&reader, filename)) return tree;
+
+    const char *line, *lineEnd;
+    int *members = NULL;
+    int capacity = 0;
+    while (lineReaderNext(&reader, &line, &lineEnd)) {
+        if (isBlankLine(line, lineEnd)) continue;
+
+        // Every member ID takes at least two characters, so the line bounds the member count
+        int needed = (int)((lineEnd - line) / 2) + 1;
+        if (needed > capacity) {
+            int *grown = (int *)realloc(members, needed * sizeof(int));
+            if (!grown) {
+                printf("Memory allocation failed\n");
+                break;
+            }
+            members = grown;
+            capacity = needed;
+        }
 
-        for (int i = 0; i < member_count && i < MAX_MEMBERS; i++) {
-            if (sscanf(ptr, "%d", &members[i]) != 1) break;
-            ptr = strchr(ptr, ',');
-            if (!ptr) break;
-            ptr++;
+        // Parse the fixed fields and the member IDs in one pass
+        Family parsed;
+        char name[MAX_NAME_LENGTH];
+        if (!parseFamilyLine(line, lineEnd, &parsed, name, members, capacity)) {
+            printf("Warning: Invalid format in %s line %d. Skipping.\n", filename, reader.line);
+            continue;
         }
 
         // Create family
-        Family* family = createFamilyN(family_id, family_name);
-        family->total_income = total_income;
-        family->total_monthly_expense = total_monthly_expense;
-        family->member_count = member_count;
-
-        // Link members
-        for (int i = 0; i < member_count; i++) {
-            family->members[i] = findUserById(userRoot, members[i]);
+        Family* family = createFamilyN(parsed.family_id, name);
+        if (!family) break;
+        family->total_income = parsed.total_income;
+        family->total_monthly_expense = parsed.total_monthly_expense;
+
+        // Link and map members; a user listed twice is kept once
+        for (int i = 0; i < parsed.member_count; i++) {
+            UserNode* user = findUserById(userRoot, members[i]);
+            if (user && familyOfUser(user->user_id) == family) continue;
+            if (!addFamilyMember(family, userHandleOf(user))) break;
+            if (user) setFamilyOfUser(user->user_id, family);
         }
 
         // Insert into B-tree
-        insertFamily(tree, family_id, family);
+        insertFamily(tree, parsed.family_id, family);
     }
-    fclose(file);
+    free(members);
+    lineReaderClose(&reader);
     return tree;
 }
 
@@ -1158,8 +2551,8 @@ void printFamiliesInNode(FamilyNode* node) {
                family->family_id, 
                family->family_name,
                family->member_count,
-               family->total_income,
-               family->total_monthly_expense);
+               centsToUnits(family->total_income),
+               centsToUnits(family->total_monthly_expense));
         
         // Print member information for this family
         printf("+----------+--------------------+--------+---------------+--------------------+\n");
@@ -1169,11 +2562,12 @@ void printFamiliesInNode(FamilyNode* node) {
         printf("+----------+--------------------+---------------+\n");
         
         for (int j = 0; j < family->member_count; j++) {
-            if (family->members[j]) {
+            UserNode* member = familyMember(family, j);
+            if (member) {
                 printf("| %-8d | %-18s | %-13.2f |\n",
-                       family->members[j]->user_id,
-                       family->members[j]->user_name,
-                       family->members[j]->income);
+                       member->user_id,
+                       member->user_name,
+                       centsToUnits(member->income));
             }
         }
         printf("+----------+--------------------+---------------+\n");
@@ -1206,7 +2600,7 @@ int Max(int a, int b) {
 }
 
 // Function to update user details
-UserNode* updateUser(UserNode* root, int user_id, char* new_name, float new_income) {
+UserNode* updateUser(UserNode* root, int user_id, char* new_name, long long new_income) {
     // Find the user node
     UserNode* current = root;
     
@@ -1241,39 +2635,32 @@ void get_total_expense(FamilyTree* familyTree, ExpenseNode* expenseRoot, int fam
     }
     
     // Calculate total expenses for the family in the given month and year
-    float total_expense = 0.0f;
-    float individual_expenses[MAX_MEMBERS] = {0.0f}; // Track expenses for each member
-    
-    // Loop through all expenses in the B+ tree
-    ExpenseNode* current = expenseRoot;
-    
-    // First, find the leftmost leaf node
-    while (current != NULL && !current->is_leaf) {
-        current = current->children[0];
+    long long total_expense = 0;
+    long long* individual_expenses = (long long*)calloc(family->member_count, sizeof(long long)); // Track expenses for each member, in cents
+    if (!individual_expenses && family->member_count > 0) {
+        printf("Memory allocation failed\n");
+        return;
     }
     
-    // Now traverse all leaf nodes
-    while (current != NULL) {
-        for (int i = 0; i < current->num_keys; i++) {
-            Expense expense = current->expenses[i];
-            
-            // Extract month and year from date (format: YYYY-MM-DD)
-            int exp_year, exp_month, exp_day;
-            sscanf(expense.date, "%d-%d-%d", &exp_year, &exp_month, &exp_day);
-            
-            // Check if expense is in the specified month and year
-            if (exp_year == year && exp_month == month) {
-                // Check if this expense belongs to a family member
-                for (int j = 0; j < family->member_count; j++) {
-                    if (expense.user_id == family->members[j]->user_id) {
-                        total_expense += expense.amount;
-                        individual_expenses[j] += expense.amount;
-                        break;
-                    }
-                }
+    // Go through the members SCAN_MEMBERS at a time
+    for (int first = 0; first < family->member_count; first += SCAN_MEMBERS) {
+        int member_ids[SCAN_MEMBERS];
+        int member_count = familyMemberIDs(family, first, member_ids);
+        if (expenseRollup.attached) {
+            // Each member's month total is one rollup lookup, however long the history
+            for (int j = 0; j < member_count; j++) {
+                individual_expenses[first + j] = rollupTotal(member_ids[j], year * 100 + month, 0);
+                total_expense += individual_expenses[first + j];
+            }
+        } else {
+            // Add up the family members' expenses of that month, by member
+            ExpenseScanTotals totals;
+            monthMemberTotals(expenseRoot, member_ids, member_count, year, month, &totals);
+            for (int j = 0; j < member_count; j++) {
+                individual_expenses[first + j] = totals.member_sums[j];
             }
+            total_expense += totals.sum;
         }
-        current = current->next; // Move to the next leaf node
     }
     
     // Print family information
@@ -1282,29 +2669,31 @@ void get_total_expense(FamilyTree* familyTree, ExpenseNode* expenseRoot, int fam
     printf("Family Name: %s\n", family->family_name);
     printf("Total Members: %d\n", family->member_count);
     printf("Period: %d-%d (Month-Year)\n", month, year);
-    printf("Total Family Income: Rs. %.2f\n", family->total_income);
-    printf("Total Monthly Expense: Rs. %.2f\n", total_expense);
+    printf("Total Family Income: Rs. %.2f\n", centsToUnits(family->total_income));
+    printf("Total Monthly Expense: Rs. %.2f\n", centsToUnits(total_expense));
     
     // Compare expense with income and calculate difference
-    float difference = family->total_income - total_expense;
+    long long difference = family->total_income - total_expense;
     
     if (difference >= 0) {
         printf("Status: Expense is WITHIN family income\n");
-        printf("Amount Saved: Rs. %.2f\n", difference);
+        printf("Amount Saved: Rs. %.2f\n", centsToUnits(difference));
     } else {
         printf("Status: Expense EXCEEDS family income\n");
-        printf("Budget Deficit: Rs. %.2f\n", -difference);
+        printf("Budget Deficit: Rs. %.2f\n", centsToUnits(-difference));
     }
     
     // Print individual contribution to expenses
     printf("\nIndividual Members Expenses:\n");
     for (int i = 0; i < family->member_count; i++) {
-        UserNode* member = family->members[i];
+        UserNode* member = familyMember(family, i);
+        if (!member) continue;
         printf("%d. %s (ID: %d) - Income: Rs. %.2f, Expenses: Rs. %.2f\n", 
-               i+1, member->user_name, member->user_id, member->income, individual_expenses[i]);
+               i+1, member->user_name, member->user_id, centsToUnits(member->income), centsToUnits(individual_expenses[i]));
     }
     
     printf("==========================================\n");
+    free(individual_expenses);
 }
 
 // Function to get total family expense for a specific category
@@ -1317,42 +2706,45 @@ void get_categorical_expense(FamilyTree* familyTree, ExpenseNode* expenseRoot, i
     }
     
     // Step 2: Initialize variables to store individual contributions
-    float total_category_expense = 0.0;
+    long long total_category_expense = 0;
     typedef struct {
         int user_id;
         char user_name[MAX_NAME_LENGTH];
-        float expense_amount;
+        long long expense_amount;
     } UserExpense;
     
-    UserExpense member_expenses[MAX_MEMBERS];
-    for (int i = 0; i < family->member_count; i++) {
-        member_expenses[i].user_id = family->members[i]->user_id;
-        strcpy(member_expenses[i].user_name, family->members[i]->user_name);
-        member_expenses[i].expense_amount = 0.0;
-    }
-    
-    // Step 3: Traverse the expense tree to find expenses of the given category for family members
-    ExpenseNode* current = expenseRoot;
-    
-    // Find leftmost leaf node to start traversal
-    while (current && !current->is_leaf) {
-        current = current->children[0];
+    UserExpense* member_expenses = (UserExpense*)malloc(family->member_count * sizeof(UserExpense));
+    if (!member_expenses && family->member_count > 0) {
+        printf("Memory allocation failed\n");
+        return;
     }
-    
-    // Traverse leaf nodes using the B+ tree linked list structure
-    while (current != NULL) {
-        for (int i = 0; i < current->num_keys; i++) {
-            Expense* exp = &current->expenses[i];
-            
-            // Check if this expense belongs to any family member and matches the category
-            for (int j = 0; j < family->member_count; j++) {
-                if (exp->user_id == family->members[j]->user_id && exp->category == category) {
-                    member_expenses[j].expense_amount += exp->amount;
-                    total_category_expense += exp->amount;
-                }
+    for (int i = 0; i < family->member_count; i++) {
+        UserNode* member = familyMember(family, i);
+        member_expenses[i].user_id = member ? member->user_id : 0;
+        strcpy(member_expenses[i].user_name, member ? member->user_name : "");
+        member_expenses[i].expense_amount = 0;
+    }
+    
+    // Step 3: Find the family members' all-time expenses in the given category, SCAN_MEMBERS
+    // members at a time
+    for (int first = 0; first < family->member_count; first += SCAN_MEMBERS) {
+        int member_ids[SCAN_MEMBERS];
+        int member_count = familyMemberIDs(family, first, member_ids);
+        if (expenseRollup.attached) {
+            // One rollup lookup per member
+            for (int j = 0; j < member_count; j++) {
+                member_expenses[first + j].expense_amount = rollupTotal(member_ids[j], 0, category);
+                total_category_expense += member_expenses[first + j].expense_amount;
+            }
+        } else {
+            // Add up the family members' expenses of this category, by member
+            ExpenseScanTotals totals;
+            categoryMemberTotals(expenseRoot, member_ids, member_count, category, &totals);
+            for (int j = 0; j < member_count; j++) {
+                member_expenses[first + j].expense_amount = totals.member_sums[j];
             }
+            total_category_expense += totals.sum;
         }
-        current = current->next; // Move to next leaf node
     }
     
     // Step 4: Sort individual contributions in descending order
@@ -1371,7 +2763,7 @@ void get_categorical_expense(FamilyTree* familyTree, ExpenseNode* expenseRoot, i
     printf("Family ID: %d\n", family_id);
     printf("Family Name: %s\n", family->family_name);
     printf("Category: %s\n", getCategoryName(category));
-    printf("Total %s Expense: Rs. %.2f\n\n", getCategoryName(category), total_category_expense);
+    printf("Total %s Expense: Rs. %.2f\n\n", getCategoryName(category), centsToUnits(total_category_expense));
     
     printf("Individual Contributions (Sorted):\n");
     printf("-----------------------------------\n");
@@ -1380,11 +2772,11 @@ void get_categorical_expense(FamilyTree* familyTree, ExpenseNode* expenseRoot, i
     
     for (int i = 0; i < family->member_count; i++) {
         if (member_expenses[i].expense_amount > 0) {
-            float percentage = (member_expenses[i].expense_amount / total_category_expense) * 100;
+            double percentage = 100.0 * member_expenses[i].expense_amount / total_category_expense;
             printf("%-5d %-20s Rs. %-10.2f %.2f%%\n", 
                    member_expenses[i].user_id, 
                    member_expenses[i].user_name, 
-                   member_expenses[i].expense_amount, 
+                   centsToUnits(member_expenses[i].expense_amount), 
                    percentage);
         } else {
             printf("%-5d %-20s Rs. %-10.2f 0.00%%\n", 
@@ -1394,9 +2786,10 @@ void get_categorical_expense(FamilyTree* familyTree, ExpenseNode* expenseRoot, i
         }
     }
     printf("-----------------------------------\n");
+    free(member_expenses);
     
     // Step 6: Compare with family income to determine if this category expense is within budget
-    float category_percentage = (total_category_expense / family->total_income) * 100;
+    double category_percentage = 100.0 * total_category_expense / family->total_income;
     printf("\nCategory expense as percentage of family income: %.2f%%\n", category_percentage);
     
     if (category_percentage > 30) {
@@ -1405,7 +2798,7 @@ void get_categorical_expense(FamilyTree* familyTree, ExpenseNode* expenseRoot, i
 }
 
 // Function to get the day with the highest expense for a family
-void get_highest_expense_day(FamilyTree* familyTree, ExpenseNode* expenseRoot, int family_id) 
+void get_highest_expense_day(FamilyTree* familyTree, ExpenseNode* expenseRoot, int family_id, int top_k) 
 {
     // Step 1: Find the specified family
     Family* family = searchFamily(familyTree->root, family_id);
@@ -1414,189 +2807,207 @@ void get_highest_expense_day(FamilyTree* familyTree, ExpenseNode* expenseRoot, i
         return;
     }
     
-    // Step 2: Create a structure to track expenses by date
-    typedef struct 
-    {
-        char date[DATE_LENGTH];
-        float total_amount;
-    } DateExpense;
-    
-    // Set maximum number of unique dates we can track
-    // Assuming we won't have more than 100 unique dates in our dataset
-    #define MAX_DATES 100
-    DateExpense dateExpenses[MAX_DATES];
-    int date_count = 0;
-    
-    // Step 3: Initialize the date expense array
-    for (int i = 0; i < MAX_DATES; i++) {
-        strcpy(dateExpenses[i].date, "");
-        dateExpenses[i].total_amount = 0.0;
-    }
-    
-    // Step 4: Traverse the expense tree to find all expenses for family members
-    ExpenseNode* current = expenseRoot;
-    
-    // Find leftmost leaf node to start traversal
-    while (current && !current->is_leaf) {
-        current = current->children[0];
-    }
-    
-    // Traverse leaf nodes using the B+ tree linked list structure
-    while (current != NULL) {
-        for (int i = 0; i < current->num_keys; i++) {
-            Expense* exp = &current->expenses[i];
-            
-            // Check if this expense belongs to any family member
-            for (int j = 0; j < family->member_count; j++) {
-                if (exp->user_id == family->members[j]->user_id) {
-                    // Found an expense by a family member
-                    
-                    // Check if we already have this date in our array
-                    int date_index = -1;
-                    for (int k = 0; k < date_count; k++) {
-                        if (strcmp(dateExpenses[k].date, exp->date) == 0) {
-                            date_index = k;
-                            break;
-                        }
-                    }
-                    
-                    if (date_index == -1) {
-                        // This is a new date
-                        if (date_count < MAX_DATES) {
-                            strcpy(dateExpenses[date_count].date, exp->date);
-                            dateExpenses[date_count].total_amount = exp->amount;
-                            date_count++;
-                        } else {
-                            printf("Warning: Maximum unique dates exceeded!\n");
-                        }
-                    } else {
-                        // Add to existing date
-                        dateExpenses[date_index].total_amount += exp->amount;
-                    }
-                    
-                    // We found an expense for this family member, 
-                    // no need to check other members for this expense
-                    break;
-                }
+    // Step 2: Group the family members' expenses by day in one pass, through the user index
+    // or, without it, from the rows the scan kernel selects in each leaf
+    DayTotals days;
+    initDayTotals(&days);
+    long long total_all_days = 0;
+    for (int first = 0; first < family->member_count; first += SCAN_MEMBERS) {
+        for (MemberExpenseCursor c = familyCursorStart(expenseRoot, family, first); memberCursorValid(&c); memberCursorNext(&c)) {
+            ExpenseLeafNode* current = c.rec.leaf;
+            int i = c.rec.index;
+            if (!addDayTotal(&days, current->date_keys[i], current->amounts[i])) {
+                freeDayTotals(&days);
+                return;
             }
+            total_all_days += current->amounts[i];
         }
-        current = current->next; // Move to next leaf node
     }
     
-    // Step 5: Find the date with the highest expense
-    if (date_count == 0) {
+    if (days.days == 0) {
         printf("No expenses found for this family!\n");
+        freeDayTotals(&days);
         return;
     }
     
-    int highest_index = 0;
-    for (int i = 1; i < date_count; i++) {
-        if (dateExpenses[i].total_amount > dateExpenses[highest_index].total_amount) {
-            highest_index = i;
-        }
+    // Step 3: Rank the days, highest total first; ties go to the earlier date
+    TopK top;
+    if (!initTopK(&top, top_k > 0 && top_k < days.days ? top_k : days.days)) {
+        freeDayTotals(&days);
+        return;
     }
+    offerDayTotals(&days, &top);
+    int ranked_count = topKFinish(&top);
+    RankedItem* ranked = top.items;
     
-    // Step 6: Print the results
+    // Step 4: Print the results
     printf("\n===== Highest Expense Day Report =====\n");
     printf("Family ID: %d\n", family_id);
     printf("Family Name: %s\n", family->family_name);
-    printf("\nDate with highest expense: %s\n", dateExpenses[highest_index].date);
-    printf("Total amount spent: Rs. %.2f\n", dateExpenses[highest_index].total_amount);
+    printf("\nDate with highest expense: %04d-%02d-%02d\n", ranked[0].id / 10000, ranked[0].id / 100 % 100, ranked[0].id % 100);
+    printf("Total amount spent: Rs. %.2f\n", centsToUnits(ranked[0].score));
     
-    // Step 7: Print additional information about all recorded dates
-    printf("\nAll Expense Days (in descending order of expense):\n");
+    if (ranked_count == days.days) {
+        printf("\nAll Expense Days (in descending order of expense):\n");
+    } else {
+        printf("\nTop %d of %d Expense Days (in descending order of expense):\n", ranked_count, days.days);
+    }
     printf("---------------------------------------------------\n");
     printf("%-15s %-20s\n", "Date", "Total Amount");
     printf("---------------------------------------------------\n");
-    
-    // Sort dates by expense amount (descending)
-    for (int i = 0; i < date_count - 1; i++) {
-        for (int j = 0; j < date_count - i - 1; j++) {
-            if (dateExpenses[j].total_amount < dateExpenses[j + 1].total_amount) {
-                DateExpense temp = dateExpenses[j];
-                dateExpenses[j] = dateExpenses[j + 1];
-                dateExpenses[j + 1] = temp;
-            }
-        }
-    }
-    
-    // Print sorted dates
-    for (int i = 0; i < date_count; i++) {
-        printf("%-15s Rs. %-20.2f\n", dateExpenses[i].date, dateExpenses[i].total_amount);
+    for (int i = 0; i < ranked_count; i++) {
+        char date[DATE_LENGTH + 8];
+        sprintf(date, "%04d-%02d-%02d", ranked[i].id / 10000, ranked[i].id / 100 % 100, ranked[i].id % 100);
+        printf("%-15s Rs. %-20.2f\n", date, centsToUnits(ranked[i].score));
     }
     printf("---------------------------------------------------\n");
     
-    // Step 8: Calculate some additional statistics
-    float average_daily_expense = 0.0;
-    float total_all_days = 0.0;
-    
-    for (int i = 0; i < date_count; i++) {
-        total_all_days += dateExpenses[i].total_amount;
-    }
-    
-    average_daily_expense = total_all_days / date_count;
+    // Step 5: Statistics over every day, listed or not
+    double average_daily_expense = centsToUnits(total_all_days) / days.days;
     
-    printf("\nTotal expenses across all days: Rs. %.2f\n", total_all_days);
+    printf("\nTotal expenses across all days: Rs. %.2f\n", centsToUnits(total_all_days));
     printf("Average daily expense: Rs. %.2f\n", average_daily_expense);
     printf("Highest day expense is %.2f%% of the family's monthly income\n", 
-           (dateExpenses[highest_index].total_amount / family->total_income) * 100);
+           100.0 * ranked[0].score / family->total_income);
+    freeTopK(&top);
+    freeDayTotals(&days);
 }
 
-// Function to get individual expense for a specified user ID
-void get_individual_expense(UserNode* userRoot, ExpenseNode* expenseRoot, int user_id, int month, int year) {
-    // First check if the user exists
-    if (!searchUser(userRoot, user_id)) {
-        printf("Error: User with ID %d not found!\n", user_id);
+// Function to list the top K expenses, spenders, families or days, for one month or all time
+// (month 0); a spender or day ranking is limited to one family when family_id is not 0
+void get_top_rankings(UserNode* userRoot, FamilyTree* familyTree, ExpenseNode* expenseRoot, RankingKind kind, int k, int family_id, int month, int year) {
+    if (k <= 0) {
+        printf("Please enter a positive number of entries.\n");
+        return;
+    }
+    if (month != 0 && (month < 1 || month > 12)) {
+        printf("Invalid month!\n");
         return;
     }
+    int month_key = month != 0 ? year * 100 + month : 0;
     
-    // Array to store expenses by category
-    float category_expenses[5] = {0}; // Indexed by ExpenseCategory enum (RENT=1, etc.)
-    float total_expense = 0;
+    Family* family = NULL;
+    if ((kind == RANK_USERS || kind == RANK_DAYS) && family_id != 0) {
+        family = searchFamily(familyTree->root, family_id);
+        if (family == NULL) {
+            printf("Family with ID %d not found!\n", family_id);
+            return;
+        }
+    }
+    
+    // Step 1: Feed every candidate through a K-entry heap
+    TopK top;
+    if (!initTopK(&top, k)) return;
+    int ranked = 1;
+    switch (kind) {
+        case RANK_EXPENSES: rankExpensesByAmount(expenseRoot, month_key, &top); break;
+        case RANK_USERS: ranked = rankUsersBySpend(expenseRoot, family, month_key, &top); break;
+        case RANK_FAMILIES: ranked = rankFamiliesBySpend(familyTree, expenseRoot, month_key, &top); break;
+        case RANK_DAYS: ranked = rankDaysBySpend(expenseRoot, family, month_key, &top); break;
+        default:
+            printf("Invalid choice!\n");
+            ranked = 0;
+            break;
+    }
+    if (!ranked) {
+        freeTopK(&top);
+        return;
+    }
+    int count = topKFinish(&top);
     
-    // Traverse the B+ tree to find all expenses for this user
-    ExpenseNode* current = expenseRoot;
+    // Step 2: Print them, highest first
+    const char* titles[] = { "", "Expenses", "Spenders", "Families", "Expense Days" };
+    printf("\n=== Top %d %s", k, titles[kind]);
+    if (family) printf(" of Family %d (%s)", family->family_id, family->family_name);
+    if (month_key != 0) printf(" for %02d/%d", month, year);
+    printf(" ===\n");
+    if (count == 0) {
+        printf("No expenses found.\n");
+        freeTopK(&top);
+        return;
+    }
     
-    // First find a leaf node
-    while (current && !current->is_leaf) {
-        int i;
-        for (i = 0; i < current->num_keys; i++) {
-            if (user_id < current->keys[i]) break;
+    if (kind == RANK_EXPENSES) {
+        printf("+------------+------------+--------------+------------+--------------+\n");
+        printf("| Expense ID | User ID    | Category     | Amount     | Date         |\n");
+        printf("+------------+------------+--------------+------------+--------------+\n");
+        for (int i = 0; i < count; i++) {
+            ExpenseCursor c = expenseCursorSeek(expenseRoot, top.items[i].id);
+            if (expenseCursorValid(&c)) printExpenseDetails(expenseCursorGet(&c));
+        }
+        printf("+------------+------------+--------------+------------+--------------+\n");
+    } else {
+        printf("%-6s %-12s %-20s %-15s %-8s\n", "Rank", kind == RANK_DAYS ? "Date" : "ID", kind == RANK_DAYS ? "" : "Name", "Amount", "Records");
+        printf("----------------------------------------------------------------\n");
+        for (int i = 0; i < count; i++) {
+            RankedItem* item = &top.items[i];
+            char label[24];
+            const char* name = "";
+            if (kind == RANK_DAYS) {
+                sprintf(label, "%04d-%02d-%02d", item->id / 10000, item->id / 100 % 100, item->id % 100);
+            } else {
+                sprintf(label, "%d", item->id);
+            }
+            if (kind == RANK_USERS) {
+                UserNode* user = findUserById(userRoot, item->id);
+                if (user) name = user->user_name;
+            } else if (kind == RANK_FAMILIES) {
+                Family* ranked = searchFamily(familyTree->root, item->id);
+                if (ranked) name = ranked->family_name;
+            }
+            printf("%-6d %-12s %-20s Rs. %-11.2f %-8d\n", i + 1, label, name, centsToUnits(item->score), item->count);
         }
-        current = current->children[i];
+        printf("----------------------------------------------------------------\n");
+    }
+    freeTopK(&top);
+}
+
+// Function to get individual expense for a specified user ID
+void get_individual_expense(UserNode* userRoot, ExpenseNode* expenseRoot, int user_id, int month, int year) {
+    // First check if the user exists
+    if (!searchUser(userRoot, user_id)) {
+        printf("Error: User with ID %d not found!\n", user_id);
+        return;
     }
     
-    // Traverse all leaf nodes
-    while (current != NULL) {
-        for (int i = 0; i < current->num_keys; i++) {
-            Expense* exp = &current->expenses[i];
+    // Array to store expenses by category
+    long long category_expenses[5] = {0}; // Indexed by ExpenseCategory enum (RENT=1, etc.), in cents
+    long long total_expense = 0;
+    
+    if (expenseRollup.attached) {
+        // The rollup already holds this user's month total per category
+        for (int category = RENT; category <= LEISURE; category++) {
+            category_expenses[category - 1] = rollupTotal(user_id, year * 100 + month, category);
+            total_expense += category_expenses[category - 1];
+        }
+    } else {
+        // Visit only this user's expenses of that month, in expense ID order
+        for (MemberExpenseCursor c = monthMemberCursorStart(expenseRoot, &user_id, 1, year, month); memberCursorValid(&c); memberCursorNext(&c)) {
+            ExpenseLeafNode* current = c.rec.leaf;
+            int i = c.rec.index;
+            // Month and year come straight out of the packed date
+            int exp_year = current->date_keys[i] / 10000;
+            int exp_month = current->date_keys[i] / 100 % 100;
             
-            // Check if this expense belongs to the specified user
-            if (exp->user_id == user_id) {
-                // Parse the date to check month and year
-                int exp_year, exp_month, exp_day;
-                sscanf(exp->date, "%d-%d-%d", &exp_year, &exp_month, &exp_day);
-                
-                // Check if this expense is in the specified month and year
-                if (exp_month == month && exp_year == year) {
-                    // Add to the appropriate category total
-                    if (exp->category >= RENT && exp->category <= LEISURE) {
-                        category_expenses[exp->category - 1] += exp->amount;
-                        total_expense += exp->amount;
-                    }
+            // Check if this expense is in the specified month and year
+            if (exp_month == month && exp_year == year) {
+                // Add to the appropriate category total
+                ExpenseCategory category = current->categories[i];
+                if (category >= RENT && category <= LEISURE) {
+                    category_expenses[category - 1] += current->amounts[i];
+                    total_expense += current->amounts[i];
                 }
             }
         }
-        current = current->next; // Move to the next leaf node
     }
     
     // Print the total expense
-    printf("Total expense for User ID %d in %d-%d: $%.2f\n", user_id, year, month, total_expense);
+    printf("Total expense for User ID %d in %d-%d: $%.2f\n", user_id, year, month, centsToUnits(total_expense));
     
     // Create an array of category-expense pairs for sorting
     typedef struct {
         ExpenseCategory category;
-        float amount;
+        long long amount;
     } CategoryExpense;
     
     CategoryExpense sorted_expenses[5];
@@ -1620,23 +3031,217 @@ void get_individual_expense(UserNode* userRoot, ExpenseNode* expenseRoot, int us
     printf("Category-wise expenses (descending order):\n");
     for (int i = 0; i < 5; i++) {
         if (sorted_expenses[i].amount > 0) {
-            printf("%s: $%.2f\n", getCategoryName(sorted_expenses[i].category), sorted_expenses[i].amount);
+            printf("%s: $%.2f\n", getCategoryName(sorted_expenses[i].category), centsToUnits(sorted_expenses[i].amount));
         }
     }
 }
 
+// Function to pack a YYYY-MM-DD date into YYYYMMDD, so dates order and compare as integers;
+// returns 0 if the date cannot be parsed
+int packDate(const char* date)
+{
+    int year, month, day;
+    if (sscanf(date, "%d-%d-%d", &year, &month, &day) != 3) return 0;
+    if (year < 0 || month < 1 || month > 12 || day < 1 || day > 31) return 0;
+    return year * 10000 + month * 100 + day;
+}
+
 // Function to check if a date falls within a given range
-int isDateInRange(const char* date, const char* start_date, const char* end_date) 
+int isDateInRange(int date_key, int start_key, int end_key) 
 {
-    // Using string comparison for comparing the dates
+    // Packed dates compare in calendar order
 
-    if (strcmp(date, start_date) >= 0 && strcmp(date, end_date) <= 0) 
+    if (date_key >= start_key && date_key <= end_key) 
     {
         return 1; // Date is within range
     }
     return 0; // Date is outside range
 }
 
+// Function to start an empty expense list
+void initExpenseList(ExpenseList* list)
+{
+    list->items = NULL;
+    list->count = 0;
+    list->capacity = 0;
+}
+
+// Function to append a record, doubling the buffer when full; returns 0 if memory runs out
+int appendExpenseToList(ExpenseList* list, Expense expense)
+{
+    if (list->count == list->capacity) {
+        int capacity = list->capacity ? list->capacity * 2 : 64;
+        Expense* grown = (Expense*)realloc(list->items, capacity * sizeof(Expense));
+        if (!grown) {
+            printf("Memory allocation failed\n");
+            return 0;
+        }
+        list->items = grown;
+        list->capacity = capacity;
+    }
+    list->items[list->count++] = expense;
+    return 1;
+}
+
+// Function to release the buffer of an expense list
+void freeExpenseList(ExpenseList* list)
+{
+    free(list->items);
+    initExpenseList(list);
+}
+
+// Helper function to scramble a 64-bit key for hash tables (splitmix64 finalizer),
+// so nearby keys such as consecutive dates or users spread over the table
+unsigned long long mixHash64(unsigned long long h)
+{
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9ULL;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebULL;
+    h ^= h >> 31;
+    return h;
+}
+
+// Function to start an empty day table
+void initDayTotals(DayTotals* totals)
+{
+    totals->slots = NULL;
+    totals->capacity = 0;
+    totals->days = 0;
+}
+
+// Helper function to double a day table and rehash its days; returns 0 if memory runs out
+int growDayTotals(DayTotals* totals)
+{
+    int capacity = totals->capacity ? totals->capacity * 2 : 64;
+    DayTotal* slots = (DayTotal*)calloc(capacity, sizeof(DayTotal));
+    if (!slots) {
+        printf("Memory allocation failed\n");
+        return 0;
+    }
+    for (int i = 0; i < totals->capacity; i++) {
+        if (totals->slots[i].count == 0) continue;
+        int slot = (int)(mixHash64((unsigned long long)totals->slots[i].date_key) & (capacity - 1));
+        while (slots[slot].count != 0) slot = (slot + 1) & (capacity - 1);
+        slots[slot] = totals->slots[i];
+    }
+    free(totals->slots);
+    totals->slots = slots;
+    totals->capacity = capacity;
+    return 1;
+}
+
+// Function to add an expense amount to its day's total; returns 0 if memory runs out
+int addDayTotal(DayTotals* totals, int date_key, long long amount)
+{
+    // Keep the table at most 70% full
+    if ((totals->days + 1) * 10 > totals->capacity * 7 && !growDayTotals(totals)) return 0;
+    int slot = (int)(mixHash64((unsigned long long)date_key) & (totals->capacity - 1));
+    while (totals->slots[slot].count != 0 && totals->slots[slot].date_key != date_key) {
+        slot = (slot + 1) & (totals->capacity - 1);
+    }
+    DayTotal* day = &totals->slots[slot];
+    if (day->count == 0) {
+        day->date_key = date_key;
+        totals->days++;
+    }
+    day->count++;
+    day->total += amount;
+    return 1;
+}
+
+// Function to release a day table
+void freeDayTotals(DayTotals* totals)
+{
+    free(totals->slots);
+    initDayTotals(totals);
+}
+
+// Function to start an empty top-K heap; returns 0 if memory runs out
+int initTopK(TopK* top, int k)
+{
+    top->k = k > 0 ? k : 1;
+    top->count = 0;
+    top->items = (RankedItem*)malloc(top->k * sizeof(RankedItem));
+    if (!top->items) {
+        printf("Memory allocation failed\n");
+        return 0;
+    }
+    return 1;
+}
+
+// Helper function to order ranked items: higher score first, then the smaller ID
+int rankedItemAhead(const RankedItem* a, const RankedItem* b)
+{
+    if (a->score != b->score) return a->score > b->score;
+    return a->id < b->id;
+}
+
+// Helper function to restore a heap whose root is the lowest ranked item, from position i down
+void siftDownRanked(RankedItem* heap, int count, int i)
+{
+    for (;;) {
+        int lowest = i, left = 2 * i + 1, right = 2 * i + 2;
+        if (left < count && rankedItemAhead(&heap[lowest], &heap[left])) lowest = left;
+        if (right < count && rankedItemAhead(&heap[lowest], &heap[right])) lowest = right;
+        if (lowest == i) return;
+        RankedItem temp = heap[i];
+        heap[i] = heap[lowest];
+        heap[lowest] = temp;
+        i = lowest;
+    }
+}
+
+// Function to offer one candidate; it is kept if it ranks among the K best so far
+void topKOffer(TopK* top, int id, int count, long long score)
+{
+    RankedItem item = {id, count, score};
+    if (top->count < top->k) {
+        // Still filling: append, then move the new item up while its parent outranks it
+        int child = top->count++;
+        top->items[child] = item;
+        while (child > 0 && rankedItemAhead(&top->items[(child - 1) / 2], &top->items[child])) {
+            RankedItem temp = top->items[child];
+            top->items[child] = top->items[(child - 1) / 2];
+            top->items[(child - 1) / 2] = temp;
+            child = (child - 1) / 2;
+        }
+    } else if (rankedItemAhead(&item, &top->items[0])) {
+        top->items[0] = item;
+        siftDownRanked(top->items, top->count, 0);
+    }
+}
+
+// Function to sort the kept items in place, highest first; returns how many there are
+int topKFinish(TopK* top)
+{
+    // Take the lowest ranked item off the heap into the last free position, until sorted
+    for (int n = top->count; n > 1; n--) {
+        RankedItem temp = top->items[0];
+        top->items[0] = top->items[n - 1];
+        top->items[n - 1] = temp;
+        siftDownRanked(top->items, n - 1, 0);
+    }
+    return top->count;
+}
+
+// Function to release a top-K heap
+void freeTopK(TopK* top)
+{
+    free(top->items);
+    top->items = NULL;
+    top->count = 0;
+}
+
+// Function to offer every day of a day table to a top-K heap
+void offerDayTotals(const DayTotals* totals, TopK* top)
+{
+    for (int i = 0; i < totals->capacity; i++) {
+        const DayTotal* day = &totals->slots[i];
+        if (day->count != 0) topKOffer(top, day->date_key, day->count, day->total);
+    }
+}
+
 // Function to print an individual expense
 void printExpenseDetails(Expense expense) 
 {
@@ -1644,34 +3249,62 @@ void printExpenseDetails(Expense expense)
            expense.expense_id, 
            expense.user_id, 
            getCategoryName(expense.category), 
-           expense.amount, 
+           centsToUnits(expense.amount), 
            expense.date);
 }
 
-// Helper function to collect expenses within date range from B+ tree
-//A wrapper function
-// Helper function to collect expenses within date range from B+ tree
-void collectExpensesInDateRange(ExpenseNode* node, const char* start_date, const char* end_date, Expense** expenses, int* count) {
-    if (node == NULL) return;
-    
-    // First, navigate to leaf level using standard B+ tree traversal
-    if (!node->is_leaf) {
-        // For non-leaf nodes, just traverse down to leaves
-        for (int i = 0; i <= node->num_keys; i++) {
-            if (node->children[i] != NULL) {
-                collectExpensesInDateRange(node->children[i], start_date, end_date, expenses, count);
+// Helper function to collect expenses within date range from B+ tree, of one category
+// (or of any, when category is 0)
+void collectExpensesInDateRange(ExpenseNode* node, int start_key, int end_key, ExpenseCategory category, ExpenseList* out) {
+    // Gather the matching IDs from the date index; give up on it once the period
+    // covers more than a sixteenth of the records, where one pass over the leaves is cheaper.
+    // The category bitmap drops other categories before any record is fetched
+    const CategoryBitmap *filter = category ? categoryBitmapFor(category) : NULL;
+    long long *ids = NULL;
+    int count = 0, capacity = 0, visited = 0, useIndex = dateExpenseIndex.attached;
+    if (useIndex) {
+        for (ExpenseIndexCursor ic = expenseIndexSeek(&dateExpenseIndex, makeIndexKey(start_key, INT_MIN)); expenseIndexValid(&ic); expenseIndexNext(&ic)) {
+            long long key = expenseIndexKey(&ic);
+            if (indexKeyMajor(key) > end_key) break;
+            if ((long)visited++ * 16 > dateExpenseIndex.count) {
+                useIndex = 0;
+                break;
+            }
+            if (filter && !bitmapContains(filter, indexKeyExpenseID(key))) continue;
+            if (count == capacity) {
+                capacity = capacity ? capacity * 2 : 64;
+                long long *grown = (long long *)realloc(ids, capacity * sizeof(long long));
+                if (!grown) {
+                    useIndex = 0;
+                    break;
+                }
+                ids = grown;
             }
+            ids[count++] = indexKeyExpenseID(key);
         }
-        return; 
     }
     
-    // For leaf nodes, process expenses in this node 
-    for (int i = 0; i < node->num_keys; i++) {
-        if (isDateInRange(node->expenses[i].date, start_date, end_date)) {
-            expenses[*count] = &(node->expenses[i]);
-            (*count)++;
+    if (!useIndex) {
+        // Every record is visited, reading only the date column until a match
+        free(ids);
+        for (ExpenseCursor c = expenseCursorFirst(node); expenseCursorValid(&c); expenseCursorNext(&c)) {
+            if (isDateInRange(c.leaf->date_keys[c.index], start_key, end_key)) {
+                if (category && c.leaf->categories[c.index] != category) continue;
+                if (!appendExpenseToList(out, expenseCursorGet(&c))) return;
+            }
         }
+        return;
     }
+    
+    // Visit the records in ID order, as the scan does, stepping along the leaves between nearby IDs
+    sortIndexKeys(ids, count);
+    ExpenseCursor c = { NULL, 0 };
+    for (int i = 0; i < count; i++) {
+        c = seekExpenseFrom(node, c, (int)ids[i]);
+        if (category && !filter && c.leaf->categories[c.index] != category) continue;
+        if (!appendExpenseToList(out, expenseCursorGet(&c))) break;
+    }
+    free(ids);
 }
 
 // Function to get all expenses within a given date range
@@ -1681,23 +3314,31 @@ void get_expense_in_period(ExpenseNode* expenseRoot, const char* start_date, con
         return;
     }
     
-    // Count total expenses first to allocate array
-    int totalExpenses = CountExpenses(expenseRoot);
-    if (totalExpenses == 0) {
+    // Only an empty leaf root has no keys, so there is no need to count every record
+    if (expenseRoot->num_keys == 0) {
         printf("No expenses found in the database.\n");
         return;
     }
     
-    // Create an array to store pointers to expenses within the date range
-    Expense* filteredExpenses[MAX_EXPENSES];
-    int count = 0;
+    // Dates are parsed once here, then compared as integers
+    int start_key = packDate(start_date);
+    int end_key = packDate(end_date);
+    if (start_key == 0 || end_key == 0) {
+        printf("Invalid date format. Use YYYY-MM-DD.\n");
+        return;
+    }
     
-    // Collect all expenses within the date range
-    collectExpensesInDateRange(expenseRoot, start_date, end_date, filteredExpenses, &count);
+    // Collect all expenses within the date range into a growable buffer
+    ExpenseList filtered;
+    initExpenseList(&filtered);
+    collectExpensesInDateRange(expenseRoot, start_key, end_key, 0, &filtered);
+    Expense* filteredExpenses = filtered.items;
+    int count = filtered.count;
     
     if (count == 0) 
     {
         printf("No expenses found between %s and %s.\n", start_date, end_date);
+        freeExpenseList(&filtered);
         return;
     }
     
@@ -1710,67 +3351,28 @@ void get_expense_in_period(ExpenseNode* expenseRoot, const char* start_date, con
     // Print all expenses in the date range
     for (int i = 0; i < count; i++) 
     {
-        printExpenseDetails(*(filteredExpenses[i]));
+        printExpenseDetails(filteredExpenses[i]);
     }
     
     printf("+------------+------------+--------------+------------+--------------+\n");
     
     // Calculate total amount
-    float totalAmount = 0;
+    long long totalAmount = 0;
     for (int i = 0; i < count; i++) {
-        totalAmount += filteredExpenses[i]->amount;
+        totalAmount += filteredExpenses[i].amount;
     }
     
-    printf("Total expenses in this period: %.2f\n", totalAmount);
+    printf("Total expenses in this period: %.2f\n", centsToUnits(totalAmount));
     printf("Number of expense entries: %d\n", count);
+    freeExpenseList(&filtered);
 }
 
-void collectExpensesInIDRange(ExpenseNode* root, int start_id, int end_id, int user_id, Expense** expenses, int* count) {
-    if (root == NULL) return;
-    
-    // Find leaf node containing start_id
-    ExpenseNode* current = root;
-    while (!current->is_leaf) {
-        int i = 0;
-        while (i < current->num_keys && start_id > current->keys[i]) {
-            i++;
-        }
-        current = current->children[i];
-    }
-    
-    // Track already processed expense IDs to avoid duplicates
-    int processedIDs[MAX_EXPENSES] = {0};
-    int processedCount = 0;
-    
-    int found=0;
-    // Now current points to the leaf node where we should start collecting
-    while (current != NULL) {
-        for (int i = 0; i < current->num_keys && found == 0; i++) {
-            if (current->expenses[i].user_id == user_id && current->expenses[i].expense_id >= start_id && current->expenses[i].expense_id <= end_id) {
-                
-                // Check if we've already processed this expense ID
-                bool isDuplicate = false;
-                for (int j = 0; j < processedCount; j++) {
-                    if (processedIDs[j] == current->expenses[i].expense_id) {
-                        isDuplicate = true;
-                        found=1;
-                    }
-                }
-                
-                if (!isDuplicate) {
-                    expenses[*count] = &(current->expenses[i]);
-                    (*count)++;
-                    processedIDs[processedCount++] = current->expenses[i].expense_id;
-                }
-            }
-        }
-        
-        // Move to next leaf if the highest key in current leaf is <= end_id
-        if (current->num_keys > 0 && current->expenses[current->num_keys - 1].expense_id <= end_id) {
-            current = current->next;
-        } else {
-            current = NULL;
-        }
+void collectExpensesInIDRange(ExpenseNode* root, int start_id, int end_id, int user_id, ExpenseList* out) {
+    // Seek to (user_id, start_id) and walk the user's expenses until the first ID past end_id;
+    // expense IDs are unique, so each row is visited once
+    for (MemberExpenseCursor c = memberCursorStart(root, &user_id, 1, start_id); memberCursorValid(&c); memberCursorNext(&c)) {
+        if (expenseCursorKey(&c.rec) > end_id) return;
+        if (!appendExpenseToList(out, expenseCursorGet(&c.rec))) return;
     }
 }
 
@@ -1795,16 +3397,17 @@ void get_expense_in_range(UserNode* userRoot, ExpenseNode* expenseRoot, int expe
         return;
     }
     
-    // Create an array to store pointers to expenses within the ID range
-    Expense* filteredExpenses[MAX_EXPENSES];
-    int count = 0;
-    
     // Collect all expenses within the expense ID range for the given individual
-    collectExpensesInIDRange(expenseRoot, expenseID_1, expenseID_2, individualID, filteredExpenses, &count);
+    ExpenseList filtered;
+    initExpenseList(&filtered);
+    collectExpensesInIDRange(expenseRoot, expenseID_1, expenseID_2, individualID, &filtered);
+    Expense* filteredExpenses = filtered.items;
+    int count = filtered.count;
     
     if (count == 0) {
         printf("No expenses found for user ID %d between expense IDs %d and %d.\n", 
                individualID, expenseID_1, expenseID_2);
+        freeExpenseList(&filtered);
         return;
     }
     
@@ -1817,21 +3420,21 @@ void get_expense_in_range(UserNode* userRoot, ExpenseNode* expenseRoot, int expe
     
     // Print all expenses in the ID range
     for (int i = 0; i < count; i++) {
-        printExpenseDetails(*(filteredExpenses[i]));
+        printExpenseDetails(filteredExpenses[i]);
     }
     
     printf("+------------+------------+--------------+------------+--------------+\n");
     
     // Calculate total amount and category breakdown
-    float totalAmount = 0;
-    float categoryAmount[MAX_CATEGORY + 1] = {0}; // +1 because categories start from 1
+    long long totalAmount = 0;
+    long long categoryAmount[MAX_CATEGORY + 1] = {0}; // +1 because categories start from 1
     
     for (int i = 0; i < count; i++) {
-        totalAmount += filteredExpenses[i]->amount;
-        categoryAmount[filteredExpenses[i]->category] += filteredExpenses[i]->amount;
+        totalAmount += filteredExpenses[i].amount;
+        categoryAmount[filteredExpenses[i].category] += filteredExpenses[i].amount;
     }
     
-    printf("Total expenses in this range: %.2f\n", totalAmount);
+    printf("Total expenses in this range: %.2f\n", centsToUnits(totalAmount));
     printf("Number of expense entries: %d\n\n", count);
     
     // Print category breakdown
@@ -1840,10 +3443,70 @@ void get_expense_in_range(UserNode* userRoot, ExpenseNode* expenseRoot, int expe
         if (categoryAmount[i] > 0) {
             printf("%s: %.2f (%.1f%%)\n", 
                    getCategoryName(i), 
-                   categoryAmount[i], 
-                   (categoryAmount[i] / totalAmount) * 100);
+                   centsToUnits(categoryAmount[i]), 
+                   100.0 * categoryAmount[i] / totalAmount);
         }
     }
+    freeExpenseList(&filtered);
+}
+
+// Function to list the N most recent expenses (highest IDs first) by scanning back from the tail
+void get_latest_expenses(ExpenseNode* expenseRoot, int n) {
+    if (n <= 0) {
+        printf("Please enter a positive number of expenses.\n");
+        return;
+    }
+    
+    ExpenseCursor cursor = expenseCursorLast(expenseRoot);
+    if (!expenseCursorValid(&cursor)) {
+        printf("No expenses found in the database.\n");
+        return;
+    }
+    
+    Expense* latest = (Expense*)malloc(n * sizeof(Expense));
+    if (!latest) {
+        printf("Memory allocation failed\n");
+        return;
+    }
+    int count = expenseCursorPrevBatch(&cursor, latest, n);
+    
+    // Print header
+    printf("\n=== Latest %d Expenses ===\n", count);
+    printf("+------------+------------+--------------+------------+--------------+\n");
+    printf("| Expense ID | User ID    | Category     | Amount     | Date         |\n");
+    printf("+------------+------------+--------------+------------+--------------+\n");
+    
+    long long totalAmount = 0;
+    for (int i = 0; i < count; i++) {
+        printExpenseDetails(latest[i]);
+        totalAmount += latest[i].amount;
+    }
+    
+    printf("+------------+------------+--------------+------------+--------------+\n");
+    printf("Total of these expenses: %.2f\n", centsToUnits(totalAmount));
+    free(latest);
+}
+
+// Function to print spending totals for all expenses between two expense IDs, from the tree's aggregates
+void get_expense_totals_in_range(ExpenseNode* expenseRoot, int expenseID_1, int expenseID_2) {
+    if (expenseID_1 > expenseID_2) {
+        int temp = expenseID_1;
+        expenseID_1 = expenseID_2;
+        expenseID_2 = temp;
+    }
+    
+    ExpenseAggregate agg = aggregateExpenseRange(expenseRoot, expenseID_1, expenseID_2);
+    if (agg.count == 0) {
+        printf("No expenses found between expense IDs %d and %d.\n", expenseID_1, expenseID_2);
+        return;
+    }
+    
+    printf("\n=== Expense Totals for IDs %d to %d ===\n", expenseID_1, expenseID_2);
+    printf("Number of expense entries: %d\n", agg.count);
+    printf("Total amount: %.2f\n", centsToUnits(agg.sum));
+    printf("Average amount: %.2f\n", centsToUnits(agg.sum) / agg.count);
+    printf("Smallest expense: %.2f\n", centsToUnits(agg.min));
+    printf("Largest expense: %.2f\n", centsToUnits(agg.max));
 }
 
 // Function to update or delete individual or family details
@@ -1865,14 +3528,11 @@ void Update_or_delete_individual_Family_details(UserNode** userRoot, FamilyTree*
                 // Remove trailing newline if exists
                 if (new_name[0] != '\n') {
                     new_name[strcspn(new_name, "\n")] = 0;
-                    strcpy(family->family_name, new_name);
+                    setFamilyName(family, new_name);
                 }
                 
                 // Recalculate total income
-                family->total_income = 0;
-                for (int i = 0; i < family->member_count; i++) {
-                    family->total_income += family->members[i]->income;
-                }
+                family->total_income = familyMemberIncome(family);
                 
                 // Recalculate total monthly expense
                 family->total_monthly_expense = calculateTotalMonthlyExpense(expenseRoot, family);
@@ -1883,7 +3543,7 @@ void Update_or_delete_individual_Family_details(UserNode** userRoot, FamilyTree*
             }
         } else { // Update individual
             char new_name[MAX_NAME_LENGTH];
-            float new_income;
+            double new_income;
             
             // Search for the user
             if (searchUser(*userRoot, id)) {
@@ -1900,41 +3560,19 @@ void Update_or_delete_individual_Family_details(UserNode** userRoot, FamilyTree*
                 }
                 
                 printf("Enter new income (or -1 to keep current): ");
-                scanf("%f", &new_income);
+                scanf("%lf", &new_income);
                 
                 // Update user
-                *userRoot = updateUser(*userRoot, id, new_name, new_income);
+                *userRoot = updateUser(*userRoot, id, new_name, unitsToCents(new_income));
                 
                 // Find the family this user belongs to and update it
-                FamilyNode* currentNode = familyTree->root;
-                while (currentNode) {
-                    for (int i = 0; i < currentNode->num_keys; i++) {
-                        Family* family = currentNode->families[i];
-                        for (int j = 0; j < family->member_count; j++) {
-                            if (family->members[j]->user_id == id) {
-                                // Update family's total income
-                                family->total_income = 0;
-                                for (int k = 0; k < family->member_count; k++) {
-                                    family->total_income += family->members[k]->income;
-                                }
-                                
-                                // Update family's total monthly expense
-                                family->total_monthly_expense = calculateTotalMonthlyExpense(expenseRoot, family);
-                                
-                                printf("User and associated family updated successfully.\n");
-                                return;
-                            }
-                        }
-                    }
-                    
-                    // B-tree traversal to find the family
-                    if (currentNode->is_leaf) {
-                        break;
-                    }
+                Family* family = familyOfUser(id);
+                if (family) {
+                    // Update family's total income; its expense total is unchanged
+                    family->total_income = familyMemberIncome(family);
                     
-                    // If we're still looking, we need to search children
-                    // This is a simplified approach and might need refinement
-                    currentNode = currentNode->children[0]; // Simplified approach
+                    printf("User and associated family updated successfully.\n");
+                    return;
                 }
                 
                 printf("User updated successfully, but not found in any family.\n");
@@ -1964,35 +3602,9 @@ void Update_or_delete_individual_Family_details(UserNode** userRoot, FamilyTree*
                 return;
             }
             
-            // Find the family this user belongs to
-            FamilyNode* currentNode = familyTree->root;
-            Family* targetFamily = NULL;
-            int j_index = -1;
-            
-            // Find the family and the index of this user in that family
-            while (currentNode && !targetFamily) {
-                for (int i = 0; i < currentNode->num_keys; i++) {
-                    Family* family = currentNode->families[i];
-                    for (int j = 0; j < family->member_count; j++) {
-                        if (family->members[j]->user_id == id) {
-                            targetFamily = family;
-                            j_index = j;
-                            break;
-                        }
-                    }
-                    if (targetFamily) break;
-                }
-                
-                if (targetFamily) break;
-                
-                // If we're still looking, we need to search children
-                if (!currentNode->is_leaf) {
-                    // Simple approach for traversal, can be improved
-                    currentNode = currentNode->children[0];
-                } else {
-                    break;
-                }
-            }
+            // Find the family this user belongs to and the index of this user in that family
+            Family* targetFamily = familyOfUser(id);
+            int j_index = targetFamily ? findMemberIndex(targetFamily, id) : -1;
             
             // Now handle the deletion based on whether the user is in a family
             if (targetFamily) {
@@ -2000,26 +3612,17 @@ void Update_or_delete_individual_Family_details(UserNode** userRoot, FamilyTree*
                     // User is the only member of the family, delete the family too
                     printf("User is the only member of family %d. Deleting both user and family.\n", targetFamily->family_id);
                     
-                    // Delete the user
-                    *userRoot = deleteUserNode(*userRoot, id);
-                    
-                    // Delete the family
+                    // Delete the family while its member handle still resolves, then the user
                     deleteFamilyFromTree(familyTree, targetFamily->family_id);
+                    *userRoot = deleteUserNode(*userRoot, id);
                 } else {
-                    // Remove user from the family
-                    for (int k = j_index; k < targetFamily->member_count - 1; k++) {
-                        targetFamily->members[k] = targetFamily->members[k + 1];
-                    }
-                    targetFamily->member_count--;
+                    // Take the user's expenses out of the family total, then the user out of the family
+                    familyMemberLeaving(targetFamily, expenseRoot, id);
+                    removeFamilyMemberAt(targetFamily, j_index);
+                    clearFamilyOfUser(id, targetFamily);
                     
                     // Update family's total income
-                    targetFamily->total_income = 0;
-                    for (int k = 0; k < targetFamily->member_count; k++) {
-                        targetFamily->total_income += targetFamily->members[k]->income;
-                    }
-                    
-                    // Update family's total monthly expense
-                    targetFamily->total_monthly_expense = calculateTotalMonthlyExpense(expenseRoot, targetFamily);
+                    targetFamily->total_income = familyMemberIncome(targetFamily);
                     
                     // Delete the user
                     *userRoot = deleteUserNode(*userRoot, id);
@@ -2037,280 +3640,311 @@ void Update_or_delete_individual_Family_details(UserNode** userRoot, FamilyTree*
     }
 }
 
-// Helper function to delete a family from the B-Tree
-int deleteFamilyFromTree(FamilyTree* familyTree, int family_id) {
-    if (!familyTree || !familyTree->root) {
-        return 0;
-    }
-    
-    // Find the family node and index
-    FamilyNode* node = NULL;
-    int keyIndex = -1;
-    
-    // Implementation for finding node and keyIndex
-    if (!findFamilyNode(familyTree->root, family_id, &node, &keyIndex)) {
-        return 0;  // Family not found
+// Helper function to move the last key of child index-1 up into the parent and the
+// parent's separator down into child index
+void borrowFamilyFromLeft(FamilyNode* node, int index) {
+    FamilyNode* child = node->children[index];
+    FamilyNode* left = node->children[index - 1];
+
+    // Shift the child's keys (and children) right by one
+    for (int i = child->num_keys; i > 0; i--) {
+        child->keys[i] = child->keys[i - 1];
+        child->families[i] = child->families[i - 1];
     }
-    
-    // If the family is in a leaf node
-    if (node->is_leaf) {
-        // Remove the key and shift other keys
-        for (int i = keyIndex; i < node->num_keys - 1; i++) {
-            node->keys[i] = node->keys[i + 1];
-            node->families[i] = node->families[i + 1];
-        }
-        node->num_keys--;
-        
-        // Balance the tree if needed
-        if (node == familyTree->root && node->num_keys == 0) {
-            free(node);
-            familyTree->root = NULL;
-        } else if (node->num_keys < MIN_KEYS) {
-            balanceFamilyTree(familyTree, node);
+    if (!child->is_leaf) {
+        for (int i = child->num_keys + 1; i > 0; i--) {
+            child->children[i] = child->children[i - 1];
         }
-        
-        familyTree->count--;
-        return 1;
-    }
-    
-    // If the family is in an internal node
-    // This is a complex case requiring finding the predecessor or successor
-    // For simplicity, we'll find the predecessor (rightmost key in left subtree)
-    FamilyNode* predecessorNode = node->children[keyIndex];
-    while (!predecessorNode->is_leaf) {
-        predecessorNode = predecessorNode->children[predecessorNode->num_keys];
-    }
-    
-    // Replace the key with predecessor's rightmost key
-    int predecessorIndex = predecessorNode->num_keys - 1;
-    node->keys[keyIndex] = predecessorNode->keys[predecessorIndex];
-    node->families[keyIndex] = predecessorNode->families[predecessorIndex];
-    
-    // Remove the predecessor
-    predecessorNode->num_keys--;
-    
-    // Balance the tree if needed
-    if (predecessorNode->num_keys < MIN_KEYS) {
-        balanceFamilyTree(familyTree, predecessorNode);
+        child->children[0] = left->children[left->num_keys];
+        left->children[left->num_keys] = NULL;
     }
-    
-    familyTree->count--;
-    return 1;
+
+    child->keys[0] = node->keys[index - 1];
+    child->families[0] = node->families[index - 1];
+    node->keys[index - 1] = left->keys[left->num_keys - 1];
+    node->families[index - 1] = left->families[left->num_keys - 1];
+    child->num_keys++;
+    left->num_keys--;
 }
 
-int deleteFamily(FamilyTree* familyTree, int family_id, const char* filename) {
-    // Step 1: Delete family from in-memory tree
-    int result = deleteFamilyFromTree(familyTree, family_id);
-    if (result == 0) {
-        printf("Family with ID %d not found.\n", family_id);
-        return 0; // Family not found
-    }
+// Helper function to move the first key of child index+1 up into the parent and the
+// parent's separator down into child index
+void borrowFamilyFromRight(FamilyNode* node, int index) {
+    FamilyNode* child = node->children[index];
+    FamilyNode* right = node->children[index + 1];
 
-    // Step 2: Save updated tree to file
-    saveFamiliesToFile(familyTree, filename, "temp_file.txt");
+    child->keys[child->num_keys] = node->keys[index];
+    child->families[child->num_keys] = node->families[index];
+    if (!child->is_leaf) {
+        child->children[child->num_keys + 1] = right->children[0];
+    }
+    node->keys[index] = right->keys[0];
+    node->families[index] = right->families[0];
 
-    printf("Family with ID %d deleted successfully.\n", family_id);
-    return 1; // Successful deletion
+    // Shift the sibling's keys (and children) left by one
+    for (int i = 0; i < right->num_keys - 1; i++) {
+        right->keys[i] = right->keys[i + 1];
+        right->families[i] = right->families[i + 1];
+    }
+    if (!right->is_leaf) {
+        for (int i = 0; i < right->num_keys; i++) {
+            right->children[i] = right->children[i + 1];
+        }
+        right->children[right->num_keys] = NULL;
+    }
+    child->num_keys++;
+    right->num_keys--;
 }
 
+// Helper function to merge child index+1 and the separator between them into child index
+void mergeFamilyNodes(FamilyNode* node, int index) {
+    FamilyNode* child = node->children[index];
+    FamilyNode* sibling = node->children[index + 1];
 
-// Helper function to find a family node and its key index
-int findFamilyNode(FamilyNode* root, int family_id, FamilyNode** nodeOut, int* indexOut) {
-    if (!root) {
-        return 0;
+    // Pull the separator down, then append the sibling's keys and children
+    child->keys[child->num_keys] = node->keys[index];
+    child->families[child->num_keys] = node->families[index];
+    for (int i = 0; i < sibling->num_keys; i++) {
+        child->keys[child->num_keys + 1 + i] = sibling->keys[i];
+        child->families[child->num_keys + 1 + i] = sibling->families[i];
     }
-    
-    // Try to find the key in this node
-    int i = 0;
-    while (i < root->num_keys && family_id > root->keys[i]) {
-        i++;
+    if (!child->is_leaf) {
+        for (int i = 0; i <= sibling->num_keys; i++) {
+            child->children[child->num_keys + 1 + i] = sibling->children[i];
+        }
     }
-    
-    // If found, return this node and index
-    if (i < root->num_keys && family_id == root->keys[i]) {
-        *nodeOut = root;
-        *indexOut = i;
-        return 1;
+    child->num_keys += sibling->num_keys + 1;
+
+    // Close the gap in the parent
+    for (int i = index; i < node->num_keys - 1; i++) {
+        node->keys[i] = node->keys[i + 1];
+        node->families[i] = node->families[i + 1];
     }
-    
-    // If this is a leaf, the key doesn't exist
-    if (root->is_leaf) {
-        return 0;
+    for (int i = index + 1; i < node->num_keys; i++) {
+        node->children[i] = node->children[i + 1];
     }
-    
-    // Otherwise, recurse into the appropriate child
-    return findFamilyNode(root->children[i], family_id, nodeOut, indexOut);
+    node->children[node->num_keys] = NULL;
+    node->num_keys--;
+
+    poolFree(&familyNodePool, sibling);
 }
 
-// Helper function to balance the B-Tree after deletion
-void balanceFamilyTree(FamilyTree* tree, FamilyNode* node) {
-    // This is a simplified approach - a complete implementation would require
-    // identifying the parent node and handling various rebalancing cases
-    
-    // If node is root, no need to balance
-    if (node == tree->root) {
-        return;
-    }
-    
-    // Find the parent node
-    FamilyNode* parent = findParentNode(tree->root, node);
-    if (!parent) {
-        return;  // Should not happen
-    }
-    
-    // Find the node's index in the parent's children array
-    int nodeIndex = 0;
-    while (nodeIndex <= parent->num_keys && parent->children[nodeIndex] != node) {
-        nodeIndex++;
-    }
-    
-    // If right sibling exists and has extra keys
-    if (nodeIndex < parent->num_keys && parent->children[nodeIndex + 1]->num_keys > MIN_KEYS) {
-        // Borrow from right sibling
-        FamilyNode* rightSibling = parent->children[nodeIndex + 1];
-        
-        // Add the parent's key to the current node
-        node->keys[node->num_keys] = parent->keys[nodeIndex];
-        node->families[node->num_keys] = parent->families[nodeIndex];
-        node->num_keys++;
-        
-        // Move the first key from right sibling to parent
-        parent->keys[nodeIndex] = rightSibling->keys[0];
-        parent->families[nodeIndex] = rightSibling->families[0];
-        
-        // Shift all keys in right sibling
-        for (int i = 0; i < rightSibling->num_keys - 1; i++) {
-            rightSibling->keys[i] = rightSibling->keys[i + 1];
-            rightSibling->families[i] = rightSibling->families[i + 1];
-        }
-        
-        // If not a leaf, move the child pointer too
-        if (!node->is_leaf) {
-            node->children[node->num_keys] = rightSibling->children[0];
-            for (int i = 0; i < rightSibling->num_keys; i++) {
-                rightSibling->children[i] = rightSibling->children[i + 1];
-            }
-        }
-        
-        rightSibling->num_keys--;
-        return;
+// Helper function to give child index more than MIN_KEYS keys before the delete descends
+// into it, borrowing from a sibling that can spare a key or else merging with one.
+// Returns the index of the child to descend into
+int fillFamilyChild(FamilyNode* node, int index) {
+    if (index > 0 && node->children[index - 1]->num_keys > MIN_KEYS) {
+        borrowFamilyFromLeft(node, index);
+    } else if (index < node->num_keys && node->children[index + 1]->num_keys > MIN_KEYS) {
+        borrowFamilyFromRight(node, index);
+    } else if (index < node->num_keys) {
+        mergeFamilyNodes(node, index);
+    } else {
+        mergeFamilyNodes(node, index - 1);
+        index--;
     }
-    
-    // If left sibling exists and has extra keys
-    if (nodeIndex > 0 && parent->children[nodeIndex - 1]->num_keys > MIN_KEYS) {
-        // Borrow from left sibling
-        FamilyNode* leftSibling = parent->children[nodeIndex - 1];
-        
-        // Shift all keys in current node to make room
-        for (int i = node->num_keys; i > 0; i--) {
-            node->keys[i] = node->keys[i - 1];
-            node->families[i] = node->families[i - 1];
-        }
-        
-        // If not a leaf, shift child pointers too
-        if (!node->is_leaf) {
-            for (int i = node->num_keys + 1; i > 0; i--) {
-                node->children[i] = node->children[i - 1];
+    return index;
+}
+
+// Helper function for the top-down delete: every node it descends into already holds more
+// than MIN_KEYS keys, so removing one never needs to walk back up to a parent.
+// Returns the removed family, or NULL if the ID is not in this subtree
+Family* removeFamilyFromNode(FamilyNode* node, int family_id) {
+    int i = keyLowerBound(node->keys, node->num_keys, family_id);
+
+    if (i < node->num_keys && node->keys[i] == family_id) {
+        Family* removed = node->families[i];
+        if (node->is_leaf) {
+            for (int k = i; k < node->num_keys - 1; k++) {
+                node->keys[k] = node->keys[k + 1];
+                node->families[k] = node->families[k + 1];
             }
+            node->num_keys--;
+            return removed;
         }
-        
-        // Add the parent's key to the current node
-        node->keys[0] = parent->keys[nodeIndex - 1];
-        node->families[0] = parent->families[nodeIndex - 1];
-        node->num_keys++;
-        
-        // Move the last key from left sibling to parent
-        parent->keys[nodeIndex - 1] = leftSibling->keys[leftSibling->num_keys - 1];
-        parent->families[nodeIndex - 1] = leftSibling->families[leftSibling->num_keys - 1];
-        
-        // If not a leaf, move the child pointer too
-        if (!node->is_leaf) {
-            node->children[0] = leftSibling->children[leftSibling->num_keys];
+
+        if (node->children[i]->num_keys > MIN_KEYS) {
+            // Replace the key with its predecessor, then delete that from the left subtree
+            FamilyNode* pred = node->children[i];
+            while (!pred->is_leaf) pred = pred->children[pred->num_keys];
+            int key = pred->keys[pred->num_keys - 1];
+            Family* family = pred->families[pred->num_keys - 1];
+            removeFamilyFromNode(node->children[i], key);
+            node->keys[i] = key;
+            node->families[i] = family;
+        } else if (node->children[i + 1]->num_keys > MIN_KEYS) {
+            // Replace the key with its successor, then delete that from the right subtree
+            FamilyNode* succ = node->children[i + 1];
+            while (!succ->is_leaf) succ = succ->children[0];
+            int key = succ->keys[0];
+            Family* family = succ->families[0];
+            removeFamilyFromNode(node->children[i + 1], key);
+            node->keys[i] = key;
+            node->families[i] = family;
+        } else {
+            // Both neighbours are minimal: merge them around the key and delete it from there
+            mergeFamilyNodes(node, i);
+            removeFamilyFromNode(node->children[i], family_id);
         }
-        
-        leftSibling->num_keys--;
-        return;
+        return removed;
     }
-    
-    // If both siblings have minimum keys, merge with one of them
-    if (nodeIndex < parent->num_keys) {
-        // Merge with right sibling
-        mergeFamilyNodes(tree, parent, nodeIndex);
-    } else {
-        // Merge with left sibling
-        mergeFamilyNodes(tree, parent, nodeIndex - 1);
+
+    if (node->is_leaf) return NULL;
+    if (node->children[i]->num_keys <= MIN_KEYS) i = fillFamilyChild(node, i);
+    return removeFamilyFromNode(node->children[i], family_id);
+}
+
+// Function to delete a family from the B-Tree in one top-down pass and free its record;
+// returns 0 if it is not there
+int deleteFamilyFromTree(FamilyTree* familyTree, int family_id) {
+    if (!familyTree || !familyTree->root) {
+        return 0;
+    }
+
+    Family* removed = removeFamilyFromNode(familyTree->root, family_id);
+
+    // A merge below the root can leave it without keys: its only child becomes the root
+    FamilyNode* root = familyTree->root;
+    if (root->num_keys == 0) {
+        familyTree->root = root->is_leaf ? NULL : root->children[0];
+        poolFree(&familyNodePool, root);
     }
+
+    if (!removed) {
+        return 0;  // Family not found
+    }
+    unmapFamilyMembers(removed);
+    freeFamily(removed);
+    familyTree->count--;
+    return 1;
 }
 
-// Helper function to find parent node
-FamilyNode* findParentNode(FamilyNode* root, FamilyNode* child) {
-    if (!root || root == child) {
-        return NULL;
+int deleteFamily(FamilyTree* familyTree, int family_id, const char* filename) {
+    // Step 1: Delete family from in-memory tree
+    int result = deleteFamilyFromTree(familyTree, family_id);
+    if (result == 0) {
+        printf("Family with ID %d not found.\n", family_id);
+        return 0; // Family not found
     }
-    
-    // Check if any of the children matches
-    for (int i = 0; i <= root->num_keys; i++) {
-        if (root->children[i] == child) {
-            return root;
-        }
+
+    // Step 2: Save updated tree to file
+    saveFamiliesToFile(familyTree, filename, "temp_file.txt");
+
+    printf("Family with ID %d deleted successfully.\n", family_id);
+    return 1; // Successful deletion
+}
+
+// Helper function to list the families of a subtree in ID order; returns the new count
+int collectFamilies(FamilyNode* node, Family** out, int count) {
+    if (!node) return count;
+    for (int i = 0; i < node->num_keys; i++) {
+        if (!node->is_leaf) count = collectFamilies(node->children[i], out, count);
+        out[count++] = node->families[i];
     }
-    
-    // If not found, recurse into non-leaf children
-    if (!root->is_leaf) {
-        for (int i = 0; i <= root->num_keys; i++) {
-            FamilyNode* parent = findParentNode(root->children[i], child);
-            if (parent) {
-                return parent;
-            }
-        }
+    if (!node->is_leaf) count = collectFamilies(node->children[node->num_keys], out, count);
+    return count;
+}
+
+// Function to return every node of a family subtree to the pool (the families themselves stay)
+void freeFamilyNodes(FamilyNode* node) {
+    if (!node) return;
+    if (!node->is_leaf) {
+        for (int i = 0; i <= node->num_keys; i++) freeFamilyNodes(node->children[i]);
     }
-    
-    return NULL;
+    poolFree(&familyNodePool, node);
 }
 
-// Helper function to merge two family nodes
-void mergeFamilyNodes(FamilyTree* tree, FamilyNode* parent, int index) {
-    FamilyNode* child = parent->children[index];
-    FamilyNode* sibling = parent->children[index + 1];
-    
-    // Add key from parent to child
-    child->keys[child->num_keys] = parent->keys[index];
-    child->families[child->num_keys] = parent->families[index];
-    child->num_keys++;
-    
-    // Copy all keys from sibling to child
-    for (int i = 0; i < sibling->num_keys; i++) {
-        child->keys[child->num_keys] = sibling->keys[i];
-        child->families[child->num_keys] = sibling->families[i];
-        child->num_keys++;
+// Helper function to build a subtree of the given height from families sorted by ID.
+// Every child gets an even share of the keys left over after the separators, so all
+// leaves end up at the same depth with between MIN_KEYS and MAX_KEYS keys in each node
+FamilyNode* buildFamilySubtree(Family** sorted, int count, int height) {
+    FamilyNode* node = createFamilyNode();
+    if (height == 0) {
+        for (int i = 0; i < count; i++) {
+            node->keys[i] = sorted[i]->family_id;
+            node->families[i] = sorted[i];
+        }
+        node->num_keys = count;
+        return node;
+    }
+
+    // A full subtree one level down holds capacity - 1 keys
+    long capacity = 1;
+    for (int h = 0; h < height; h++) capacity *= MAX_CHILDREN;
+    int children = (int)((count + capacity) / capacity);
+    if (children < 2) children = 2;
+
+    node->is_leaf = 0;
+    int rest = count - (children - 1);
+    int next = 0;
+    for (int c = 0; c < children; c++) {
+        int take = rest / children + (c < rest % children ? 1 : 0);
+        node->children[c] = buildFamilySubtree(sorted + next, take, height - 1);
+        next += take;
+        if (c < children - 1) {
+            node->keys[c] = sorted[next]->family_id;
+            node->families[c] = sorted[next];
+            next++;
+        }
     }
-    
-    // If not leaf nodes, copy child pointers too
-    if (!child->is_leaf) {
-        for (int i = 0; i <= sibling->num_keys; i++) {
-            child->children[child->num_keys - sibling->num_keys + i] = sibling->children[i];
+    node->num_keys = children - 1;
+    return node;
+}
+
+// Build a family B-tree bottom-up from families sorted by unique family_id, at the
+// smallest height that can hold them
+FamilyNode* buildFamilyTree(Family** sorted, int count) {
+    if (count <= 0) return NULL;
+    int height = 0;
+    for (long capacity = MAX_CHILDREN; capacity - 1 < count; capacity *= MAX_CHILDREN) height++;
+    return buildFamilySubtree(sorted, count, height);
+}
+
+// Function to delete a batch of families; returns how many were removed. A few go through
+// deleteFamilyFromTree; when the batch holds a large share of the tree the survivors are
+// collected in one in-order pass and rebuilt bottom-up instead
+int deleteFamiliesFromTree(FamilyTree* familyTree, const int* family_ids, int count) {
+    if (!familyTree || !familyTree->root || count <= 0) return 0;
+
+    int removed = 0;
+    if (count <= familyTree->count / 4) {
+        for (int i = 0; i < count; i++) {
+            removed += deleteFamilyFromTree(familyTree, family_ids[i]);
         }
+        return removed;
     }
-    
-    // Remove key from parent and adjust pointers
-    for (int i = index; i < parent->num_keys - 1; i++) {
-        parent->keys[i] = parent->keys[i + 1];
-        parent->families[i] = parent->families[i + 1];
-        parent->children[i + 1] = parent->children[i + 2];
+
+    long long* doomed = (long long*)malloc(count * sizeof(long long));
+    Family** families = (Family**)malloc(familyTree->count * sizeof(Family*));
+    if (!doomed || !families) {
+        printf("Memory allocation failed\n");
+        free(doomed);
+        free(families);
+        return 0;
     }
-    parent->num_keys--;
-    
-    // Free the sibling node
-    free(sibling);
-    
-    // If parent becomes empty, make child the new root
-    if (parent == tree->root && parent->num_keys == 0) {
-        tree->root = child;
-        free(parent);
-    } else if (parent->num_keys < MIN_KEYS) {
-        // Balance the parent if it has too few keys
-        balanceFamilyTree(tree, parent);
+    for (int i = 0; i < count; i++) doomed[i] = family_ids[i];
+    sortIndexKeys(doomed, count);
+
+    // Walk the families and the sorted batch side by side, keeping the families not in it
+    int total = collectFamilies(familyTree->root, families, 0);
+    int kept = 0, d = 0;
+    for (int i = 0; i < total; i++) {
+        while (d < count && doomed[d] < families[i]->family_id) d++;
+        if (d < count && doomed[d] == families[i]->family_id) {
+            unmapFamilyMembers(families[i]);
+            freeFamily(families[i]);
+            removed++;
+        } else {
+            families[kept++] = families[i];
+        }
     }
+
+    freeFamilyNodes(familyTree->root);
+    familyTree->root = buildFamilyTree(families, kept);
+    familyTree->count = kept;
+    free(doomed);
+    free(families);
+    return removed;
 }
 
 
@@ -2321,7 +3955,7 @@ void writeUsersRecursive(UserNode* node, FILE* file) {
         writeUsersRecursive(node->left, file);
         
         // Write the current user's data
-        fprintf(file, "%d,%s,%.2f\n", node->user_id, node->user_name, node->income);
+        fprintf(file, "%d,%s,%.2f\n", node->user_id, node->user_name, centsToUnits(node->income));
         
         writeUsersRecursive(node->right, file);
     }
@@ -2353,217 +3987,2007 @@ void saveUsersToFile(UserNode* root, const char* filename) {
 // Full B+ tree deletion implementation
 void DeleteExpense(ExpenseNode** root, int expense_id) {
     if (!*root) return;
-    ExpenseNode* node = *root;
-    while (!node->is_leaf) {
-        int pos = 0;
-        while (pos < node->num_keys && expense_id > node->keys[pos]) pos++;
-        node = node->children[pos];
+    
+    // The secondary indexes are keyed on the record's fields, so read it before it goes
+    ExpenseCursor c = expenseCursorSeek(*root, expense_id);
+    if (!expenseCursorValid(&c) || expenseCursorKey(&c) != expense_id) return;
+    Expense removed = expenseCursorGet(&c);
+    if (!removeExpenseFromTree(root, expense_id)) return;
+    indexExpenseRemoved(&removed);
+}
+
+// Delete from any expense tree without touching the indexes; returns 0 if the ID is absent
+int removeExpenseFromTree(ExpenseNode** root, int expense_id) {
+    if (!*root || !deleteExpenseFromNode(*root, expense_id)) return 0;
+    
+    // Shrink the tree height while the root is an internal node with a single child
+    while (!(*root)->is_leaf && (*root)->num_keys == 0) {
+        ExpenseNode* oldRoot = *root;
+        *root = EXP_INNER(oldRoot)->children[0];
+        freeExpenseNode(oldRoot);
+        expenseTreeVersion++;
     }
-    int pos = -1;
-    for (int i = 0; i < node->num_keys; i++) {
-        if (node->keys[i] == expense_id) pos = i;
+    return 1;
+}
+
+// Helper function to get the smallest key stored under a node
+int subtreeMinKey(ExpenseNode* node) {
+    return leftmostExpenseLeaf(node)->keys[0];
+}
+
+// Recursive delete: removes expense_id below node and rebalances the child it
+// came from, so every non-root node stays at or above its minimum occupancy
+int deleteExpenseFromNode(ExpenseNode* node, int expense_id) {
+    if (node->is_leaf) {
+        ExpenseLeafNode* leaf = EXP_LEAF(node);
+        int pos = keyLowerBound(leaf->keys, node->num_keys, expense_id);
+        if (pos >= node->num_keys || leaf->keys[pos] != expense_id) return 0;
+        // Shift every column left
+        for (int i = pos; i < node->num_keys-1; i++) {
+            copyLeafRow(leaf, i, leaf, i+1);
+        }
+        node->num_keys--;
+        return 1;
+    }
+    
+    ExpenseInnerNode* inner = EXP_INNER(node);
+    int pos = findChildIndex(node, expense_id);
+    ExpenseNode* child = inner->children[pos];
+    if (!deleteExpenseFromNode(child, expense_id)) return 0;
+    
+    // The deleted key may have been this node's separator: replace it with the child's new minimum
+    if (pos > 0 && inner->keys[pos-1] == expense_id && child->num_keys > 0) {
+        inner->keys[pos-1] = subtreeMinKey(child);
+    }
+    
+    int minimum = child->is_leaf ? EXPENSE_LEAF_MIN : EXPENSE_INNER_MIN;
+    if (child->num_keys < minimum || child->num_keys == 0) {
+        rebalanceExpenseChild(inner, pos);
+        // Borrowing or merging may have changed the child and either neighbour
+        int last = pos + 1 < node->num_keys ? pos + 1 : node->num_keys;
+        for (int i = pos > 0 ? pos - 1 : 0; i <= last; i++) {
+            refreshChildAggregate(inner, i);
+        }
+    } else {
+        refreshChildAggregate(inner, pos);
+    }
+    return 1;
+}
+
+// Function to fix an underfull child: borrow one entry from a sibling that can
+// spare it, otherwise merge with a sibling and drop their separator from the parent
+void rebalanceExpenseChild(ExpenseInnerNode* parent, int index) {
+    ExpenseNode* child = parent->children[index];
+    ExpenseNode* left = index > 0 ? parent->children[index-1] : NULL;
+    ExpenseNode* right = index < parent->header.num_keys ? parent->children[index+1] : NULL;
+    int minimum = child->is_leaf ? EXPENSE_LEAF_MIN : EXPENSE_INNER_MIN;
+    expenseTreeVersion++;
+    
+    if (child->is_leaf) {
+        ExpenseLeafNode* leaf = EXP_LEAF(child);
+        if (right && right->num_keys > minimum) {
+            // Borrow the first record of the right sibling
+            ExpenseLeafNode* from = EXP_LEAF(right);
+            copyLeafRow(leaf, child->num_keys, from, 0);
+            child->num_keys++;
+            for (int i = 0; i < right->num_keys-1; i++) copyLeafRow(from, i, from, i+1);
+            right->num_keys--;
+            parent->keys[index] = from->keys[0];
+            if (index > 0) parent->keys[index-1] = leaf->keys[0];
+            return;
+        }
+        if (left && left->num_keys > minimum) {
+            // Borrow the last record of the left sibling
+            ExpenseLeafNode* from = EXP_LEAF(left);
+            for (int i = child->num_keys; i > 0; i--) copyLeafRow(leaf, i, leaf, i-1);
+            copyLeafRow(leaf, 0, from, left->num_keys-1);
+            child->num_keys++;
+            left->num_keys--;
+            parent->keys[index-1] = leaf->keys[0];
+            return;
+        }
+        // Merge with a sibling; the right node of the pair is emptied into the left one and freed
+        if (!right) {
+            index--;
+            right = child;
+            child = left;
+        }
+        ExpenseLeafNode* into = EXP_LEAF(child);
+        ExpenseLeafNode* from = EXP_LEAF(right);
+        for (int i = 0; i < right->num_keys; i++) copyLeafRow(into, child->num_keys + i, from, i);
+        child->num_keys += right->num_keys;
+        into->next = from->next;
+        if (from->next) from->next->prev = into;
+    } else {
+        ExpenseInnerNode* node = EXP_INNER(child);
+        if (right && right->num_keys > minimum) {
+            // Rotate through the parent: separator comes down, right's first key goes up
+            ExpenseInnerNode* from = EXP_INNER(right);
+            node->keys[child->num_keys] = parent->keys[index];
+            node->children[child->num_keys+1] = from->children[0];
+            node->aggs[child->num_keys+1] = from->aggs[0];
+            child->num_keys++;
+            parent->keys[index] = from->keys[0];
+            for (int i = 0; i < right->num_keys-1; i++) from->keys[i] = from->keys[i+1];
+            for (int i = 0; i < right->num_keys; i++) {
+                from->children[i] = from->children[i+1];
+                from->aggs[i] = from->aggs[i+1];
+            }
+            right->num_keys--;
+            return;
+        }
+        if (left && left->num_keys > minimum) {
+            // Rotate through the parent: separator comes down, left's last key goes up
+            ExpenseInnerNode* from = EXP_INNER(left);
+            for (int i = child->num_keys; i > 0; i--) node->keys[i] = node->keys[i-1];
+            for (int i = child->num_keys+1; i > 0; i--) {
+                node->children[i] = node->children[i-1];
+                node->aggs[i] = node->aggs[i-1];
+            }
+            node->keys[0] = parent->keys[index-1];
+            node->children[0] = from->children[left->num_keys];
+            node->aggs[0] = from->aggs[left->num_keys];
+            child->num_keys++;
+            parent->keys[index-1] = from->keys[left->num_keys-1];
+            left->num_keys--;
+            return;
+        }
+        if (!right) {
+            index--;
+            right = child;
+            child = left;
+        }
+        ExpenseInnerNode* into = EXP_INNER(child);
+        ExpenseInnerNode* from = EXP_INNER(right);
+        into->keys[child->num_keys] = parent->keys[index];
+        for (int i = 0; i < right->num_keys; i++) into->keys[child->num_keys + 1 + i] = from->keys[i];
+        for (int i = 0; i <= right->num_keys; i++) {
+            into->children[child->num_keys + 1 + i] = from->children[i];
+            into->aggs[child->num_keys + 1 + i] = from->aggs[i];
+        }
+        child->num_keys += right->num_keys + 1;
+    }
+    
+    // Drop the separator and the merged-away sibling from the parent
+    for (int i = index; i < parent->header.num_keys-1; i++) {
+        parent->keys[i] = parent->keys[i+1];
+        parent->children[i+1] = parent->children[i+2];
+        parent->aggs[i+1] = parent->aggs[i+2];
+    }
+    parent->header.num_keys--;
+    freeExpenseNode(right);
+}
+
+// Function to delete every expense with an ID in [start_id, end_id]; returns how many were removed.
+// Small ranges go through DeleteExpense; when the range holds a large share of
+// the tree the survivors are rebuilt bottom-up instead.
+int DeleteExpenseRange(ExpenseNode** root, int start_id, int end_id) {
+    if (!*root || start_id > end_id) return 0;
+    
+    int total = CountExpenses(*root);
+    int capacity = 64, count = 0;
+    int* ids = (int*)malloc(capacity * sizeof(int));
+    if (!ids) {
+        printf("Memory allocation failed\n");
+        return 0;
+    }
+    for (ExpenseCursor c = expenseCursorSeek(*root, start_id); expenseCursorValid(&c); expenseCursorNext(&c)) {
+        if (expenseCursorKey(&c) > end_id) break;
+        if (count == capacity) {
+            capacity *= 2;
+            int* grown = (int*)realloc(ids, capacity * sizeof(int));
+            if (!grown) {
+                printf("Memory allocation failed\n");
+                free(ids);
+                return 0;
+            }
+            ids = grown;
+        }
+        ids[count++] = expenseCursorKey(&c);
+    }
+    
+    if (count > total / 4) {
+        Expense* survivors = (Expense*)malloc((total - count + 1) * sizeof(Expense));
+        if (!survivors) {
+            printf("Memory allocation failed\n");
+            free(ids);
+            return 0;
+        }
+        int kept = 0;
+        for (ExpenseCursor c = expenseCursorFirst(*root); expenseCursorValid(&c); expenseCursorNext(&c)) {
+            int key = expenseCursorKey(&c);
+            if (key < start_id || key > end_id) {
+                survivors[kept++] = expenseCursorGet(&c);
+            }
+        }
+        freeExpenseTree(*root);
+        *root = buildExpenseTree(survivors, kept);
+        reindexExpenses(*root);
+        free(survivors);
+    } else {
+        for (int i = 0; i < count; i++) {
+            DeleteExpense(root, ids[i]);
+        }
+    }
+    
+    free(ids);
+    return count;
+}
+
+// Function to pack (major, expense_id) into one index key that sorts by major, then by expense_id
+long long makeIndexKey(int major, int expense_id) {
+    return (long long)major * 4294967296LL + ((long long)expense_id + 2147483648LL);
+}
+
+// Function to get the expense_id back out of an index key
+int indexKeyExpenseID(long long key) {
+    long long low = key % 4294967296LL;
+    if (low < 0) low += 4294967296LL;
+    return (int)(low - 2147483648LL);
+}
+
+// Function to get the major part (user_id, date, ...) back out of an index key
+int indexKeyMajor(long long key) {
+    long long low = key % 4294967296LL;
+    if (low < 0) low += 4294967296LL;
+    return (int)((key - low) / 4294967296LL);
+}
+
+// Helper function to create an empty secondary index node
+ExpenseIndexNode *createIndexNode(int isLeaf) {
+    ExpenseIndexNode *node = (ExpenseIndexNode *)poolAlloc(&expenseIndexPool);
+    if (node == NULL) {
+        printf("Memory allocation failed\n");
+        exit(1);
+    }
+    node->num_keys = 0;
+    node->is_leaf = isLeaf;
+    node->next = NULL;
+    node->prev = NULL;
+    for (int i = 0; i <= EXPENSE_INDEX_KEYS; i++) {
+        node->children[i] = NULL;
+    }
+    return node;
+}
+
+// Index of the first key >= key in a sorted run of index keys
+int indexKeyLowerBound(const long long *keys, int n, long long key) {
+    int lo = 0, hi = n;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (keys[mid] < key) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+// Child to descend into for key (separators are the smallest key of their right subtree)
+int indexChildIndex(const ExpenseIndexNode *node, long long key) {
+    int lo = 0, hi = node->num_keys;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (node->keys[mid] <= key) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+// Recursive insert; returns the new right sibling when node split, with its first key in *pUpKey
+ExpenseIndexNode *indexInsertIntoNode(ExpenseIndexNode *node, long long key, long long *pUpKey, int *pAdded) {
+    long long tempKeys[EXPENSE_INDEX_KEYS + 1];
+    ExpenseIndexNode *tempChildren[EXPENSE_INDEX_KEYS + 2];
+    
+    if (node->is_leaf) {
+        int pos = indexKeyLowerBound(node->keys, node->num_keys, key);
+        if (pos < node->num_keys && node->keys[pos] == key) return NULL;
+        *pAdded = 1;
+        if (node->num_keys < EXPENSE_INDEX_KEYS) {
+            for (int i = node->num_keys; i > pos; i--) node->keys[i] = node->keys[i-1];
+            node->keys[pos] = key;
+            node->num_keys++;
+            return NULL;
+        }
+        
+        // Full leaf: split the keys plus the new one between this leaf and a new right sibling
+        for (int i = 0, j = 0; i <= EXPENSE_INDEX_KEYS; i++) {
+            tempKeys[i] = (i == pos) ? key : node->keys[j++];
+        }
+        ExpenseIndexNode *right = createIndexNode(1);
+        int split = (EXPENSE_INDEX_KEYS + 1) / 2;
+        node->num_keys = split;
+        for (int i = 0; i < split; i++) node->keys[i] = tempKeys[i];
+        for (int i = split; i <= EXPENSE_INDEX_KEYS; i++) right->keys[right->num_keys++] = tempKeys[i];
+        right->next = node->next;
+        if (node->next) node->next->prev = right;
+        node->next = right;
+        right->prev = node;
+        *pUpKey = right->keys[0];
+        return right;
+    }
+    
+    int pos = indexChildIndex(node, key);
+    long long childKey;
+    ExpenseIndexNode *newChild = indexInsertIntoNode(node->children[pos], key, &childKey, pAdded);
+    if (!newChild) return NULL;
+    
+    if (node->num_keys < EXPENSE_INDEX_KEYS) {
+        for (int i = node->num_keys; i > pos; i--) {
+            node->keys[i] = node->keys[i-1];
+            node->children[i+1] = node->children[i];
+        }
+        node->keys[pos] = childKey;
+        node->children[pos+1] = newChild;
+        node->num_keys++;
+        return NULL;
+    }
+    
+    // Full internal node: the middle key moves up and is kept in neither half
+    for (int i = 0, j = 0; i <= EXPENSE_INDEX_KEYS; i++) {
+        tempKeys[i] = (i == pos) ? childKey : node->keys[j++];
+    }
+    for (int i = 0, j = 0; i <= EXPENSE_INDEX_KEYS + 1; i++) {
+        tempChildren[i] = (i == pos + 1) ? newChild : node->children[j++];
+    }
+    int mid = (EXPENSE_INDEX_KEYS + 1) / 2;
+    ExpenseIndexNode *right = createIndexNode(0);
+    node->num_keys = mid;
+    for (int i = 0; i < mid; i++) {
+        node->keys[i] = tempKeys[i];
+        node->children[i] = tempChildren[i];
+    }
+    node->children[mid] = tempChildren[mid];
+    for (int i = mid + 1; i <= EXPENSE_INDEX_KEYS; i++) {
+        right->keys[right->num_keys] = tempKeys[i];
+        right->children[right->num_keys] = tempChildren[i];
+        right->num_keys++;
+    }
+    right->children[right->num_keys] = tempChildren[EXPENSE_INDEX_KEYS + 1];
+    for (int i = mid + 1; i <= EXPENSE_INDEX_KEYS; i++) node->children[i] = NULL;
+    *pUpKey = tempKeys[mid];
+    return right;
+}
+
+// Function to add a key to a secondary index (a key already present is left alone)
+void expenseIndexInsert(ExpenseIndex *index, long long key) {
+    if (!index->root) index->root = createIndexNode(1);
+    long long upKey;
+    int added = 0;
+    ExpenseIndexNode *right = indexInsertIntoNode(index->root, key, &upKey, &added);
+    if (right) {
+        ExpenseIndexNode *newRoot = createIndexNode(0);
+        newRoot->keys[0] = upKey;
+        newRoot->children[0] = index->root;
+        newRoot->children[1] = right;
+        newRoot->num_keys = 1;
+        index->root = newRoot;
+    }
+    index->count += added;
+}
+
+// Helper function to fix an underfull child of an index node by borrowing from or merging with a sibling
+void indexRebalanceChild(ExpenseIndexNode *parent, int index) {
+    ExpenseIndexNode *child = parent->children[index];
+    ExpenseIndexNode *left = index > 0 ? parent->children[index-1] : NULL;
+    ExpenseIndexNode *right = index < parent->num_keys ? parent->children[index+1] : NULL;
+    
+    if (right && right->num_keys > EXPENSE_INDEX_MIN) {
+        if (child->is_leaf) {
+            child->keys[child->num_keys++] = right->keys[0];
+            parent->keys[index] = right->keys[1];
+            if (index > 0) parent->keys[index-1] = child->keys[0];
+        } else {
+            child->keys[child->num_keys] = parent->keys[index];
+            child->children[++child->num_keys] = right->children[0];
+            parent->keys[index] = right->keys[0];
+            for (int i = 0; i < right->num_keys; i++) right->children[i] = right->children[i+1];
+        }
+        for (int i = 0; i < right->num_keys - 1; i++) right->keys[i] = right->keys[i+1];
+        right->num_keys--;
+        return;
+    }
+    if (left && left->num_keys > EXPENSE_INDEX_MIN) {
+        for (int i = child->num_keys; i > 0; i--) child->keys[i] = child->keys[i-1];
+        if (child->is_leaf) {
+            child->keys[0] = left->keys[left->num_keys-1];
+            parent->keys[index-1] = child->keys[0];
+        } else {
+            for (int i = child->num_keys + 1; i > 0; i--) child->children[i] = child->children[i-1];
+            child->keys[0] = parent->keys[index-1];
+            child->children[0] = left->children[left->num_keys];
+            parent->keys[index-1] = left->keys[left->num_keys-1];
+        }
+        child->num_keys++;
+        left->num_keys--;
+        return;
+    }
+    
+    // Merge the right node of the pair into the left one
+    if (!right) {
+        index--;
+        right = child;
+        child = left;
+    }
+    if (child->is_leaf) {
+        for (int i = 0; i < right->num_keys; i++) child->keys[child->num_keys + i] = right->keys[i];
+        child->num_keys += right->num_keys;
+        child->next = right->next;
+        if (right->next) right->next->prev = child;
+    } else {
+        child->keys[child->num_keys] = parent->keys[index];
+        for (int i = 0; i < right->num_keys; i++) child->keys[child->num_keys + 1 + i] = right->keys[i];
+        for (int i = 0; i <= right->num_keys; i++) child->children[child->num_keys + 1 + i] = right->children[i];
+        child->num_keys += right->num_keys + 1;
+    }
+    for (int i = index; i < parent->num_keys - 1; i++) {
+        parent->keys[i] = parent->keys[i+1];
+        parent->children[i+1] = parent->children[i+2];
+    }
+    parent->num_keys--;
+    poolFree(&expenseIndexPool, right);
+}
+
+// Recursive delete; returns 1 if the key was found
+int indexDeleteFromNode(ExpenseIndexNode *node, long long key) {
+    if (node->is_leaf) {
+        int pos = indexKeyLowerBound(node->keys, node->num_keys, key);
+        if (pos >= node->num_keys || node->keys[pos] != key) return 0;
+        for (int i = pos; i < node->num_keys - 1; i++) node->keys[i] = node->keys[i+1];
+        node->num_keys--;
+        return 1;
+    }
+    
+    int pos = indexChildIndex(node, key);
+    ExpenseIndexNode *child = node->children[pos];
+    if (!indexDeleteFromNode(child, key)) return 0;
+    
+    // Keep the separator equal to the smallest key of its right subtree
+    if (pos > 0 && node->keys[pos-1] == key && child->num_keys > 0) {
+        ExpenseIndexNode *first = child;
+        while (!first->is_leaf) first = first->children[0];
+        node->keys[pos-1] = first->keys[0];
+    }
+    if (child->num_keys < EXPENSE_INDEX_MIN || child->num_keys == 0) {
+        indexRebalanceChild(node, pos);
+    }
+    return 1;
+}
+
+// Function to remove a key from a secondary index
+void expenseIndexDelete(ExpenseIndex *index, long long key) {
+    if (!index->root || !indexDeleteFromNode(index->root, key)) return;
+    index->count--;
+    while (!index->root->is_leaf && index->root->num_keys == 0) {
+        ExpenseIndexNode *oldRoot = index->root;
+        index->root = oldRoot->children[0];
+        poolFree(&expenseIndexPool, oldRoot);
+    }
+}
+
+// Helper function to free every node of a secondary index
+void freeIndexNodes(ExpenseIndexNode *node) {
+    if (!node) return;
+    if (!node->is_leaf) {
+        for (int i = 0; i <= node->num_keys; i++) freeIndexNodes(node->children[i]);
+    }
+    poolFree(&expenseIndexPool, node);
+}
+
+// Function to replace the contents of a secondary index with sorted, unique keys, built bottom-up
+void expenseIndexBuild(ExpenseIndex *index, const long long *sorted, int count) {
+    freeIndexNodes(index->root);
+    index->root = NULL;
+    index->count = count;
+    if (count == 0) return;
+    
+    int nodeCount = (count + EXPENSE_INDEX_KEYS - 1) / EXPENSE_INDEX_KEYS;
+    ExpenseIndexNode **level = (ExpenseIndexNode **)malloc(nodeCount * sizeof(ExpenseIndexNode *));
+    long long *minKeys = (long long *)malloc(nodeCount * sizeof(long long));
+    if (!level || !minKeys) {
+        printf("Memory allocation failed\n");
+        exit(1);
+    }
+    
+    ExpenseIndexNode *prev = NULL;
+    int next = 0;
+    for (int l = 0; l < nodeCount; l++) {
+        int take = count / nodeCount + (l < count % nodeCount ? 1 : 0);
+        ExpenseIndexNode *leaf = createIndexNode(1);
+        for (int j = 0; j < take; j++) leaf->keys[j] = sorted[next++];
+        leaf->num_keys = take;
+        leaf->prev = prev;
+        if (prev) prev->next = leaf;
+        prev = leaf;
+        level[l] = leaf;
+        minKeys[l] = leaf->keys[0];
+    }
+    while (nodeCount > 1) {
+        int parents = (nodeCount + EXPENSE_INDEX_KEYS) / (EXPENSE_INDEX_KEYS + 1);
+        int child = 0;
+        for (int p = 0; p < parents; p++) {
+            int take = nodeCount / parents + (p < nodeCount % parents ? 1 : 0);
+            ExpenseIndexNode *inner = createIndexNode(0);
+            long long firstKey = minKeys[child];
+            inner->children[0] = level[child];
+            for (int k = 1; k < take; k++) {
+                inner->keys[k - 1] = minKeys[child + k];
+                inner->children[k] = level[child + k];
+            }
+            inner->num_keys = take - 1;
+            child += take;
+            level[p] = inner;
+            minKeys[p] = firstKey;
+        }
+        nodeCount = parents;
+    }
+    index->root = level[0];
+    free(level);
+    free(minKeys);
+}
+
+// Cursor on the first index key >= key
+ExpenseIndexCursor expenseIndexSeek(const ExpenseIndex *index, long long key) {
+    ExpenseIndexCursor cursor = {NULL, 0};
+    ExpenseIndexNode *node = index->root;
+    if (!node) return cursor;
+    while (!node->is_leaf) node = node->children[indexChildIndex(node, key)];
+    cursor.leaf = node;
+    cursor.index = indexKeyLowerBound(node->keys, node->num_keys, key);
+    while (cursor.leaf && cursor.index >= cursor.leaf->num_keys) {
+        cursor.leaf = cursor.leaf->next;
+        cursor.index = 0;
+    }
+    if (cursor.leaf) PREFETCH(cursor.leaf->next);
+    return cursor;
+}
+
+int expenseIndexValid(const ExpenseIndexCursor *cursor) {
+    return cursor->leaf != NULL;
+}
+
+long long expenseIndexKey(const ExpenseIndexCursor *cursor) {
+    return cursor->leaf->keys[cursor->index];
+}
+
+void expenseIndexNext(ExpenseIndexCursor *cursor) {
+    if (++cursor->index < cursor->leaf->num_keys) return;
+    do {
+        cursor->leaf = cursor->leaf->next;
+    } while (cursor->leaf && cursor->leaf->num_keys == 0);
+    cursor->index = 0;
+    if (cursor->leaf) PREFETCH(cursor->leaf->next);
+}
+
+// Helper function to rebuild one secondary index from the records of an expense tree
+void buildIndexFromTree(ExpenseIndex *index, ExpenseNode *root, int byDate) {
+    int total = CountExpenses(root);
+    long long *keys = (long long *)malloc((total + 1) * sizeof(long long));
+    if (!keys) {
+        printf("Memory allocation failed\n");
+        return;
+    }
+    int n = 0;
+    for (ExpenseCursor c = expenseCursorFirst(root); expenseCursorValid(&c); expenseCursorNext(&c)) {
+        int major = byDate ? c.leaf->date_keys[c.index] : c.leaf->user_ids[c.index];
+        keys[n++] = makeIndexKey(major, c.leaf->keys[c.index]);
+    }
+    sortIndexKeys(keys, n);
+    expenseIndexBuild(index, keys, n);
+    index->attached = 1;
+    free(keys);
+}
+
+// Function to build the secondary indexes from an expense tree and keep them maintained from now on
+void attachExpenseIndexes(ExpenseNode *root) {
+    buildIndexFromTree(&userExpenseIndex, root, 0);
+    buildIndexFromTree(&dateExpenseIndex, root, 1);
+}
+
+// Function to drop the secondary indexes; queries fall back to scanning the expense tree
+void detachExpenseIndexes(void) {
+    ExpenseIndex *indexes[] = { &userExpenseIndex, &dateExpenseIndex };
+    for (int i = 0; i < 2; i++) {
+        freeIndexNodes(indexes[i]->root);
+        indexes[i]->root = NULL;
+        indexes[i]->count = 0;
+        indexes[i]->attached = 0;
+    }
+}
+
+// Helper function to sort index keys (merge sort, like sortExpensesByID)
+void sortIndexKeys(long long *keys, int count) {
+    if (count < 2) return;
+    long long *temp = (long long *)malloc(count * sizeof(long long));
+    if (!temp) {
+        printf("Memory allocation failed\n");
+        exit(1);
+    }
+    for (int width = 1; width < count; width *= 2) {
+        for (int lo = 0; lo < count; lo += 2 * width) {
+            int mid = lo + width < count ? lo + width : count;
+            int hi = lo + 2 * width < count ? lo + 2 * width : count;
+            int i = lo, j = mid, k = lo;
+            while (i < mid && j < hi) temp[k++] = keys[i] <= keys[j] ? keys[i++] : keys[j++];
+            while (i < mid) temp[k++] = keys[i++];
+            while (j < hi) temp[k++] = keys[j++];
+        }
+        memcpy(keys, temp, count * sizeof(long long));
+    }
+    free(temp);
+}
+
+// Index maintenance hooks, called by the public expense tree entry points
+void indexExpenseInserted(const Expense *expense) {
+    if (userExpenseIndex.attached) {
+        expenseIndexInsert(&userExpenseIndex, makeIndexKey(expense->user_id, expense->expense_id));
+    }
+    if (dateExpenseIndex.attached) {
+        expenseIndexInsert(&dateExpenseIndex, makeIndexKey(expense->date_key, expense->expense_id));
+    }
+    partitionExpenseInserted(expense);
+    rollupExpenseChanged(expense, 1);
+    categoryExpenseChanged(expense, 1);
+    familyExpenseChanged(expense, 1);
+}
+
+void indexExpenseRemoved(const Expense *expense) {
+    if (userExpenseIndex.attached) {
+        expenseIndexDelete(&userExpenseIndex, makeIndexKey(expense->user_id, expense->expense_id));
+    }
+    if (dateExpenseIndex.attached) {
+        expenseIndexDelete(&dateExpenseIndex, makeIndexKey(expense->date_key, expense->expense_id));
+    }
+    partitionExpenseRemoved(expense);
+    rollupExpenseChanged(expense, -1);
+    categoryExpenseChanged(expense, -1);
+    familyExpenseChanged(expense, -1);
+}
+
+// An edit in place: re-key everything if the owner or date moved, else refresh the copies
+void indexExpenseUpdated(const Expense *previous, const Expense *updated) {
+    if (previous->user_id != updated->user_id || previous->date_key != updated->date_key) {
+        indexExpenseRemoved(previous);
+        indexExpenseInserted(updated);
+        return;
+    }
+    partitionExpenseUpdated(updated);
+    rollupExpenseChanged(previous, -1);
+    rollupExpenseChanged(updated, 1);
+    familyExpenseChanged(previous, -1);
+    familyExpenseChanged(updated, 1);
+    if (previous->category != updated->category) {
+        categoryExpenseChanged(previous, -1);
+        categoryExpenseChanged(updated, 1);
+    }
+}
+
+// Rebuild the attached indexes after the expense tree was rebuilt wholesale
+void reindexExpenses(ExpenseNode *root) {
+    if (userExpenseIndex.attached) buildIndexFromTree(&userExpenseIndex, root, 0);
+    if (dateExpenseIndex.attached) buildIndexFromTree(&dateExpenseIndex, root, 1);
+    if (expensePartitions.attached) attachExpensePartitions(root);
+    if (expenseRollup.attached) attachExpenseRollup(root);
+    if (categoryBitmapsAttached) attachCategoryBitmaps(root);
+    if (maintainedFamilies) attachFamilyExpenseTotals(maintainedFamilies, root);
+}
+
+// Function to set up a scan filter for a set of users, any date and any category
+void initScanFilter(ExpenseScanFilter *filter, const int *user_ids, int count) {
+    filter->member_count = count < SCAN_MEMBERS ? count : SCAN_MEMBERS;
+    for (int j = 0; j < filter->member_count; j++) {
+        filter->user_ids[j] = user_ids[j];
+        // A repeated user counts once, under its first position
+        for (int k = 0; k < j; k++) {
+            if (user_ids[k] == user_ids[j]) filter->user_ids[j] = INT_MIN;
+        }
+    }
+    filter->date_from = INT_MIN;
+    filter->date_to = INT_MAX;
+    filter->category_mask = SCAN_ANY_CATEGORY;
+}
+
+// Function to narrow a scan filter to one calendar month
+void scanFilterMonth(ExpenseScanFilter *filter, int year, int month) {
+    filter->date_from = year * 10000 + month * 100;
+    filter->date_to = year * 10000 + month * 100 + 99;
+}
+
+// Helper function to test one row against a scan filter; returns the position of its owner
+// in the filter's user_ids, or -1 if the row does not pass
+int scanRowMember(const ExpenseScanFilter *filter, int user_id, int date_key, int category) {
+    if (date_key < filter->date_from || date_key > filter->date_to) return -1;
+    if (filter->category_mask != SCAN_ANY_CATEGORY &&
+        ((unsigned int)category >= 32 || !((filter->category_mask >> category) & 1))) return -1;
+    for (int j = 0; j < filter->member_count; j++) {
+        if (filter->user_ids[j] == user_id) return j;
+    }
+    return -1;
+}
+
+// Helper function to set the selection bits of up to 8 rows starting at row
+void scanMarkRows(unsigned long long *selected, int row, unsigned int bits) {
+    int shift = row & 63;
+    selected[row >> 6] |= (unsigned long long)bits << shift;
+    if (shift > 56) {
+        unsigned long long spill = bits >> (64 - shift);
+        if (spill) selected[(row >> 6) + 1] |= spill;
+    }
+}
+
+// Scalar scan: test rows [from, to) of a leaf one at a time, set the bit of each row that
+// passes in selected and add its amount to totals (either may be NULL). Returns the rows passed
+int scanLeafRowsScalar(const ExpenseLeafNode *leaf, int from, int to, const ExpenseScanFilter *filter, unsigned long long *selected, ExpenseScanTotals *totals) {
+    int passed = 0;
+    for (int i = from; i < to; i++) {
+        int member = scanRowMember(filter, leaf->user_ids[i], leaf->date_keys[i], leaf->categories[i]);
+        if (member < 0) continue;
+        passed++;
+        if (selected) selected[i >> 6] |= 1ULL << (i & 63);
+        if (totals) {
+            totals->count++;
+            totals->sum += leaf->amounts[i];
+            totals->member_counts[member]++;
+            totals->member_sums[member] += leaf->amounts[i];
+        }
+    }
+    return passed;
+}
+
+#ifdef KEY_SEARCH_SIMD
+// SSE2 scan: the date, category and owner tests run on 4 rows per compare. The lanes that pass
+// give the selection bits (movemask) and, widened to 64 bits, pick the amounts to add up
+int scanLeafRowsSSE2(const ExpenseLeafNode *leaf, int from, int to, const ExpenseScanFilter *filter, unsigned long long *selected, ExpenseScanTotals *totals) {
+    __m128i date_from = _mm_set1_epi32(filter->date_from);
+    __m128i date_to = _mm_set1_epi32(filter->date_to);
+    __m128i users[SCAN_MEMBERS], sums[SCAN_MEMBERS], wanted[32];
+    int counts[SCAN_MEMBERS] = {0};
+    for (int j = 0; j < filter->member_count; j++) {
+        users[j] = _mm_set1_epi32(filter->user_ids[j]);
+        sums[j] = _mm_setzero_si128();
+    }
+    int wanted_count = 0;
+    if (filter->category_mask != SCAN_ANY_CATEGORY) {
+        for (unsigned int bits = filter->category_mask; bits; bits &= bits - 1) {
+            wanted[wanted_count++] = _mm_set1_epi32(__builtin_ctz(bits));
+        }
+    }
+    int passed = 0;
+    int i = from;
+    for (; i + 4 <= to; i += 4) {
+        __m128i dates = _mm_loadu_si128((const __m128i *)(leaf->date_keys + i));
+        __m128i outside = _mm_or_si128(_mm_cmpgt_epi32(date_from, dates), _mm_cmpgt_epi32(dates, date_to));
+        __m128i pass = _mm_andnot_si128(outside, _mm_set1_epi32(-1));
+        if (filter->category_mask != SCAN_ANY_CATEGORY) {
+            __m128i categories = _mm_loadu_si128((const __m128i *)(leaf->categories + i));
+            __m128i in = _mm_setzero_si128();
+            for (int c = 0; c < wanted_count; c++) in = _mm_or_si128(in, _mm_cmpeq_epi32(categories, wanted[c]));
+            pass = _mm_and_si128(pass, in);
+        }
+        __m128i owners = _mm_loadu_si128((const __m128i *)(leaf->user_ids + i));
+        unsigned int rows = 0;
+        for (int j = 0; j < filter->member_count; j++) {
+            __m128i hit = _mm_and_si128(pass, _mm_cmpeq_epi32(owners, users[j]));
+            int bits = _mm_movemask_ps(_mm_castsi128_ps(hit));
+            if (!bits) continue;
+            rows |= bits;
+            counts[j] += __builtin_popcount(bits);
+            __m128i low = _mm_loadu_si128((const __m128i *)(leaf->amounts + i));
+            __m128i high = _mm_loadu_si128((const __m128i *)(leaf->amounts + i + 2));
+            sums[j] = _mm_add_epi64(sums[j], _mm_and_si128(low, _mm_unpacklo_epi32(hit, hit)));
+            sums[j] = _mm_add_epi64(sums[j], _mm_and_si128(high, _mm_unpackhi_epi32(hit, hit)));
+        }
+        if (!rows) continue;
+        passed += __builtin_popcount(rows);
+        if (selected) scanMarkRows(selected, i, rows);
+    }
+    if (totals) {
+        for (int j = 0; j < filter->member_count; j++) {
+            long long lanes[2];
+            _mm_storeu_si128((__m128i *)lanes, sums[j]);
+            totals->member_counts[j] += counts[j];
+            totals->member_sums[j] += lanes[0] + lanes[1];
+            totals->count += counts[j];
+            totals->sum += lanes[0] + lanes[1];
+        }
+    }
+    return passed + scanLeafRowsScalar(leaf, i, to, filter, selected, totals);
+}
+
+// AVX2 scan: same tests with 8 rows per compare, the amounts added 4 at a time
+__attribute__((target("avx2")))
+int scanLeafRowsAVX2(const ExpenseLeafNode *leaf, int from, int to, const ExpenseScanFilter *filter, unsigned long long *selected, ExpenseScanTotals *totals) {
+    __m256i date_from = _mm256_set1_epi32(filter->date_from);
+    __m256i date_to = _mm256_set1_epi32(filter->date_to);
+    __m256i users[SCAN_MEMBERS], sums[SCAN_MEMBERS], wanted[32];
+    int counts[SCAN_MEMBERS] = {0};
+    for (int j = 0; j < filter->member_count; j++) {
+        users[j] = _mm256_set1_epi32(filter->user_ids[j]);
+        sums[j] = _mm256_setzero_si256();
+    }
+    int wanted_count = 0;
+    if (filter->category_mask != SCAN_ANY_CATEGORY) {
+        for (unsigned int bits = filter->category_mask; bits; bits &= bits - 1) {
+            wanted[wanted_count++] = _mm256_set1_epi32(__builtin_ctz(bits));
+        }
+    }
+    int passed = 0;
+    int i = from;
+    for (; i + 8 <= to; i += 8) {
+        __m256i dates = _mm256_loadu_si256((const __m256i *)(leaf->date_keys + i));
+        __m256i outside = _mm256_or_si256(_mm256_cmpgt_epi32(date_from, dates), _mm256_cmpgt_epi32(dates, date_to));
+        __m256i pass = _mm256_andnot_si256(outside, _mm256_set1_epi32(-1));
+        if (filter->category_mask != SCAN_ANY_CATEGORY) {
+            __m256i categories = _mm256_loadu_si256((const __m256i *)(leaf->categories + i));
+            __m256i in = _mm256_setzero_si256();
+            for (int c = 0; c < wanted_count; c++) in = _mm256_or_si256(in, _mm256_cmpeq_epi32(categories, wanted[c]));
+            pass = _mm256_and_si256(pass, in);
+        }
+        __m256i owners = _mm256_loadu_si256((const __m256i *)(leaf->user_ids + i));
+        unsigned int rows = 0;
+        for (int j = 0; j < filter->member_count; j++) {
+            __m256i hit = _mm256_and_si256(pass, _mm256_cmpeq_epi32(owners, users[j]));
+            int bits = _mm256_movemask_ps(_mm256_castsi256_ps(hit));
+            if (!bits) continue;
+            rows |= bits;
+            counts[j] += __builtin_popcount(bits);
+            __m256i low = _mm256_loadu_si256((const __m256i *)(leaf->amounts + i));
+            __m256i high = _mm256_loadu_si256((const __m256i *)(leaf->amounts + i + 4));
+            sums[j] = _mm256_add_epi64(sums[j], _mm256_and_si256(low, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(hit))));
+            sums[j] = _mm256_add_epi64(sums[j], _mm256_and_si256(high, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(hit, 1))));
+        }
+        if (!rows) continue;
+        passed += __builtin_popcount(rows);
+        if (selected) scanMarkRows(selected, i, rows);
+    }
+    if (totals) {
+        for (int j = 0; j < filter->member_count; j++) {
+            long long lanes[4];
+            _mm256_storeu_si256((__m256i *)lanes, sums[j]);
+            long long sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+            totals->member_counts[j] += counts[j];
+            totals->member_sums[j] += sum;
+            totals->count += counts[j];
+            totals->sum += sum;
+        }
+    }
+    return passed + scanLeafRowsSSE2(leaf, i, to, filter, selected, totals);
+}
+#endif
+
+// Kernel chosen on first use from what the CPU supports
+int (*leafScanImpl)(const ExpenseLeafNode *leaf, int from, int to, const ExpenseScanFilter *filter, unsigned long long *selected, ExpenseScanTotals *totals) = NULL;
+const char *leafScanImplName = "scalar";
+
+void selectLeafScanKernel(void) {
+    leafScanImpl = scanLeafRowsScalar;
+    leafScanImplName = "scalar";
+#ifdef KEY_SEARCH_SIMD
+    leafScanImpl = scanLeafRowsSSE2;
+    leafScanImplName = "sse2";
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        leafScanImpl = scanLeafRowsAVX2;
+        leafScanImplName = "avx2";
+    }
+#endif
+}
+
+// Function to run the scan kernel over rows [from, to) of a leaf; selected, when given, is
+// cleared first and comes back with the bits of the rows that passed
+int scanLeafRows(const ExpenseLeafNode *leaf, int from, int to, const ExpenseScanFilter *filter, unsigned long long *selected, ExpenseScanTotals *totals) {
+    if (!leafScanImpl) selectLeafScanKernel();
+    if (selected) memset(selected, 0, SCAN_MASK_WORDS * sizeof(unsigned long long));
+    return leafScanImpl(leaf, from, to, filter, selected, totals);
+}
+
+// Name of the scan kernel in use, for benchmarks
+const char *leafScanKernelName(void) {
+    if (!leafScanImpl) selectLeafScanKernel();
+    return leafScanImplName;
+}
+
+// Helper function to find the first selected row in [row, end); returns -1 if there is none
+int nextSelectedRow(const unsigned long long *selected, int row, int end) {
+    while (row < end) {
+        unsigned long long word = selected[row >> 6] >> (row & 63);
+        if (word) {
+            row += bitmapLowestBit(word);
+            return row < end ? row : -1;
+        }
+        row = (row | 63) + 1;
+    }
+    return -1;
+}
+
+// Helper function to get the category bitmap that can skip ahead for a one-category filter
+const CategoryBitmap *scanFilterBitmap(const ExpenseScanFilter *filter) {
+    unsigned int mask = filter->category_mask;
+    if (mask == SCAN_ANY_CATEGORY || mask == 0 || (mask & (mask - 1)) != 0) return NULL;
+    return categoryBitmapFor(bitmapLowestBit(mask));
+}
+
+// Function to add up the expenses that pass a filter, by member: row by row with a member
+// cursor when the user index or a category bitmap can skip ahead (use_index only for the
+// main tree, which the index covers), else with the scan kernel over every leaf
+void scanExpenseTotals(ExpenseNode *root, const ExpenseScanFilter *filter, int use_index, ExpenseScanTotals *totals) {
+    memset(totals, 0, sizeof(*totals));
+    if (!root) return;
+    if (use_index || scanFilterBitmap(filter)) {
+        for (MemberExpenseCursor c = memberCursorOpen(root, filter, INT_MIN, use_index); memberCursorValid(&c); memberCursorNext(&c)) {
+            long long amount = c.rec.leaf->amounts[c.rec.index];
+            totals->count++;
+            totals->sum += amount;
+            totals->member_counts[c.member]++;
+            totals->member_sums[c.member] += amount;
+        }
+        return;
+    }
+    for (ExpenseLeafNode *leaf = leftmostExpenseLeaf(root); leaf; leaf = leaf->next) {
+        prefetchExpenseLeaf(leaf->next);
+        scanLeafRows(leaf, 0, leaf->header.num_keys, filter, NULL, totals);
+    }
+}
+
+// Totals of the given users' expenses, the counterpart of memberCursorStart
+void memberExpenseTotals(ExpenseNode *root, const int *user_ids, int count, ExpenseScanTotals *totals) {
+    ExpenseScanFilter filter;
+    initScanFilter(&filter, user_ids, count);
+    scanExpenseTotals(root, &filter, userExpenseIndex.attached, totals);
+}
+
+// Totals of the given users' expenses in one month, from the month's partition when attached
+void monthMemberTotals(ExpenseNode *root, const int *user_ids, int count, int year, int month, ExpenseScanTotals *totals) {
+    ExpenseScanFilter filter;
+    initScanFilter(&filter, user_ids, count);
+    scanFilterMonth(&filter, year, month);
+    if (expensePartitions.attached) {
+        scanExpenseTotals(expensePartitionRoot(root, year, month), &filter, 0, totals);
+        return;
+    }
+    scanExpenseTotals(root, &filter, userExpenseIndex.attached, totals);
+}
+
+// Totals of the given users' expenses in one category
+void categoryMemberTotals(ExpenseNode *root, const int *user_ids, int count, int category, ExpenseScanTotals *totals) {
+    ExpenseScanFilter filter;
+    initScanFilter(&filter, user_ids, count);
+    filter.category_mask = (unsigned int)category < 32 ? 1u << category : 0;
+    scanExpenseTotals(root, &filter, userExpenseIndex.attached, totals);
+}
+
+// Helper function to move a record cursor to expense_id, stepping within the current
+// or next leaf when it is close (IDs arrive in ascending order) before descending from the root
+ExpenseCursor seekExpenseFrom(ExpenseNode *root, ExpenseCursor from, int expense_id) {
+    for (int hop = 0; hop < 2 && from.leaf; hop++, from.leaf = from.leaf->next, from.index = 0) {
+        int n = from.leaf->header.num_keys;
+        if (n > 0 && from.leaf->keys[n-1] >= expense_id) {
+            from.index += keyLowerBound(from.leaf->keys + from.index, n - from.index, expense_id);
+            return from;
+        }
+    }
+    return expenseCursorSeek(root, expense_id);
+}
+
+// Helper function to settle a member cursor on the next member record that passes its filter
+void memberCursorSettle(MemberExpenseCursor *cursor) {
+    if (!cursor->use_index) {
+        // Filtered scan: the kernel selects a leaf's passing rows once, on entering the leaf
+        while (expenseCursorValid(&cursor->rec)) {
+            ExpenseLeafNode *leaf = cursor->rec.leaf;
+            if (cursor->selected_leaf != leaf) {
+                if (cursor->category) {
+                    // Jump ahead to the next ID in the category
+                    int id = expenseCursorKey(&cursor->rec), next;
+                    if (!bitmapNextFrom(cursor->category, id, &next)) {
+                        cursor->rec.leaf = NULL;
+                        return;
+                    }
+                    if (next != id) {
+                        cursor->rec = seekExpenseFrom(cursor->root, cursor->rec, next);
+                        continue;
+                    }
+                }
+                scanLeafRows(leaf, cursor->rec.index, leaf->header.num_keys, &cursor->filter, cursor->selected, NULL);
+                cursor->selected_leaf = leaf;
+            }
+            int row = nextSelectedRow(cursor->selected, cursor->rec.index, leaf->header.num_keys);
+            if (row >= 0) {
+                cursor->rec.index = row;
+                cursor->member = scanRowMember(&cursor->filter, leaf->user_ids[row], leaf->date_keys[row], leaf->categories[row]);
+                return;
+            }
+            cursor->rec.index = leaf->header.num_keys - 1;
+            expenseCursorNext(&cursor->rec);
+        }
+        return;
+    }
+    
+    for (;;) {
+        int best = -1, bestID = 0;
+        for (int j = 0; j < cursor->filter.member_count; j++) {
+            ExpenseIndexCursor *head = &cursor->heads[j];
+            long long key = 0;
+            // Step over index entries outside the category without visiting their records
+            for (; expenseIndexValid(head); expenseIndexNext(head)) {
+                key = expenseIndexKey(head);
+                if (indexKeyMajor(key) != cursor->filter.user_ids[j] || !cursor->category) break;
+                if (bitmapContains(cursor->category, indexKeyExpenseID(key))) break;
+            }
+            if (!expenseIndexValid(head)) continue;
+            if (indexKeyMajor(key) != cursor->filter.user_ids[j]) {
+                head->leaf = NULL; // Ran past this member's entries
+                continue;
+            }
+            if (best < 0 || indexKeyExpenseID(key) < bestID) {
+                best = j;
+                bestID = indexKeyExpenseID(key);
+            }
+        }
+        if (best < 0) {
+            cursor->rec.leaf = NULL;
+            return;
+        }
+        cursor->member = best;
+        cursor->rec = seekExpenseFrom(cursor->root, cursor->rec, bestID);
+        // The index only knows the owner; the date and category are checked on the record
+        ExpenseLeafNode *leaf = cursor->rec.leaf;
+        int i = cursor->rec.index;
+        if (scanRowMember(&cursor->filter, leaf->user_ids[i], leaf->date_keys[i], leaf->categories[i]) >= 0) return;
+        expenseIndexNext(&cursor->heads[best]);
+    }
+}
+
+// Cursor over the expenses of the given users with expense IDs >= start_id
+MemberExpenseCursor memberCursorStart(ExpenseNode *root, const int *user_ids, int count, int start_id) {
+    ExpenseScanFilter filter;
+    initScanFilter(&filter, user_ids, count);
+    return memberCursorOpen(root, &filter, start_id, userExpenseIndex.attached);
+}
+
+// Cursor over the given users' expenses in one category. With the category bitmaps attached,
+// records of other categories are skipped by ID; otherwise the filter drops them
+MemberExpenseCursor categoryMemberCursorStart(ExpenseNode *root, const int *user_ids, int count, int start_id, int category) {
+    ExpenseScanFilter filter;
+    initScanFilter(&filter, user_ids, count);
+    filter.category_mask = (unsigned int)category < 32 ? 1u << category : 0;
+    return memberCursorOpen(root, &filter, start_id, userExpenseIndex.attached);
+}
+
+// Same, from a ready filter and choosing the strategy: use_index only for the main tree,
+// which the user index covers
+MemberExpenseCursor memberCursorOpen(ExpenseNode *root, const ExpenseScanFilter *filter, int start_id, int use_index) {
+    MemberExpenseCursor cursor;
+    cursor.root = root;
+    cursor.filter = *filter;
+    cursor.use_index = use_index;
+    cursor.category = scanFilterBitmap(filter);
+    cursor.member = 0;
+    cursor.rec.leaf = NULL;
+    cursor.rec.index = 0;
+    cursor.selected_leaf = NULL;
+    if (cursor.use_index) {
+        for (int j = 0; j < cursor.filter.member_count; j++) {
+            cursor.heads[j] = expenseIndexSeek(&userExpenseIndex, makeIndexKey(cursor.filter.user_ids[j], start_id));
+        }
+    }
+    if (!root) return cursor;
+    if (!cursor.use_index) cursor.rec = expenseCursorSeek(root, start_id);
+    memberCursorSettle(&cursor);
+    return cursor;
+}
+
+// Cursor over the expenses of up to SCAN_MEMBERS of a family's members, from member first on
+MemberExpenseCursor familyCursorStart(ExpenseNode *root, const Family *family, int first) {
+    int user_ids[SCAN_MEMBERS];
+    int count = familyMemberIDs(family, first, user_ids);
+    return memberCursorStart(root, user_ids, count, INT_MIN);
+}
+
+// Helper function to list the IDs of up to SCAN_MEMBERS of a family's members, from member
+// first on; an empty slot becomes INT_MIN so the positions still line up with the members.
+// No user is listed twice: createFamily and the loader keep a family's members distinct
+int familyMemberIDs(const Family *family, int first, int *user_ids) {
+    int count = 0;
+    for (int j = first; j < family->member_count && count < SCAN_MEMBERS; j++) {
+        UserNode* member = familyMember(family, j);
+        user_ids[count++] = member ? member->user_id : INT_MIN;
+    }
+    return count;
+}
+
+// Cursor over the given users' expenses in one month. With month partitions attached it
+// scans only that month's tree; otherwise it walks the users' expenses of every month and
+// the filter drops the other months
+MemberExpenseCursor monthMemberCursorStart(ExpenseNode *root, const int *user_ids, int count, int year, int month) {
+    ExpenseScanFilter filter;
+    initScanFilter(&filter, user_ids, count);
+    scanFilterMonth(&filter, year, month);
+    if (expensePartitions.attached) {
+        return memberCursorOpen(expensePartitionRoot(root, year, month), &filter, INT_MIN, 0);
+    }
+    return memberCursorOpen(root, &filter, INT_MIN, userExpenseIndex.attached);
+}
+
+int memberCursorValid(const MemberExpenseCursor *cursor) {
+    return cursor->rec.leaf != NULL;
+}
+
+void memberCursorNext(MemberExpenseCursor *cursor) {
+    if (cursor->use_index) {
+        expenseIndexNext(&cursor->heads[cursor->member]);
+    } else {
+        expenseCursorNext(&cursor->rec);
+    }
+    memberCursorSettle(cursor);
+}
+
+// Helper function to get the calendar month (YYYYMM) of a packed date
+int expenseMonthKey(int date_key) {
+    return date_key / 100;
+}
+
+// Function to find a month's partition, adding an empty one in month order if create is set;
+// the pointer is only good until the directory next changes
+ExpensePartition *findExpensePartition(int month_key, int create) {
+    ExpensePartitionDirectory *dir = &expensePartitions;
+    int lo = 0, hi = dir->count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (dir->parts[mid].month_key < month_key) lo = mid + 1;
+        else hi = mid;
+    }
+    if (lo < dir->count && dir->parts[lo].month_key == month_key) return &dir->parts[lo];
+    if (!create) return NULL;
+    
+    if (dir->count == dir->capacity) {
+        int capacity = dir->capacity ? dir->capacity * 2 : 16;
+        ExpensePartition *grown = (ExpensePartition *)realloc(dir->parts, capacity * sizeof(ExpensePartition));
+        if (!grown) {
+            printf("Memory allocation failed\n");
+            return NULL;
+        }
+        dir->parts = grown;
+        dir->capacity = capacity;
+    }
+    memmove(&dir->parts[lo + 1], &dir->parts[lo], (dir->count - lo) * sizeof(ExpensePartition));
+    dir->count++;
+    ExpensePartition *part = &dir->parts[lo];
+    part->month_key = month_key;
+    part->count = 0;
+    part->root = NULL;
+    part->loaded = 1;
+    part->frozen = 0;
+    return part;
+}
+
+// Function to free a partition's tree and remove it from the directory
+void dropExpensePartition(ExpensePartition *part) {
+    ExpensePartitionDirectory *dir = &expensePartitions;
+    if (part->loaded) freeExpenseTree(part->root);
+    int index = (int)(part - dir->parts);
+    memmove(part, part + 1, (dir->count - index - 1) * sizeof(ExpensePartition));
+    dir->count--;
+}
+
+// Function to split the records of an expense tree into month partitions and keep them
+// maintained from now on
+void attachExpensePartitions(ExpenseNode *root) {
+    detachExpensePartitions();
+    int total = CountExpenses(root);
+    Expense *all = (Expense *)malloc((total + 1) * sizeof(Expense));
+    Expense *byMonth = (Expense *)malloc((total + 1) * sizeof(Expense));
+    int *fill = NULL;
+    if (!all || !byMonth) {
+        printf("Memory allocation failed\n");
+        free(all);
+        free(byMonth);
+        return;
+    }
+    ExpenseCursor cursor = expenseCursorFirst(root);
+    int n = expenseCursorNextBatch(&cursor, all, total);
+    for (int i = 0; i < n; i++) {
+        ExpensePartition *part = findExpensePartition(expenseMonthKey(all[i].date_key), 1);
+        if (part) part->count++;
+    }
+    
+    // Records come out in ID order, so a stable scatter leaves each month's run sorted for bulk loading
+    fill = (int *)malloc((expensePartitions.count + 1) * sizeof(int));
+    if (!fill) {
+        printf("Memory allocation failed\n");
+        free(all);
+        free(byMonth);
+        return;
+    }
+    for (int p = 0, offset = 0; p < expensePartitions.count; p++) {
+        fill[p] = offset;
+        offset += expensePartitions.parts[p].count;
+    }
+    for (int i = 0; i < n; i++) {
+        ExpensePartition *part = findExpensePartition(expenseMonthKey(all[i].date_key), 0);
+        if (part) byMonth[fill[part - expensePartitions.parts]++] = all[i];
+    }
+    for (int p = 0, offset = 0; p < expensePartitions.count; p++) {
+        ExpensePartition *part = &expensePartitions.parts[p];
+        part->root = buildExpenseTree(byMonth + offset, part->count);
+        offset += part->count;
+    }
+    expensePartitions.attached = 1;
+    free(fill);
+    free(byMonth);
+    free(all);
+}
+
+// Function to free the month partitions; month-scoped reports go back to the main tree
+void detachExpensePartitions(void) {
+    for (int p = 0; p < expensePartitions.count; p++) {
+        if (expensePartitions.parts[p].loaded) freeExpenseTree(expensePartitions.parts[p].root);
+    }
+    free(expensePartitions.parts);
+    expensePartitions.parts = NULL;
+    expensePartitions.count = 0;
+    expensePartitions.capacity = 0;
+    expensePartitions.attached = 0;
+}
+
+// Partition maintenance hooks, called from the index hooks
+void partitionExpenseInserted(const Expense *expense) {
+    if (!expensePartitions.attached) return;
+    ExpensePartition *part = findExpensePartition(expenseMonthKey(expense->date_key), 1);
+    if (!part) return;
+    part->count++;
+    part->frozen = 0;
+    if (part->loaded) {
+        int duplicate;
+        part->root = insertExpenseIntoTree(part->root, *expense, &duplicate);
+    }
+}
+
+void partitionExpenseRemoved(const Expense *expense) {
+    if (!expensePartitions.attached) return;
+    ExpensePartition *part = findExpensePartition(expenseMonthKey(expense->date_key), 0);
+    if (!part) return;
+    part->count--;
+    part->frozen = 0;
+    if (part->loaded) removeExpenseFromTree(&part->root, expense->expense_id);
+    if (part->count == 0) dropExpensePartition(part);
+}
+
+// An edit that keeps the owner and date overwrites the copy in place
+void partitionExpenseUpdated(const Expense *expense) {
+    if (!expensePartitions.attached) return;
+    ExpensePartition *part = findExpensePartition(expenseMonthKey(expense->date_key), 0);
+    if (part && part->loaded) storeExpenseInTree(part->root, *expense, NULL);
+}
+
+// Function to rebuild an unloaded partition from the main tree (through the date index
+// when it is attached); returns 0 if memory runs out
+int loadExpensePartition(ExpenseNode *root, ExpensePartition *part) {
+    if (part->loaded) return 1;
+    ExpenseList month;
+    initExpenseList(&month);
+    collectExpensesInDateRange(root, part->month_key * 100, part->month_key * 100 + 99, 0, &month);
+    if (month.count != part->count) {
+        freeExpenseList(&month);
+        return 0;
+    }
+    part->root = buildExpenseTree(month.items, month.count);
+    part->loaded = 1;
+    freeExpenseList(&month);
+    return 1;
+}
+
+// Function to free the tree of a month that is no longer queried; it is rebuilt on the
+// next month-scoped report. Returns 0 if the month has no partition
+int unloadExpensePartition(int month_key) {
+    ExpensePartition *part = findExpensePartition(month_key, 0);
+    if (!part) return 0;
+    if (part->loaded) {
+        freeExpenseTree(part->root);
+        part->root = NULL;
+        part->loaded = 0;
+    }
+    part->frozen = 0;
+    return 1;
+}
+
+// Function to compact a month that is not expected to change: its tree is rebuilt bottom-up
+// with full nodes. Returns 0 if the month has no partition, or its tree could not be rebuilt
+int freezeExpensePartition(ExpenseNode *root, int month_key) {
+    ExpensePartition *part = findExpensePartition(month_key, 0);
+    if (!part) return 0;
+    if (part->frozen) return 1;
+    if (part->loaded) {
+        // Copy the month out in ID order. A tree that does not hold part->count records has
+        // diverged from the main tree (or memory ran out), so it is left as it is
+        ExpenseList month;
+        initExpenseList(&month);
+        for (ExpenseCursor c = expenseCursorFirst(part->root); expenseCursorValid(&c); expenseCursorNext(&c)) {
+            if (!appendExpenseToList(&month, expenseCursorGet(&c))) break;
+        }
+        if (month.count != part->count) {
+            freeExpenseList(&month);
+            return 0;
+        }
+        freeExpenseTree(part->root);
+        part->root = buildExpenseTree(month.items, month.count);
+        freeExpenseList(&month);
+    } else if (!loadExpensePartition(root, part)) {
+        return 0;
+    }
+    part->frozen = 1;
+    return 1;
+}
+
+// Function to get the tree of one month, loading it first if it was unloaded;
+// returns NULL when the month has no expenses
+ExpenseNode *expensePartitionRoot(ExpenseNode *root, int year, int month) {
+    ExpensePartition *part = findExpensePartition(year * 100 + month, 0);
+    if (!part) return NULL;
+    if (!part->loaded && !loadExpensePartition(root, part)) return NULL;
+    return part->root;
+}
+
+// Helper function to pack a rollup cell key; month_key 0 means all months, category 0 all categories
+long long rollupKey(int user_id, int month_key, int category) {
+    return makeIndexKey(user_id, month_key * 8 + category);
+}
+
+// Function to find a rollup cell, adding an empty one if create is set; NULL if absent (or out of memory)
+RollupCell *rollupFind(ExpenseRollup *rollup, long long key, int create) {
+    if (create && (rollup->used + 1) * 10 > rollup->capacity * 7 && !rollupGrow(rollup)) return NULL;
+    if (rollup->capacity == 0) return NULL;
+    
+    unsigned long long h = mixHash64((unsigned long long)key);
+    for (int slot = (int)(h & (rollup->capacity - 1));; slot = (slot + 1) & (rollup->capacity - 1)) {
+        RollupCell *cell = &rollup->cells[slot];
+        if (cell->used && cell->key == key) return cell;
+        if (!cell->used) {
+            if (!create) return NULL;
+            cell->used = 1;
+            cell->key = key;
+            cell->sum = 0;
+            cell->count = 0;
+            rollup->used++;
+            return cell;
+        }
+    }
+}
+
+// Helper function to double the rollup table and rehash its cells; returns 0 if memory runs out
+int rollupGrow(ExpenseRollup *rollup) {
+    int capacity = rollup->capacity ? rollup->capacity * 2 : EXPENSE_ROLLUP_INITIAL_SLOTS;
+    RollupCell *cells = (RollupCell *)calloc(capacity, sizeof(RollupCell));
+    if (!cells) return 0;
+    ExpenseRollup grown = { cells, capacity, 0, rollup->attached };
+    for (int i = 0; i < rollup->capacity; i++) {
+        if (rollup->cells[i].used) *rollupFind(&grown, rollup->cells[i].key, 1) = rollup->cells[i];
+    }
+    free(rollup->cells);
+    *rollup = grown;
+    return 1;
+}
+
+// Helper function to add an amount and a record count to one cell; returns 0 if memory runs out
+int rollupAdd(ExpenseRollup *rollup, long long key, long long amount, int count) {
+    RollupCell *cell = rollupFind(rollup, key, 1);
+    if (!cell) {
+        if (rollup == &expenseRollup && rollup->attached) {
+            // A rollup missing a cell would under-report, so the reports go back to the records
+            printf("Memory allocation failed; rollup reports disabled\n");
+            detachExpenseRollup();
+        } else {
+            printf("Memory allocation failed\n");
+        }
+        return 0;
+    }
+    cell->sum += amount;
+    cell->count += count;
+    return 1;
+}
+
+// Function to add (sign 1) or take back (sign -1) one expense in every cell it rolls up into;
+// stops and returns 0 at the first cell that cannot be added
+int rollupApplyExpense(ExpenseRollup *rollup, const Expense *expense, int sign) {
+    int month_key = expenseMonthKey(expense->date_key);
+    long long amount = sign * expense->amount;
+    // Reports only break down the five known categories
+    int known = expense->category >= RENT && expense->category <= LEISURE;
+    if (!rollupAdd(rollup, rollupKey(expense->user_id, 0, 0), amount, sign)) return 0;
+    if (known && !rollupAdd(rollup, rollupKey(expense->user_id, 0, expense->category), amount, sign)) return 0;
+    // A date that did not parse has no month to roll up into
+    if (month_key != 0) {
+        if (!rollupAdd(rollup, rollupKey(expense->user_id, month_key, 0), amount, sign)) return 0;
+        if (known && !rollupAdd(rollup, rollupKey(expense->user_id, month_key, expense->category), amount, sign)) return 0;
+    }
+    return 1;
+}
+
+// Rollup maintenance hook, called from the index hooks
+void rollupExpenseChanged(const Expense *expense, int sign) {
+    if (expenseRollup.attached) rollupApplyExpense(&expenseRollup, expense, sign);
+}
+
+// Function to fill a rollup from every record of an expense tree; returns 0 if memory runs out
+int buildExpenseRollup(ExpenseRollup *rollup, ExpenseNode *root) {
+    for (ExpenseCursor c = expenseCursorFirst(root); expenseCursorValid(&c); expenseCursorNext(&c)) {
+        Expense expense = expenseCursorGet(&c);
+        if (!rollupApplyExpense(rollup, &expense, 1)) return 0;
+    }
+    return 1;
+}
+
+// Function to release a rollup table
+void freeExpenseRollup(ExpenseRollup *rollup) {
+    free(rollup->cells);
+    rollup->cells = NULL;
+    rollup->capacity = 0;
+    rollup->used = 0;
+}
+
+// Function to build the rollup from an expense tree and keep it maintained from now on
+void attachExpenseRollup(ExpenseNode *root) {
+    freeExpenseRollup(&expenseRollup);
+    // Marked attached first so a build that runs out of memory detaches it again
+    expenseRollup.attached = 1;
+    buildExpenseRollup(&expenseRollup, root);
+}
+
+// Function to drop the rollup; the reports go back to reading the expense records
+void detachExpenseRollup(void) {
+    freeExpenseRollup(&expenseRollup);
+    expenseRollup.attached = 0;
+}
+
+// Function to read one total from the rollup
+long long rollupTotal(int user_id, int month_key, int category) {
+    RollupCell *cell = rollupFind(&expenseRollup, rollupKey(user_id, month_key, category), 0);
+    return cell ? cell->sum : 0;
+}
+
+// Consistency check: rebuild the rollup from a full rescan of the tree and compare it with
+// the maintained one, cell by cell in both directions. Returns the number of mismatches
+int verifyExpenseRollup(ExpenseNode *root) {
+    ExpenseRollup fresh = {NULL, 0, 0, 0};
+    buildExpenseRollup(&fresh, root);
+    int mismatches = 0;
+    for (int pass = 0; pass < 2; pass++) {
+        ExpenseRollup *from = pass == 0 ? &fresh : &expenseRollup;
+        ExpenseRollup *other = pass == 0 ? &expenseRollup : &fresh;
+        for (int i = 0; i < from->capacity; i++) {
+            RollupCell *cell = &from->cells[i];
+            if (!cell->used || (pass == 1 && cell->count == 0)) continue;
+            RollupCell *match = rollupFind(other, cell->key, 0);
+            int count = match ? match->count : 0;
+            long long sum = match ? match->sum : 0;
+            if (count != cell->count || sum != cell->sum) {
+                if (++mismatches <= 5) {
+                    int low = indexKeyExpenseID(cell->key);
+                    printf("Rollup mismatch: user %d, month %d, category %d: %d records / %.2f vs %d / %.2f\n",
+                           indexKeyMajor(cell->key), low / 8, low % 8, cell->count, centsToUnits(cell->sum), count, centsToUnits(sum));
+                }
+            }
+        }
+    }
+    freeExpenseRollup(&fresh);
+    return mismatches;
+}
+
+// Function to rank expenses by amount, over one month (YYYYMM) or all time (month_key 0),
+// from a pass over the leaf chain; with month partitions attached only that month is read
+void rankExpensesByAmount(ExpenseNode *root, int month_key, TopK *top) {
+    ExpenseNode *tree = root;
+    if (month_key != 0 && expensePartitions.attached) {
+        tree = expensePartitionRoot(root, month_key / 100, month_key % 100);
+    }
+    for (ExpenseLeafNode *leaf = leftmostExpenseLeaf(tree); leaf; leaf = leaf->next) {
+        for (int i = 0; i < leaf->header.num_keys; i++) {
+            if (month_key != 0 && expenseMonthKey(leaf->date_keys[i]) != month_key) continue;
+            topKOffer(top, leaf->keys[i], 1, leaf->amounts[i]);
+        }
+    }
+}
+
+// Helper function to get a rollup to rank from: the maintained one, or else one built into
+// scratch with only the (user, month_key) cells a ranking reads, so it holds one cell per
+// user who spent in that month; NULL if memory runs out
+ExpenseRollup *rankingRollup(ExpenseNode *root, int month_key, ExpenseRollup *scratch) {
+    if (expenseRollup.attached) return &expenseRollup;
+    ExpenseNode *tree = root;
+    if (month_key != 0 && expensePartitions.attached) {
+        tree = expensePartitionRoot(root, month_key / 100, month_key % 100);
+    }
+    for (ExpenseLeafNode *leaf = leftmostExpenseLeaf(tree); leaf; leaf = leaf->next) {
+        for (int i = 0; i < leaf->header.num_keys; i++) {
+            if (month_key != 0 && expenseMonthKey(leaf->date_keys[i]) != month_key) continue;
+            if (!rollupAdd(scratch, rollupKey(leaf->user_ids[i], month_key, 0), leaf->amounts[i], 1)) {
+                freeExpenseRollup(scratch);
+                return NULL;
+            }
+        }
+    }
+    return scratch;
+}
+
+// Function to rank users by spend over one month or all time, one rollup cell per user; with
+// a family only its members are ranked, from the rollup or else a scan of their records.
+// Returns 0 if memory runs out
+int rankUsersBySpend(ExpenseNode *root, const Family *family, int month_key, TopK *top) {
+    if (family) {
+        // The members go SCAN_MEMBERS at a time
+        for (int first = 0; first < family->member_count; first += SCAN_MEMBERS) {
+            int member_ids[SCAN_MEMBERS];
+            int member_count = familyMemberIDs(family, first, member_ids);
+            ExpenseScanTotals totals;
+            if (!expenseRollup.attached) {
+                if (month_key != 0) monthMemberTotals(root, member_ids, member_count, month_key / 100, month_key % 100, &totals);
+                else memberExpenseTotals(root, member_ids, member_count, &totals);
+            }
+            for (int m = 0; m < member_count; m++) {
+                if (member_ids[m] == INT_MIN) continue;
+                if (expenseRollup.attached) {
+                    RollupCell *cell = rollupFind(&expenseRollup, rollupKey(member_ids[m], month_key, 0), 0);
+                    if (cell && cell->count != 0) topKOffer(top, member_ids[m], cell->count, cell->sum);
+                } else if (totals.member_counts[m] != 0) {
+                    topKOffer(top, member_ids[m], totals.member_counts[m], totals.member_sums[m]);
+                }
+            }
+        }
+        return 1;
+    }
+    ExpenseRollup scratch = {NULL, 0, 0, 0};
+    ExpenseRollup *rollup = rankingRollup(root, month_key, &scratch);
+    if (!rollup) return 0;
+    for (int i = 0; i < rollup->capacity; i++) {
+        RollupCell *cell = &rollup->cells[i];
+        int low = indexKeyExpenseID(cell->key);
+        if (!cell->used || cell->count == 0 || low != month_key * 8) continue;
+        topKOffer(top, indexKeyMajor(cell->key), cell->count, cell->sum);
+    }
+    freeExpenseRollup(&scratch);
+    return 1;
+}
+
+// Helper function to offer every family of a B-tree subtree, scored by its members' rollup totals
+void rankFamilySubtree(FamilyNode *node, ExpenseRollup *rollup, int month_key, TopK *top) {
+    if (!node) return;
+    for (int i = 0; i < node->num_keys; i++) {
+        long long spend = 0;
+        int records = 0;
+        for (int j = 0; j < node->families[i]->member_count; j++) {
+            UserNode *member = familyMember(node->families[i], j);
+            RollupCell *cell = member ? rollupFind(rollup, rollupKey(member->user_id, month_key, 0), 0) : NULL;
+            if (!cell) continue;
+            spend += cell->sum;
+            records += cell->count;
+        }
+        topKOffer(top, node->keys[i], records, spend);
+    }
+    if (!node->is_leaf) {
+        for (int i = 0; i <= node->num_keys; i++) rankFamilySubtree(node->children[i], rollup, month_key, top);
+    }
+}
+
+// Function to rank families by their members' spend over one month or all time; returns 0
+// if memory runs out
+int rankFamiliesBySpend(FamilyTree *familyTree, ExpenseNode *root, int month_key, TopK *top) {
+    ExpenseRollup scratch = {NULL, 0, 0, 0};
+    ExpenseRollup *rollup = rankingRollup(root, month_key, &scratch);
+    if (!rollup) return 0;
+    rankFamilySubtree(familyTree->root, rollup, month_key, top);
+    freeExpenseRollup(&scratch);
+    return 1;
+}
+
+// Function to rank days by spend, for one family's members (or everyone when family is NULL),
+// over one month or all time; returns 0 if memory runs out
+int rankDaysBySpend(ExpenseNode *root, const Family *family, int month_key, TopK *top) {
+    DayTotals days;
+    initDayTotals(&days);
+    if (family) {
+        // The members go SCAN_MEMBERS at a time
+        for (int first = 0; first < family->member_count; first += SCAN_MEMBERS) {
+            int member_ids[SCAN_MEMBERS];
+            int member_count = familyMemberIDs(family, first, member_ids);
+            MemberExpenseCursor c = month_key != 0
+                ? monthMemberCursorStart(root, member_ids, member_count, month_key / 100, month_key % 100)
+                : memberCursorStart(root, member_ids, member_count, INT_MIN);
+            for (; memberCursorValid(&c); memberCursorNext(&c)) {
+                int date_key = c.rec.leaf->date_keys[c.rec.index];
+                if (month_key != 0 && expenseMonthKey(date_key) != month_key) continue;
+                if (!addDayTotal(&days, date_key, c.rec.leaf->amounts[c.rec.index])) {
+                    freeDayTotals(&days);
+                    return 0;
+                }
+            }
+        }
+    } else {
+        ExpenseNode *tree = root;
+        if (month_key != 0 && expensePartitions.attached) {
+            tree = expensePartitionRoot(root, month_key / 100, month_key % 100);
+        }
+        for (ExpenseLeafNode *leaf = leftmostExpenseLeaf(tree); leaf; leaf = leaf->next) {
+            for (int i = 0; i < leaf->header.num_keys; i++) {
+                if (month_key != 0 && expenseMonthKey(leaf->date_keys[i]) != month_key) continue;
+                if (!addDayTotal(&days, leaf->date_keys[i], leaf->amounts[i])) {
+                    freeDayTotals(&days);
+                    return 0;
+                }
+            }
+        }
+    }
+    offerDayTotals(&days, top);
+    freeDayTotals(&days);
+    return 1;
+}
+
+// Helper function to get the position of the lowest set bit of a non-zero word
+int bitmapLowestBit(unsigned long long word) {
+#if defined(__GNUC__)
+    return __builtin_ctzll(word);
+#else
+    int bit = 0;
+    while (!(word & 1)) {
+        word >>= 1;
+        bit++;
+    }
+    return bit;
+#endif
+}
+
+// Helper function to find the container for a high half; if there is none, returns
+// -(position + 1) for where it would go
+int bitmapFindContainer(const CategoryBitmap *bitmap, int high) {
+    int lo = 0, hi = bitmap->count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (bitmap->containers[mid].high < high) lo = mid + 1;
+        else hi = mid;
+    }
+    if (lo < bitmap->count && bitmap->containers[lo].high == high) return lo;
+    return -(lo + 1);
+}
+
+// Helper function to find the first slot of an array container holding a low half >= low
+int bitmapArrayLowerBound(const BitmapContainer *container, int low) {
+    int lo = 0, hi = container->cardinality;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (container->values[mid] < low) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+// Function to test whether an expense ID is in a bitmap
+int bitmapContains(const CategoryBitmap *bitmap, int expense_id) {
+    int pos = bitmapFindContainer(bitmap, expense_id >> 16);
+    if (pos < 0) return 0;
+    const BitmapContainer *container = &bitmap->containers[pos];
+    int low = expense_id & 0xFFFF;
+    if (container->bits) return (int)((container->bits[low >> 6] >> (low & 63)) & 1);
+    int i = bitmapArrayLowerBound(container, low);
+    return i < container->cardinality && container->values[i] == low;
+}
+
+// Function to add an expense ID to a bitmap; returns 0 if memory runs out
+int bitmapAdd(CategoryBitmap *bitmap, int expense_id) {
+    int high = expense_id >> 16, low = expense_id & 0xFFFF;
+    int pos = bitmapFindContainer(bitmap, high);
+    if (pos < 0) {
+        pos = -pos - 1;
+        if (bitmap->count == bitmap->capacity) {
+            int capacity = bitmap->capacity ? bitmap->capacity * 2 : 8;
+            BitmapContainer *grown = (BitmapContainer *)realloc(bitmap->containers, capacity * sizeof(BitmapContainer));
+            if (!grown) return 0;
+            bitmap->containers = grown;
+            bitmap->capacity = capacity;
+        }
+        memmove(&bitmap->containers[pos + 1], &bitmap->containers[pos], (bitmap->count - pos) * sizeof(BitmapContainer));
+        BitmapContainer empty = {high, 0, 0, NULL, NULL};
+        bitmap->containers[pos] = empty;
+        bitmap->count++;
+    }
+    
+    BitmapContainer *container = &bitmap->containers[pos];
+    if (container->bits) {
+        unsigned long long mask = 1ULL << (low & 63);
+        if (container->bits[low >> 6] & mask) return 1;
+        container->bits[low >> 6] |= mask;
+    } else {
+        int i = bitmapArrayLowerBound(container, low);
+        if (i < container->cardinality && container->values[i] == low) return 1;
+        if (container->cardinality == BITMAP_ARRAY_MAX) {
+            // A full array turns into a bit map
+            unsigned long long *bits = (unsigned long long *)calloc(BITMAP_WORDS, sizeof(unsigned long long));
+            if (!bits) return 0;
+            for (int k = 0; k < container->cardinality; k++) {
+                bits[container->values[k] >> 6] |= 1ULL << (container->values[k] & 63);
+            }
+            bits[low >> 6] |= 1ULL << (low & 63);
+            free(container->values);
+            container->values = NULL;
+            container->capacity = 0;
+            container->bits = bits;
+        } else {
+            if (container->cardinality == container->capacity) {
+                int capacity = container->capacity ? container->capacity * 2 : 4;
+                if (capacity > BITMAP_ARRAY_MAX) capacity = BITMAP_ARRAY_MAX;
+                unsigned short *grown = (unsigned short *)realloc(container->values, capacity * sizeof(unsigned short));
+                if (!grown) return 0;
+                container->values = grown;
+                container->capacity = capacity;
+            }
+            memmove(&container->values[i + 1], &container->values[i], (container->cardinality - i) * sizeof(unsigned short));
+            container->values[i] = (unsigned short)low;
+        }
+    }
+    container->cardinality++;
+    bitmap->cardinality++;
+    return 1;
+}
+
+// Function to remove an expense ID from a bitmap, dropping its container once empty
+void bitmapRemove(CategoryBitmap *bitmap, int expense_id) {
+    int pos = bitmapFindContainer(bitmap, expense_id >> 16);
+    if (pos < 0) return;
+    BitmapContainer *container = &bitmap->containers[pos];
+    int low = expense_id & 0xFFFF;
+    if (container->bits) {
+        unsigned long long mask = 1ULL << (low & 63);
+        if (!(container->bits[low >> 6] & mask)) return;
+        container->bits[low >> 6] &= ~mask;
+        // Back to an array at half the threshold, so a container near it does not flip back and forth
+        if (container->cardinality - 1 == BITMAP_ARRAY_MAX / 2) {
+            unsigned short *values = (unsigned short *)malloc((BITMAP_ARRAY_MAX / 2) * sizeof(unsigned short));
+            if (values) {
+                int n = 0;
+                for (int w = 0; w < BITMAP_WORDS; w++) {
+                    for (unsigned long long word = container->bits[w]; word; word &= word - 1) {
+                        values[n++] = (unsigned short)(w * 64 + bitmapLowestBit(word));
+                    }
+                }
+                free(container->bits);
+                container->bits = NULL;
+                container->values = values;
+                container->capacity = BITMAP_ARRAY_MAX / 2;
+            }
+        }
+    } else {
+        int i = bitmapArrayLowerBound(container, low);
+        if (i >= container->cardinality || container->values[i] != low) return;
+        memmove(&container->values[i], &container->values[i + 1], (container->cardinality - i - 1) * sizeof(unsigned short));
+    }
+    container->cardinality--;
+    bitmap->cardinality--;
+    if (container->cardinality == 0) {
+        free(container->values);
+        free(container->bits);
+        memmove(&bitmap->containers[pos], &bitmap->containers[pos + 1], (bitmap->count - pos - 1) * sizeof(BitmapContainer));
+        bitmap->count--;
+    }
+}
+
+// Function to find the smallest ID in a bitmap that is >= expense_id; returns 0 if there is none
+int bitmapNextFrom(const CategoryBitmap *bitmap, int expense_id, int *next) {
+    int low = expense_id & 0xFFFF;
+    int pos = bitmapFindContainer(bitmap, expense_id >> 16);
+    if (pos < 0) {
+        pos = -pos - 1;
+        low = 0;
+    }
+    for (; pos < bitmap->count; pos++, low = 0) {
+        const BitmapContainer *container = &bitmap->containers[pos];
+        if (container->bits) {
+            int w = low >> 6;
+            unsigned long long word = container->bits[w] & (~0ULL << (low & 63));
+            while (!word && ++w < BITMAP_WORDS) word = container->bits[w];
+            if (word) {
+                *next = container->high * 65536 + w * 64 + bitmapLowestBit(word);
+                return 1;
+            }
+        } else {
+            int i = bitmapArrayLowerBound(container, low);
+            if (i < container->cardinality) {
+                *next = container->high * 65536 + container->values[i];
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+// Function to release a bitmap's containers
+void freeCategoryBitmap(CategoryBitmap *bitmap) {
+    for (int i = 0; i < bitmap->count; i++) {
+        free(bitmap->containers[i].values);
+        free(bitmap->containers[i].bits);
+    }
+    free(bitmap->containers);
+    bitmap->containers = NULL;
+    bitmap->count = 0;
+    bitmap->capacity = 0;
+    bitmap->cardinality = 0;
+}
+
+// Category bitmap maintenance hook, called from the index hooks
+void categoryExpenseChanged(const Expense *expense, int sign) {
+    if (!categoryBitmapsAttached) return;
+    if (expense->category < RENT || expense->category > LEISURE) return;
+    CategoryBitmap *bitmap = &categoryBitmaps[expense->category];
+    if (sign < 0) {
+        bitmapRemove(bitmap, expense->expense_id);
+    } else if (!bitmapAdd(bitmap, expense->expense_id)) {
+        // A bitmap missing an ID would hide that record from category reports
+        printf("Memory allocation failed; category filters disabled\n");
+        detachCategoryBitmaps();
+    }
+}
+
+// Function to build the category bitmaps from an expense tree and keep them maintained from now on
+void attachCategoryBitmaps(ExpenseNode *root) {
+    detachCategoryBitmaps();
+    for (ExpenseCursor c = expenseCursorFirst(root); expenseCursorValid(&c); expenseCursorNext(&c)) {
+        int category = c.leaf->categories[c.index];
+        if (category < RENT || category > LEISURE) continue;
+        if (!bitmapAdd(&categoryBitmaps[category], c.leaf->keys[c.index])) {
+            printf("Memory allocation failed; category filters disabled\n");
+            detachCategoryBitmaps();
+            return;
+        }
+    }
+    categoryBitmapsAttached = 1;
+}
+
+// Function to drop the category bitmaps; category filters go back to reading the category column
+void detachCategoryBitmaps(void) {
+    for (int category = 0; category <= MAX_CATEGORY; category++) freeCategoryBitmap(&categoryBitmaps[category]);
+    categoryBitmapsAttached = 0;
+}
+
+// Function to get the bitmap for a category, or NULL when there is none to filter with
+const CategoryBitmap *categoryBitmapFor(int category) {
+    if (!categoryBitmapsAttached || category < RENT || category > LEISURE) return NULL;
+    return &categoryBitmaps[category];
+}
+
+
+// Helper function to zero the expense totals of every family in a subtree
+void resetFamilyExpenseTotals(FamilyNode* node) {
+    if (!node) return;
+    for (int i = 0; i < node->num_keys; i++) node->families[i]->total_monthly_expense = 0;
+    if (!node->is_leaf) {
+        for (int i = 0; i <= node->num_keys; i++) resetFamilyExpenseTotals(node->children[i]);
     }
-    if (pos == -1) return;
-    // Shift elements left
-    for (int i = pos; i < node->num_keys-1; i++) {
-        node->keys[i] = node->keys[i+1];
-        node->expenses[i] = node->expenses[i+1];
+}
+
+// Function to recompute every family's expense total in one pass over the expenses, then keep
+// the totals maintained from the expense hooks: each added, deleted or edited expense moves
+// only its owner's family total, and an owner change moves the amount between families
+void attachFamilyExpenseTotals(FamilyTree* tree, ExpenseNode* root) {
+    maintainedFamilies = tree;
+    if (!tree) return;
+    resetFamilyExpenseTotals(tree->root);
+    for (ExpenseCursor c = expenseCursorFirst(root); expenseCursorValid(&c); expenseCursorNext(&c)) {
+        Expense expense = expenseCursorGet(&c);
+        Family* family = familyOfUser(expense.user_id);
+        if (family) family->total_monthly_expense += expense.amount;
     }
-    node->num_keys--;
 }
 
+// Function to stop maintaining the family totals; they keep their last values
+void detachFamilyExpenseTotals(void) {
+    maintainedFamilies = NULL;
+}
 
-// Add this function definition to your code
+// Family total maintenance hook, called from the index hooks
+void familyExpenseChanged(const Expense* expense, int sign) {
+    if (!maintainedFamilies) return;
+    Family* family = familyOfUser(expense->user_id);
+    if (family) family->total_monthly_expense += sign * expense->amount;
+}
 
-// Helper to recalculate expenses for families containing a user
-void UpdateFamilyExpenses(FamilyTree* tree, ExpenseNode* expenses, int user_id) {
-    // Traverse all families (B-tree traversal)
-    
-    TraverseAndUpdateFamilies(tree->root, expenses, user_id);
+// Helper function to add up all of a user's expenses: one rollup lookup when the rollup is
+// attached, else the user's entries in userExpenseIndex (the scan kernel without the index)
+long long userExpenseTotal(ExpenseNode* root, int user_id) {
+    if (expenseRollup.attached) return rollupTotal(user_id, 0, 0);
+    ExpenseScanTotals totals;
+    memberExpenseTotals(root, &user_id, 1, &totals);
+    return totals.sum;
+}
+
+// Function to take a member's expenses out of the family's total before the member leaves;
+// the expenses stay behind, so no expense hook will do it. Without maintained totals the
+// family is recomputed, still counting the member, so the member's share is taken off after
+void familyMemberLeaving(Family* family, ExpenseNode* root, int user_id) {
+    if (maintainedFamilies) {
+        family->total_monthly_expense -= userExpenseTotal(root, user_id);
+    } else {
+        family->total_monthly_expense = calculateTotalMonthlyExpense(root, family) - userExpenseTotal(root, user_id);
+    }
 }
 
-void TraverseAndUpdateFamilies(FamilyNode* node, ExpenseNode* expenses, int user_id) {
+// Helper function to compare the families of one subtree with a full recompute
+void verifyFamilyTotalsInNode(FamilyNode* node, ExpenseNode* root, int* mismatches) {
     if (!node) return;
-    
     for (int i = 0; i < node->num_keys; i++) {
-        Family* fam = node->families[i];
-        for (int j = 0; j < fam->member_count; j++) {
-            if (fam->members[j]->user_id == user_id) {
-                fam->total_monthly_expense = calculateTotalMonthlyExpense(expenses, fam);
-                break;
-            }
+        Family* family = node->families[i];
+        long long fresh = calculateTotalMonthlyExpense(root, family);
+        if (fresh != family->total_monthly_expense && ++*mismatches <= 5) {
+            printf("Family total mismatch: family %d: %.2f maintained vs %.2f recomputed\n",
+                   family->family_id, centsToUnits(family->total_monthly_expense), centsToUnits(fresh));
         }
     }
-    
-    // Recurse for non-leaf nodes
     if (!node->is_leaf) {
-        for (int i = 0; i <= node->num_keys; i++) {
-            TraverseAndUpdateFamilies(node->children[i], expenses, user_id);
-        }
+        for (int i = 0; i <= node->num_keys; i++) verifyFamilyTotalsInNode(node->children[i], root, mismatches);
     }
 }
 
+// Consistency check: recompute every family's expense total from the expense records and
+// compare it with the maintained one. Returns the number of mismatches
+int verifyFamilyExpenseTotals(FamilyTree* tree, ExpenseNode* root) {
+    int mismatches = 0;
+    if (tree) verifyFamilyTotalsInNode(tree->root, root, &mismatches);
+    return mismatches;
+}
+
 ExpenseNode *InsertExpense(ExpenseNode *node,Expense newExpense,int *pNewKey,ExpenseNode **pNewChild, int *pDuplicate)
 {
     if(node == NULL) return NULL;
 
-    //Check for dupliacte expense_id
-    if(SearchExpenseID(node,newExpense.expense_id))
-    {
-        *pDuplicate=1;
-        return NULL;
-    }
-
+    //Single descent: a duplicate expense_id is caught when the leaf is reached
     if(node->is_leaf)
     {
-        int pos=0;
-        while(pos < node->num_keys && node->expenses[pos].expense_id < newExpense.expense_id)
-        {
-            pos++;
-        }
+        ExpenseLeafNode *leaf = EXP_LEAF(node);
+        int pos = findPosition(node, newExpense.expense_id);
 
         //Check for dupliacte at the correct position
-        if(pos < node->num_keys && node->expenses[pos].expense_id < newExpense.expense_id)
+        if(pos < node->num_keys && leaf->keys[pos] == newExpense.expense_id)
         {
             *pDuplicate=1;
             return NULL;
         }
 
-        if(node->num_keys < MAX_KEYS)
+        if(node->num_keys < EXPENSE_LEAF_KEYS)
         {
-            for(int i = node->num_keys;i>pos;i--)
-            {
-                node->expenses[i] = node->expenses[i-1];
-                node->keys[i] = node->keys[i-1];
-            }
-            node->expenses[pos] = newExpense;
-            node->keys[pos] = newExpense.expense_id;
-            node->num_keys++;
+            insertIntoLeaf(leaf, newExpense);
             return NULL;
         }
 
-        else
-        {
-            ExpenseNode *splitNode = createLeafNode();
-            int mid= MAX_KEYS/2;
-            for(int i = mid,j=0; i < MAX_KEYS;i++,j++)
-            {
-                splitNode->expenses[j]=node->expenses[i];
-                splitNode->keys[j] = node->keys[i];
-            }
-
-            splitNode->num_keys = MAX_KEYS-mid;
-            node->num_keys= mid;
-
-            if(pos < mid)
-            {
-                for(int i = node->num_keys; i>pos;i--)
-                {
-                    node->expenses[i] = node->expenses[i-1];
-                    node->keys[i] = node->keys[i-1];
-                }
-
-                node->expenses[pos] = newExpense;
-                node->keys[pos] = newExpense.expense_id;
-                node->num_keys++;
-            }
-            else
-            {
-                int newpos=pos - mid;
-                for(int i = splitNode->num_keys;i>newpos;i--)
-                {
-                    splitNode->expenses[i] = splitNode->expenses[i-1];
-                    splitNode->keys[i] = splitNode->keys[i-1];
-                }
-                splitNode->expenses[newpos] = newExpense;
-                splitNode->keys[newpos] = newExpense.expense_id;
-                splitNode->num_keys++;
-            }
-
-            splitNode->next = node->next;
-            node->next = splitNode;
-            splitNode->prev=node;
-            if(splitNode->next) splitNode->next->prev = splitNode;
-
-            *pNewKey = splitNode->keys[0];
-            *pNewChild = splitNode;
-            return splitNode;
-        }
+        //Leaf is full: split it and hand the new right sibling to the parent
+        ExpenseLeafNode *splitNode = splitLeafNode(leaf, newExpense, pNewKey);
+        *pNewChild = &splitNode->header;
+        return *pNewChild;
     }
 
-    int pos = 0;
-    while(pos < node->num_keys && node->keys[pos] < newExpense.expense_id)
-    {
-        pos++;
-    }
+    ExpenseInnerNode *inner = EXP_INNER(node);
+    int pos = findChildIndex(node, newExpense.expense_id);
 
     int tempNewKey;
     ExpenseNode *tempNewChild = NULL;
-    ExpenseNode *splitNode = InsertExpense(node->children[pos],newExpense,&tempNewKey,&tempNewChild,pDuplicate);
+    ExpenseNode *splitNode = InsertExpense(inner->children[pos],newExpense,&tempNewKey,&tempNewChild,pDuplicate);
 
     if(*pDuplicate)
     {
         return NULL;
     }
-
-    if(splitNode)
+    if(!splitNode)
     {
-        if(node->num_keys < MAX_KEYS)
-        {
-            for(int i=node->num_keys; i>pos;i--)
-            {
-                node->keys[i]= node->keys[i-1];
-                node->children[i+1] = node->children[i];
-            }
-            node->keys[pos] = tempNewKey;
-            node->children[pos + 1] = tempNewChild;
-            node->num_keys++;
-            return NULL;
-        }
-        else
-        {
-            ExpenseNode *newNode =  createLeafNode();
-            newNode->is_leaf = 0; //This is an internal node
-            int mid = MAX_KEYS/2;
-
-            for(int i = mid+1,j=0;i<MAX_KEYS;i++,j++)
-            {
-                newNode->keys[j] = node->keys[i];
-                newNode->children[j] = node->children[i];
-            }
-
-            newNode->children[MAX_KEYS - mid -1] = node->children[MAX_KEYS];
-            newNode->num_keys = MAX_KEYS - mid - 1;
-            node->num_keys=mid;
-
-            if(pos <= mid)
-            {
-                for (int i = node->num_keys; i > pos; i--) {
-                    node->keys[i] = node->keys[i - 1];
-                    node->children[i + 1] = node->children[i];
-                }
-                node->keys[pos] = tempNewKey;
-                node->children[pos + 1] = tempNewChild;
-                node->num_keys++;
-            } 
-            else 
-            {
-                int newPos = pos - mid - 1;
-                for (int i = newNode->num_keys; i > newPos; i--) {
-                    newNode->keys[i] = newNode->keys[i - 1];
-                    newNode->children[i + 1] = newNode->children[i];
-                }
-                newNode->keys[newPos] = tempNewKey;
-                newNode->children[newPos + 1] = tempNewChild;
-                newNode->num_keys++;
-            }
+        //Child kept its shape: fold the new amount into its summary
+        addAmountToAggregate(&inner->aggs[pos], newExpense.amount);
+        return NULL;
+    }
 
-             *pNewKey = node->keys[mid];
-             *pNewChild = newNode;
-              return newNode;
-            }
-        }
+    //Child split: its summary now covers only the left half; the new sibling's is added on insert
+    refreshChildAggregate(inner, pos);
+    if(node->num_keys < EXPENSE_INNER_KEYS)
+    {
+        insertIntoInternal(inner, tempNewKey, tempNewChild, pos);
         return NULL;
+    }
+
+    //Internal node is full: split it and push the middle key up
+    ExpenseInnerNode *newNode = splitInternalNode(inner, tempNewKey, tempNewChild, pos, pNewKey);
+    *pNewChild = &newNode->header;
+    return *pNewChild;
 }
 
 // Modified Update_delete_expense function
@@ -2573,160 +5997,426 @@ ExpenseNode *InsertExpense(ExpenseNode *node,Expense newExpense,int *pNewKey,Exp
 void PrintExpenseTree(ExpenseNode *node, int level) {
     if (node == NULL) return;
     
+    int *keys = expenseNodeKeys(node);
     printf("Level %d: ", level);
     if (node->is_leaf) {
         printf("Leaf [");
         for (int i = 0; i < node->num_keys; i++) {
-            printf("%d", node->keys[i]);
+            printf("%d", keys[i]);
             if (i < node->num_keys-1) printf(", ");
         }
         printf("]\n");
     } else {
         printf("Internal [");
         for (int i = 0; i < node->num_keys; i++) {
-            printf("%d", node->keys[i]);
+            printf("%d", keys[i]);
             if (i < node->num_keys-1) printf(", ");
         }
         printf("]\n");
         for (int i = 0; i <= node->num_keys; i++) {
-            PrintExpenseTree(node->children[i], level+1);
+            PrintExpenseTree(EXP_INNER(node)->children[i], level+1);
         }
     }
 }
 
 // Helper function to create a new expense node (either leaf or internal)
 ExpenseNode *createExpenseNode(int isLeaf) {
-    ExpenseNode *newNode = (ExpenseNode *)malloc(sizeof(ExpenseNode));
-    if (newNode == NULL) {
-        printf("Memory allocation failed\n");
-        exit(1);
+    ExpenseNode *newNode;
+    if (isLeaf) {
+        ExpenseLeafNode *leaf = (ExpenseLeafNode *)poolAlloc(&expenseLeafPool);
+        if (leaf == NULL) {
+            printf("Memory allocation failed\n");
+            exit(1);
+        }
+        // Initialize expense columns and linked list pointers
+        for (int i = 0; i < EXPENSE_LEAF_KEYS; i++) {
+            leaf->keys[i] = 0;
+        }
+        leaf->prev = NULL;
+        leaf->next = NULL;
+        newNode = &leaf->header;
+    } else {
+        ExpenseInnerNode *inner = (ExpenseInnerNode *)poolAlloc(&expenseInnerPool);
+        if (inner == NULL) {
+            printf("Memory allocation failed\n");
+            exit(1);
+        }
+        // Initialize all keys and children pointers
+        for (int i = 0; i < EXPENSE_INNER_KEYS; i++) {
+            inner->keys[i] = 0;
+        }
+        for (int i = 0; i < EXPENSE_INNER_CHILDREN; i++) {
+            inner->children[i] = NULL;
+        }
+        newNode = &inner->header;
     }
     
     // Initialize node properties
     newNode->num_keys = 0;
     newNode->is_leaf = isLeaf;
     
-    // Initialize all keys and data
-    for (int i = 0; i < MAX_KEYS; i++) {
-        newNode->keys[i] = 0;
-        if (isLeaf) {
-            // Initialize expense fields for leaf nodes
-            newNode->expenses[i].expense_id = 0;
-            // Initialize other expense fields as needed
-        }
+    return newNode;
+}
+
+// Helper function to get the key array of either node type
+int *expenseNodeKeys(ExpenseNode *node) {
+    return node->is_leaf ? EXP_LEAF(node)->keys : EXP_INNER(node)->keys;
+}
+
+// Helper function to gather one leaf row back into an Expense record
+Expense getLeafExpense(ExpenseLeafNode *leaf, int i) {
+    Expense expense;
+    expense.expense_id = leaf->keys[i];
+    expense.user_id = leaf->user_ids[i];
+    expense.category = leaf->categories[i];
+    expense.amount = leaf->amounts[i];
+    strcpy(expense.date, leaf->dates[i]);
+    expense.date_key = leaf->date_keys[i];
+    return expense;
+}
+
+// Helper function to scatter an Expense record into one leaf row
+void setLeafExpense(ExpenseLeafNode *leaf, int i, Expense expense) {
+    leaf->keys[i] = expense.expense_id;
+    leaf->user_ids[i] = expense.user_id;
+    leaf->categories[i] = expense.category;
+    leaf->amounts[i] = expense.amount;
+    strcpy(leaf->dates[i], expense.date);
+    leaf->date_keys[i] = expense.date_key;
+}
+
+// Helper function to copy row src of one leaf into row dst of another (or the same) leaf
+void copyLeafRow(ExpenseLeafNode *to, int dst, ExpenseLeafNode *from, int src) {
+    to->keys[dst] = from->keys[src];
+    to->user_ids[dst] = from->user_ids[src];
+    to->categories[dst] = from->categories[src];
+    to->amounts[dst] = from->amounts[src];
+    memcpy(to->dates[dst], from->dates[src], DATE_LENGTH);
+    to->date_keys[dst] = from->date_keys[src];
+}
+
+// Helper function to fold one aggregate into another
+void combineExpenseAggregate(ExpenseAggregate *into, const ExpenseAggregate *from) {
+    if (from->count == 0) return;
+    if (into->count == 0) {
+        *into = *from;
+        return;
     }
-    
-    // Initialize all children pointers
-    for (int i = 0; i <= MAX_KEYS; i++) {
-        newNode->children[i] = NULL;
+    into->count += from->count;
+    into->sum += from->sum;
+    if (from->min < into->min) into->min = from->min;
+    if (from->max > into->max) into->max = from->max;
+}
+
+// Helper function to account for one more record in an aggregate
+void addAmountToAggregate(ExpenseAggregate *into, long long amount) {
+    if (into->count == 0 || amount < into->min) into->min = amount;
+    if (into->count == 0 || amount > into->max) into->max = amount;
+    into->count++;
+    into->sum += amount;
+}
+
+// Helper function to summarise rows [from, to) of a leaf from its amount column; whole cents
+// add up exactly in any order, so the loop has no branches and the compiler can vectorize it
+ExpenseAggregate leafRowsAggregate(const ExpenseLeafNode *leaf, int from, int to) {
+    ExpenseAggregate agg = {0, 0, 0, 0};
+    if (from >= to) return agg;
+    const long long *amounts = leaf->amounts;
+    long long sum = 0, min = amounts[from], max = amounts[from];
+    for (int i = from; i < to; i++) {
+        long long amount = amounts[i];
+        sum += amount;
+        min = amount < min ? amount : min;
+        max = amount > max ? amount : max;
+    }
+    agg.count = to - from;
+    agg.sum = sum;
+    agg.min = min;
+    agg.max = max;
+    return agg;
+}
+
+// Helper function to summarise a whole subtree; inner nodes combine their per-child aggregates
+ExpenseAggregate expenseNodeAggregate(ExpenseNode *node) {
+    if (node->is_leaf) return leafRowsAggregate(EXP_LEAF(node), 0, node->num_keys);
+    ExpenseAggregate agg = {0, 0, 0, 0};
+    for (int i = 0; i <= node->num_keys; i++) {
+        combineExpenseAggregate(&agg, &EXP_INNER(node)->aggs[i]);
+    }
+    return agg;
+}
+
+// Helper function to recompute a parent's summary of one child after the child changed
+void refreshChildAggregate(ExpenseInnerNode *parent, int index) {
+    parent->aggs[index] = expenseNodeAggregate(parent->children[index]);
+}
+
+// Function to recompute the aggregates on the path to an expense whose amount was edited in place
+void refreshExpenseAggregatesOnPath(ExpenseNode *node, int expense_id) {
+    if (!node || node->is_leaf) return;
+    int pos = findChildIndex(node, expense_id);
+    refreshExpenseAggregatesOnPath(EXP_INNER(node)->children[pos], expense_id);
+    refreshChildAggregate(EXP_INNER(node), pos);
+}
+
+// Helper function to find the leftmost leaf, where the leaf chain starts
+ExpenseLeafNode *leftmostExpenseLeaf(ExpenseNode *root) {
+    ExpenseNode *node = root;
+    while (node && !node->is_leaf) {
+        node = EXP_INNER(node)->children[0];
+    }
+    return EXP_LEAF(node);
+}
+
+// Helper function to descend to the leaf that holds (or would hold) an expense ID
+ExpenseLeafNode *findExpenseLeaf(ExpenseNode *root, int expense_id) {
+    ExpenseNode *node = root;
+    while (node && !node->is_leaf) {
+        node = EXP_INNER(node)->children[findChildIndex(node, expense_id)];
+    }
+    return EXP_LEAF(node);
+}
+
+// Helper function to find the rightmost leaf, where the leaf chain ends
+ExpenseLeafNode *rightmostExpenseLeaf(ExpenseNode *root) {
+    ExpenseNode *node = root;
+    while (node && !node->is_leaf) {
+        node = EXP_INNER(node)->children[node->num_keys];
+    }
+    return EXP_LEAF(node);
+}
+
+// Start loading a leaf into cache: its header and the first line of every column
+void prefetchExpenseLeaf(const ExpenseLeafNode *leaf) {
+    if (!leaf) return;
+    PREFETCH(leaf);
+    PREFETCH(leaf->user_ids);
+    PREFETCH(leaf->categories);
+    PREFETCH(leaf->amounts);
+    PREFETCH(leaf->dates);
+}
+
+// Cursor on the smallest expense ID
+ExpenseCursor expenseCursorFirst(ExpenseNode *root) {
+    ExpenseCursor cursor = { leftmostExpenseLeaf(root), 0 };
+    while (cursor.leaf && cursor.leaf->header.num_keys == 0) {
+        cursor.leaf = cursor.leaf->next;
+    }
+    if (cursor.leaf) prefetchExpenseLeaf(cursor.leaf->next);
+    return cursor;
+}
+
+// Cursor on the largest expense ID
+ExpenseCursor expenseCursorLast(ExpenseNode *root) {
+    ExpenseCursor cursor = { rightmostExpenseLeaf(root), 0 };
+    while (cursor.leaf && cursor.leaf->header.num_keys == 0) {
+        cursor.leaf = cursor.leaf->prev;
+    }
+    if (cursor.leaf) {
+        cursor.index = cursor.leaf->header.num_keys - 1;
+        prefetchExpenseLeaf(cursor.leaf->prev);
+    }
+    return cursor;
+}
+
+// Cursor on the first expense ID >= expense_id
+ExpenseCursor expenseCursorSeek(ExpenseNode *root, int expense_id) {
+    ExpenseCursor cursor = { findExpenseLeaf(root, expense_id), 0 };
+    if (!cursor.leaf) return cursor;
+    cursor.index = keyLowerBound(cursor.leaf->keys, cursor.leaf->header.num_keys, expense_id);
+    if (cursor.index == cursor.leaf->header.num_keys) {
+        // Every key in this leaf is smaller; the answer starts the next leaf
+        cursor.index--;
+        expenseCursorNext(&cursor);
+    } else {
+        prefetchExpenseLeaf(cursor.leaf->next);
+    }
+    return cursor;
+}
+
+int expenseCursorValid(const ExpenseCursor *cursor) {
+    return cursor->leaf != NULL;
+}
+
+// Step to the next record, prefetching the leaf after the one being entered
+void expenseCursorNext(ExpenseCursor *cursor) {
+    if (++cursor->index < cursor->leaf->header.num_keys) return;
+    do {
+        cursor->leaf = cursor->leaf->next;
+    } while (cursor->leaf && cursor->leaf->header.num_keys == 0);
+    cursor->index = 0;
+    if (cursor->leaf) prefetchExpenseLeaf(cursor->leaf->next);
+}
+
+// Step to the previous record, prefetching the leaf before the one being entered
+void expenseCursorPrev(ExpenseCursor *cursor) {
+    if (--cursor->index >= 0) return;
+    do {
+        cursor->leaf = cursor->leaf->prev;
+    } while (cursor->leaf && cursor->leaf->header.num_keys == 0);
+    if (cursor->leaf) {
+        cursor->index = cursor->leaf->header.num_keys - 1;
+        prefetchExpenseLeaf(cursor->leaf->prev);
+    }
+}
+
+int expenseCursorKey(const ExpenseCursor *cursor) {
+    return cursor->leaf->keys[cursor->index];
+}
+
+Expense expenseCursorGet(const ExpenseCursor *cursor) {
+    return getLeafExpense(cursor->leaf, cursor->index);
+}
+
+// Function to aggregate the records of a subtree whose IDs fall in [start_id, end_id].
+// check_start / check_end say whether that bound can cut into this subtree; children
+// that lie wholly inside the range are read from the parent's aggregates, not visited.
+void aggregateExpenseSubtree(ExpenseNode *node, int start_id, int end_id, int check_start, int check_end, ExpenseAggregate *out) {
+    if (node->is_leaf) {
+        ExpenseLeafNode *leaf = EXP_LEAF(node);
+        int from = check_start ? keyLowerBound(leaf->keys, node->num_keys, start_id) : 0;
+        int to = check_end ? keyUpperBound(leaf->keys, node->num_keys, end_id) : node->num_keys;
+        ExpenseAggregate rows = leafRowsAggregate(leaf, from, to);
+        combineExpenseAggregate(out, &rows);
+        return;
     }
     
-    // Initialize linked list pointers for leaf nodes
-    newNode->prev = NULL;
-    newNode->next = NULL;
-    
-    return newNode;
+    ExpenseInnerNode *inner = EXP_INNER(node);
+    int first = check_start ? findChildIndex(node, start_id) : 0;
+    int last = check_end ? findChildIndex(node, end_id) : node->num_keys;
+    if (first == last) {
+        aggregateExpenseSubtree(inner->children[first], start_id, end_id, check_start, check_end, out);
+        return;
+    }
+    if (check_start) {
+        aggregateExpenseSubtree(inner->children[first], start_id, end_id, 1, 0, out);
+    } else {
+        combineExpenseAggregate(out, &inner->aggs[first]);
+    }
+    for (int i = first + 1; i < last; i++) {
+        combineExpenseAggregate(out, &inner->aggs[i]);
+    }
+    if (check_end) {
+        aggregateExpenseSubtree(inner->children[last], start_id, end_id, 0, 1, out);
+    } else {
+        combineExpenseAggregate(out, &inner->aggs[last]);
+    }
+}
+
+// Function to get the count, total, smallest and largest amount of the expenses with
+// IDs in [start_id, end_id] in O(log n), without collecting the records
+ExpenseAggregate aggregateExpenseRange(ExpenseNode *root, int start_id, int end_id) {
+    ExpenseAggregate agg = {0, 0, 0, 0};
+    if (root && start_id <= end_id) {
+        aggregateExpenseSubtree(root, start_id, end_id, 1, 1, &agg);
+    }
+    return agg;
+}
+
+// Copy up to max records in ascending ID order and advance past them; returns the number copied
+int expenseCursorNextBatch(ExpenseCursor *cursor, Expense *out, int max) {
+    int n = 0;
+    while (n < max && cursor->leaf) {
+        int take = cursor->leaf->header.num_keys - cursor->index;
+        if (take > max - n) take = max - n;
+        for (int i = 0; i < take; i++) {
+            out[n++] = getLeafExpense(cursor->leaf, cursor->index + i);
+        }
+        cursor->index += take - 1;
+        expenseCursorNext(cursor);
+    }
+    return n;
+}
+
+// Copy up to max records in descending ID order and step back past them; returns the number copied
+int expenseCursorPrevBatch(ExpenseCursor *cursor, Expense *out, int max) {
+    int n = 0;
+    while (n < max && cursor->leaf) {
+        int take = cursor->index + 1;
+        if (take > max - n) take = max - n;
+        for (int i = 0; i < take; i++) {
+            out[n++] = getLeafExpense(cursor->leaf, cursor->index - i);
+        }
+        cursor->index -= take - 1;
+        expenseCursorPrev(cursor);
+    }
+    return n;
 }
 
 // Helper function to find the position of a key in a node
+// (index of the first key >= key, i.e. the slot it occupies or would occupy in a leaf)
 int findPosition(ExpenseNode *node, int key) {
-    int pos = 0;
-    while (pos < node->num_keys && key > node->keys[pos]) {
-        pos++;
-    }
-    return pos;
+    return keyLowerBound(expenseNodeKeys(node), node->num_keys, key);
+}
+
+// Helper function to pick the child to descend into from an internal node.
+// A separator is the smallest key of its right subtree, so equal keys go right.
+int findChildIndex(ExpenseNode *node, int key) {
+    return keyUpperBound(expenseNodeKeys(node), node->num_keys, key);
 }
 
 // Helper function to search for an expense ID in a B+ tree
 int SearchExpenseID(ExpenseNode *root, int expense_id) {
     if (!root) return 0;
     
-    ExpenseNode *node = root;
-    while (!node->is_leaf) {
-        int pos = 0;
-        // Corrected comparison for B+ tree traversal
-        while (pos < node->num_keys && expense_id >= node->keys[pos]) pos++;
-        node = node->children[pos];
-    }
-    
-    ExpenseNode *current = root;
-    
     // Traverse to the appropriate leaf node
-    while (!current->is_leaf) {
-        int pos = findPosition(current, expense_id);
-        current = current->children[pos];
-    }
+    ExpenseLeafNode *current = findExpenseLeaf(root, expense_id);
     
     // Search in the leaf node
-    for (int i = 0; i < current->num_keys; i++) {
-        if (current->keys[i] == expense_id) {
-            return 1; // Found
-        }
+    int pos = keyLowerBound(current->keys, current->header.num_keys, expense_id);
+    if (pos < current->header.num_keys && current->keys[pos] == expense_id) {
+        return 1; // Found
     }
     
     return 0; // Not found
 }
 
 // Function to insert a new expense into a leaf node that has space
-void insertIntoLeaf(ExpenseNode *leaf, Expense newExpense) {
-    int pos = findPosition(leaf, newExpense.expense_id);
+void insertIntoLeaf(ExpenseLeafNode *leaf, Expense newExpense) {
+    int pos = findPosition(&leaf->header, newExpense.expense_id);
     
-    // Shift keys and expenses to make room
-    for (int i = leaf->num_keys; i > pos; i--) {
-        leaf->keys[i] = leaf->keys[i-1];
-        leaf->expenses[i] = leaf->expenses[i-1];
+    // Shift every column to make room
+    for (int i = leaf->header.num_keys; i > pos; i--) {
+        copyLeafRow(leaf, i, leaf, i-1);
     }
     
-    // Insert the new key and expense
-    leaf->keys[pos] = newExpense.expense_id;
-    leaf->expenses[pos] = newExpense;
-    leaf->num_keys++;
+    // Insert the new expense
+    setLeafExpense(leaf, pos, newExpense);
+    leaf->header.num_keys++;
 }
 
 // Function to split a leaf node and insert the new key
-ExpenseNode *splitLeafNode(ExpenseNode *leaf, Expense newExpense, int *pNewKey) {
+ExpenseLeafNode *splitLeafNode(ExpenseLeafNode *leaf, Expense newExpense, int *pNewKey) {
+    // Calculate split point - middle for even distribution
+    return splitLeafNodeAt(leaf, newExpense, (EXPENSE_LEAF_KEYS + 1) / 2, pNewKey);
+}
+
+// Function to split a leaf node at a chosen point and insert the new key
+ExpenseLeafNode *splitLeafNodeAt(ExpenseLeafNode *leaf, Expense newExpense, int splitPoint, int *pNewKey) {
     // Create a new leaf node
-    ExpenseNode *newLeaf = createExpenseNode(1);
+    ExpenseLeafNode *newLeaf = EXP_LEAF(createExpenseNode(1));
+    expenseTreeVersion++;
     
-    // Create temporary arrays to hold all keys and expenses including the new one
-    int tempKeys[MAX_KEYS + 1];
-    Expense tempExpenses[MAX_KEYS + 1];
+    // splitPoint of the EXPENSE_LEAF_KEYS + 1 records stay in the left leaf
+    int pos = findPosition(&leaf->header, newExpense.expense_id);
+    int i, j;
     
-    // Copy existing keys and expenses
-    int i, j, pos;
-    for (i = 0, pos = 0; i < leaf->num_keys; i++) {
-        if (pos == 0 && newExpense.expense_id < leaf->keys[i]) {
-            tempKeys[pos] = newExpense.expense_id;
-            tempExpenses[pos] = newExpense;
-            pos++;
+    if (pos < splitPoint) {
+        // New expense lands in the left half: move one extra row to the right
+        for (i = splitPoint - 1, j = 0; i < leaf->header.num_keys; i++, j++) {
+            copyLeafRow(newLeaf, j, leaf, i);
         }
-        tempKeys[pos] = leaf->keys[i];
-        tempExpenses[pos] = leaf->expenses[i];
-        pos++;
-    }
-    
-    // If new expense is the largest, add it at the end
-    if (pos == leaf->num_keys) {
-        tempKeys[pos] = newExpense.expense_id;
-        tempExpenses[pos] = newExpense;
-    }
-    
-    // Calculate split point - middle for even distribution
-    int splitPoint = (MAX_KEYS + 1) / 2;
-    
-    // Reset leaf node and copy first half
-    leaf->num_keys = 0;
-    for (i = 0; i < splitPoint; i++) {
-        leaf->keys[i] = tempKeys[i];
-        leaf->expenses[i] = tempExpenses[i];
-        leaf->num_keys++;
-    }
-    
-    // Copy second half to new leaf
-    for (i = splitPoint, j = 0; i <= MAX_KEYS; i++, j++) {
-        newLeaf->keys[j] = tempKeys[i];
-        newLeaf->expenses[j] = tempExpenses[i];
-        newLeaf->num_keys++;
+        newLeaf->header.num_keys = j;
+        leaf->header.num_keys = splitPoint - 1;
+        insertIntoLeaf(leaf, newExpense);
+    } else {
+        // New expense lands in the right half
+        for (i = splitPoint, j = 0; i < leaf->header.num_keys; i++, j++) {
+            copyLeafRow(newLeaf, j, leaf, i);
+        }
+        newLeaf->header.num_keys = j;
+        leaf->header.num_keys = splitPoint;
+        insertIntoLeaf(newLeaf, newExpense);
     }
     
     // Update the leaf node linked list
@@ -2744,24 +6434,33 @@ ExpenseNode *splitLeafNode(ExpenseNode *leaf, Expense newExpense, int *pNewKey)
 }
 
 // Function to insert into an internal node that has space
-void insertIntoInternal(ExpenseNode *node, int key, ExpenseNode *rightChild, int pos) {
+void insertIntoInternal(ExpenseInnerNode *node, int key, ExpenseNode *rightChild, int pos) {
     // Shift keys and children pointers to make room
-    for (int i = node->num_keys; i > pos; i--) {
+    for (int i = node->header.num_keys; i > pos; i--) {
         node->keys[i] = node->keys[i-1];
         node->children[i+1] = node->children[i];
+        node->aggs[i+1] = node->aggs[i];
     }
     
     // Insert the new key and child pointer
     node->keys[pos] = key;
     node->children[pos+1] = rightChild;
-    node->num_keys++;
+    node->aggs[pos+1] = expenseNodeAggregate(rightChild);
+    node->header.num_keys++;
 }
 
 // Function to split an internal node
-ExpenseNode *splitInternalNode(ExpenseNode *node, int key, ExpenseNode *rightChild, int pos, int *pNewKey) {
+ExpenseInnerNode *splitInternalNode(ExpenseInnerNode *node, int key, ExpenseNode *rightChild, int pos, int *pNewKey) {
+    // Find middle key for B+ tree internal node
+    return splitInternalNodeAt(node, key, rightChild, pos, EXPENSE_INNER_KEYS / 2, pNewKey);
+}
+
+// Function to split an internal node around key index mid, which moves up to the parent
+ExpenseInnerNode *splitInternalNodeAt(ExpenseInnerNode *node, int key, ExpenseNode *rightChild, int pos, int mid, int *pNewKey) {
     // Temporary arrays for keys and children
-    int tempKeys[MAX_KEYS + 1];
-    ExpenseNode *tempChildren[MAX_KEYS + 2];
+    int tempKeys[EXPENSE_INNER_KEYS + 1];
+    ExpenseNode *tempChildren[EXPENSE_INNER_KEYS + 2];
+    ExpenseAggregate tempAggs[EXPENSE_INNER_KEYS + 2];
     
     // Copy existing keys and children, and insert the new ones
     int i, j;
@@ -2770,47 +6469,52 @@ ExpenseNode *splitInternalNode(ExpenseNode *node, int key, ExpenseNode *rightChi
     for (i = 0; i < pos; i++) {
         tempKeys[i] = node->keys[i];
         tempChildren[i] = node->children[i];
+        tempAggs[i] = node->aggs[i];
     }
     
     // Insert the new key and child
     tempKeys[pos] = key;
     tempChildren[pos] = node->children[pos];
+    tempAggs[pos] = node->aggs[pos];
     tempChildren[pos+1] = rightChild;
+    tempAggs[pos+1] = expenseNodeAggregate(rightChild);
     
     // Copy keys after insertion position
-    for (i = pos, j = pos+1; i < node->num_keys; i++, j++) {
+    for (i = pos, j = pos+1; i < node->header.num_keys; i++, j++) {
         tempKeys[j] = node->keys[i];
         tempChildren[j+1] = node->children[i+1];
+        tempAggs[j+1] = node->aggs[i+1];
     }
     
     // Create a new internal node
-    ExpenseNode *newNode = createExpenseNode(0);
-    
-    // Find middle key for B+ tree internal node
-    int mid = MAX_KEYS / 2;
+    ExpenseInnerNode *newNode = EXP_INNER(createExpenseNode(0));
+    expenseTreeVersion++;
     
-    // Key to be moved up (but also stays in the right node for B+ tree)
+    // Key to be moved up to the parent (internal separators are not kept in either half)
     *pNewKey = tempKeys[mid];
     
-    // Reset current node and copy first half (excluding the middle key for B+ trees)
-    node->num_keys = 0;
+    // Reset current node and copy first half (excluding the middle key)
+    node->header.num_keys = 0;
     for (i = 0; i < mid; i++) {
         node->keys[i] = tempKeys[i];
         node->children[i] = tempChildren[i];
-        node->num_keys++;
+        node->aggs[i] = tempAggs[i];
+        node->header.num_keys++;
     }
     node->children[mid] = tempChildren[mid];
+    node->aggs[mid] = tempAggs[mid];
+    for (i = mid + 1; i < EXPENSE_INNER_CHILDREN; i++) {
+        node->children[i] = NULL;
+    }
     
-    // Copy second half to new node (including a copy of the middle key for B+ trees)
-    for (i = mid, j = 0; i <= MAX_KEYS; i++, j++) {
-        if (i == mid) {
-            // Skip the middle key in the new node for non-leaf nodes
-            newNode->children[j] = tempChildren[i+1];
-            continue;
-        }
+    // Copy second half to new node
+    newNode->children[0] = tempChildren[mid+1];
+    newNode->aggs[0] = tempAggs[mid+1];
+    for (i = mid + 1, j = 0; i <= EXPENSE_INNER_KEYS; i++, j++) {
         newNode->keys[j] = tempKeys[i];
         newNode->children[j+1] = tempChildren[i+1];
-        newNode->num_keys++;
+        newNode->aggs[j+1] = tempAggs[i+1];
+        newNode->header.num_keys++;
     }
     
     return newNode;
@@ -2819,18 +6523,125 @@ ExpenseNode *splitInternalNode(ExpenseNode *node, int key, ExpenseNode *rightChi
 // Main recursive insertion function
 
 
+// Function to rebuild the cached rightmost path after the tree changed shape
+void refreshExpenseTailHint(ExpenseNode *root) {
+    ExpenseTailHint *hint = &expenseTailHint;
+    hint->root = NULL;
+    hint->height = 0;
+    for (ExpenseNode *node = root; node; node = node->is_leaf ? NULL : EXP_INNER(node)->children[node->num_keys]) {
+        if (hint->height == EXPENSE_MAX_HEIGHT) return; // Too deep to cache, leave the hint unset
+        hint->spine[hint->height++] = node;
+    }
+    hint->root = root;
+    hint->version = expenseTreeVersion;
+}
+
+// Function to append an expense whose ID is above every key in the tree.
+// A full tail leaf splits 90/10, so the left sibling stays nearly full for
+// increasing IDs, and splits travel up the cached spine without a descent.
+ExpenseNode *appendExpenseToTail(ExpenseNode *root, Expense newExpense) {
+    ExpenseTailHint *hint = &expenseTailHint;
+    ExpenseLeafNode *tail = EXP_LEAF(hint->spine[hint->height - 1]);
+    
+    if (tail->header.num_keys < EXPENSE_LEAF_KEYS) {
+        setLeafExpense(tail, tail->header.num_keys, newExpense);
+        tail->header.num_keys++;
+        for (int level = 0; level < hint->height - 1; level++) {
+            ExpenseInnerNode *parent = EXP_INNER(hint->spine[level]);
+            addAmountToAggregate(&parent->aggs[parent->header.num_keys], newExpense.amount);
+        }
+        return root;
+    }
+    
+    int leafSplit = EXPENSE_LEAF_KEYS * 9 / 10;
+    if (leafSplit < (EXPENSE_LEAF_KEYS + 1) / 2) leafSplit = (EXPENSE_LEAF_KEYS + 1) / 2;
+    int innerSplit = EXPENSE_INNER_KEYS * 9 / 10;
+    if (innerSplit > EXPENSE_INNER_KEYS - 1) innerSplit = EXPENSE_INNER_KEYS - 1;
+    if (innerSplit < EXPENSE_INNER_KEYS / 2) innerSplit = EXPENSE_INNER_KEYS / 2;
+    
+    int newKey;
+    ExpenseNode *newChild = &splitLeafNodeAt(tail, newExpense, leafSplit, &newKey)->header;
+    hint->spine[hint->height - 1] = newChild;
+    
+    // Hand the new rightmost child to each parent on the spine until one has room
+    for (int level = hint->height - 2; level >= 0 && newChild; level--) {
+        ExpenseInnerNode *parent = EXP_INNER(hint->spine[level]);
+        int pos = parent->header.num_keys;
+        refreshChildAggregate(parent, pos); // The child that split kept only its left part
+        if (pos < EXPENSE_INNER_KEYS) {
+            insertIntoInternal(parent, newKey, newChild, pos);
+            newChild = NULL;
+            // Ancestors above kept their shape and only gained the new record
+            for (int above = level - 1; above >= 0; above--) {
+                ExpenseInnerNode *ancestor = EXP_INNER(hint->spine[above]);
+                addAmountToAggregate(&ancestor->aggs[ancestor->header.num_keys], newExpense.amount);
+            }
+        } else {
+            newChild = &splitInternalNodeAt(parent, newKey, newChild, pos, innerSplit, &newKey)->header;
+            hint->spine[level] = newChild;
+        }
+    }
+    
+    // The root itself split: grow the tree by one level
+    if (newChild) {
+        ExpenseInnerNode *newRoot = EXP_INNER(createExpenseNode(0));
+        newRoot->keys[0] = newKey;
+        newRoot->children[0] = root;
+        newRoot->children[1] = newChild;
+        newRoot->header.num_keys = 1;
+        refreshChildAggregate(newRoot, 0);
+        refreshChildAggregate(newRoot, 1);
+        root = &newRoot->header;
+        if (hint->height == EXPENSE_MAX_HEIGHT) {
+            hint->root = NULL;
+            return root;
+        }
+        for (int i = hint->height; i > 0; i--) {
+            hint->spine[i] = hint->spine[i - 1];
+        }
+        hint->spine[0] = root;
+        hint->height++;
+    }
+    
+    hint->root = root;
+    hint->version = expenseTreeVersion;
+    return root;
+}
+
 // Public interface for insertion
 ExpenseNode *InsertExpenseRoot(ExpenseNode *root, Expense newExpense, int *pDuplicate) {
+    root = insertExpenseIntoTree(root, newExpense, pDuplicate);
+    if (!*pDuplicate) {
+        indexExpenseInserted(&newExpense);
+    }
+    return root;
+}
+
+// Insert into any expense tree (the main one or a month partition) without touching the indexes
+ExpenseNode *insertExpenseIntoTree(ExpenseNode *root, Expense newExpense, int *pDuplicate) {
+    *pDuplicate = 0;
+    
     // Handle empty tree case
     if (root == NULL) {
-        *pDuplicate = 0;
         root = createExpenseNode(1);  // Create a leaf node
-        root->keys[0] = newExpense.expense_id;
-        root->expenses[0] = newExpense;
-        root->num_keys = 1;
+        expenseTreeVersion++;
+        insertIntoLeaf(EXP_LEAF(root), newExpense);
         return root;
     }
     
+    // Fast path: an ID above the current maximum goes straight to the tail leaf
+    if (expenseAppendFastPath) {
+        ExpenseTailHint *hint = &expenseTailHint;
+        if (hint->root != root || hint->version != expenseTreeVersion) {
+            refreshExpenseTailHint(root);
+        }
+        ExpenseLeafNode *tail = hint->root ? EXP_LEAF(hint->spine[hint->height - 1]) : NULL;
+        if (tail && tail->header.num_keys > 0 &&
+            newExpense.expense_id > tail->keys[tail->header.num_keys - 1]) {
+            return appendExpenseToTail(root, newExpense);
+        }
+    }
+    
     int newKey;
     ExpenseNode *newChild = NULL;
     
@@ -2844,77 +6655,95 @@ ExpenseNode *InsertExpenseRoot(ExpenseNode *root, Expense newExpense, int *pDupl
     
     // If the root was split, create a new root
     if (result != NULL) {
-        ExpenseNode *newRoot = createExpenseNode(0);  // Internal node
+        ExpenseInnerNode *newRoot = EXP_INNER(createExpenseNode(0));  // Internal node
         newRoot->keys[0] = newKey;
         newRoot->children[0] = root;
         newRoot->children[1] = newChild;
-        newRoot->num_keys = 1;
-        return newRoot;
-    }
-    
-    // No root split occurred
-    return root;
-}
-
-ExpenseNode *createLeafNode() 
-{
-    ExpenseNode *newNode = (ExpenseNode *)malloc(sizeof(ExpenseNode));
-    if (!newNode) return NULL;
-    
-    newNode->num_keys = 0;
-    newNode->is_leaf = 1;
-    newNode->next = newNode->prev = NULL;
-    
-    // Initialize all keys and children
-    for (int i = 0; i < MAX_KEYS; i++) {
-        newNode->keys[i] = 0;
-        newNode->children[i] = NULL;
+        newRoot->header.num_keys = 1;
+        refreshChildAggregate(newRoot, 0);
+        refreshChildAggregate(newRoot, 1);
+        return &newRoot->header;
     }
-    newNode->children[MAX_KEYS] = NULL;
     
-    return newNode;
+    // No root split occurred
+    return root;
+}
+
+ExpenseNode *createLeafNode() 
+{
+    return createExpenseNode(1);
 }
 int ValidateExpenseTree(ExpenseNode *node, int is_root, int *min_key, int *max_key) {
     if (!node) return 1;
     
+    // Check the node does not overflow its fanout
+    int capacity = node->is_leaf ? EXPENSE_LEAF_KEYS : EXPENSE_INNER_KEYS;
+    if (node->num_keys > capacity || (!is_root && node->num_keys == 0)) {
+        printf("Node size violation: num_keys=%d, capacity=%d\n", node->num_keys, capacity);
+        return 0;
+    }
+    
     // Check key order in this node
+    int *keys = expenseNodeKeys(node);
     for (int i = 1; i < node->num_keys; i++) {
-        if (node->keys[i] <= node->keys[i-1]) {
+        if (keys[i] <= keys[i-1]) {
             printf("Key order violation: keys[%d]=%d <= keys[%d]=%d\n", 
-                  i, node->keys[i], i-1, node->keys[i-1]);
+                  i, keys[i], i-1, keys[i-1]);
             return 0;
         }
     }
     
     if (node->is_leaf) {
-        *min_key = node->keys[0];
-        *max_key = node->keys[node->num_keys-1];
+        if (node->num_keys > 0) {
+            *min_key = keys[0];
+            *max_key = keys[node->num_keys-1];
+        }
         return 1;
     }
     
-    // Validate children
+    // Validate children: separator keys[i-1] is the smallest key of children[i]
     int child_min, child_max;
     for (int i = 0; i <= node->num_keys; i++) {
-        if (!ValidateExpenseTree(node->children[i], 0, &child_min, &child_max))
+        if (!ValidateExpenseTree(EXP_INNER(node)->children[i], 0, &child_min, &child_max))
+            return 0;
+        
+        // The stored summary of each child must match what the child holds
+        ExpenseAggregate stored = EXP_INNER(node)->aggs[i];
+        ExpenseAggregate actual = expenseNodeAggregate(EXP_INNER(node)->children[i]);
+        if (stored.count != actual.count || stored.sum != actual.sum ||
+            (actual.count > 0 && (stored.min != actual.min || stored.max != actual.max))) {
+            printf("Aggregate violation under key %d: count %d vs %d, sum %.2f vs %.2f\n",
+                  i > 0 ? keys[i-1] : keys[0], stored.count, actual.count, centsToUnits(stored.sum), centsToUnits(actual.sum));
             return 0;
+        }
             
-        if (i > 0 && child_min <= node->keys[i-1]) {
+        if (i > 0 && child_min < keys[i-1]) {
             printf("Left child max violation: child_min=%d, parent_key=%d\n",
-                  child_min, node->keys[i-1]);
+                  child_min, keys[i-1]);
             return 0;
         }
-        if (i < node->num_keys && child_max > node->keys[i]) {
+        if (i < node->num_keys && child_max >= keys[i]) {
             printf("Right child min violation: child_max=%d, parent_key=%d\n",
-                  child_max, node->keys[i]);
+                  child_max, keys[i]);
             return 0;
         }
+        if (i == 0) *min_key = child_min;
+        if (i == node->num_keys) *max_key = child_max;
     }
     
-    *min_key = node->children[0]->keys[0];
-    *max_key = node->children[node->num_keys]->keys[node->children[node->num_keys]->num_keys-1];
     return 1;
 }
 
+// Function to get the number of levels in the expense B+ tree
+int ExpenseTreeHeight(ExpenseNode *root) {
+    int height = 0;
+    while (root) {
+        height++;
+        root = root->is_leaf ? NULL : EXP_INNER(root)->children[0];
+    }
+    return height;
+}
+
 
 
 void Update_delete_expense(ExpenseNode** expenseRoot, FamilyTree* familyTree, UserNode* userRoot, 
@@ -2926,23 +6755,23 @@ void Update_delete_expense(ExpenseNode** expenseRoot, FamilyTree* familyTree, Us
 
     // Search for the expense in the B+ tree
     printf("Searching for expense ID: %d\n", expense_id);
-    Expense* foundExpense = FindExpenseByID(*expenseRoot, expense_id);
+    Expense found;
+    Expense* foundExpense = &found;
 
-    if (!foundExpense) 
+    if (!FindExpenseByID(*expenseRoot, expense_id, foundExpense)) 
     {
         printf("Error: Expense ID %d not found.\n", expense_id);
         return;
     }
 
     // Store original values for later comparison
-    int original_user_id = foundExpense->user_id;
     Expense originalExpense = *foundExpense;  // Make a copy
 
     printf("Found Expense:\n");
     printf("ID: %d, User ID: %d, Category: %s, Amount: %.2f, Date: %s\n", 
     foundExpense->expense_id, foundExpense->user_id, 
     getCategoryName(foundExpense->category), 
-    foundExpense->amount, foundExpense->date);
+    centsToUnits(foundExpense->amount), foundExpense->date);
 
     printf("1. Update Expense\n2. Delete Expense\nChoice: ");
     int choice;
@@ -2951,14 +6780,14 @@ void Update_delete_expense(ExpenseNode** expenseRoot, FamilyTree* familyTree, Us
     if (choice == 1) 
     {
         // Update logic
-        printf("Current Amount: %.2f\n", foundExpense->amount);
+        printf("Current Amount: %.2f\n", centsToUnits(foundExpense->amount));
         printf("Enter New Amount (-1 to keep current): ");
-        float new_amount;
-        scanf("%f", &new_amount);
+        double new_amount;
+        scanf("%lf", &new_amount);
 
         if (new_amount != -1) 
         {
-            foundExpense->amount = new_amount;  // Update the amount
+            foundExpense->amount = unitsToCents(new_amount);  // Update the amount
             printf("Amount updated successfully.\n");
         }
 
@@ -2979,9 +6808,13 @@ void Update_delete_expense(ExpenseNode** expenseRoot, FamilyTree* familyTree, Us
         if (strcmp(new_date, "0") != 0) 
         {
             strcpy(foundExpense->date, new_date);
+            foundExpense->date_key = packDate(new_date);
             printf("Date updated successfully.\n");
         }
 
+        // Store the edited record back into its leaf
+        UpdateExpenseRecord(*expenseRoot, *foundExpense);
+
         // Write all expenses back to the file to reflect the changes
         writeExpensesToFile(*expenseRoot, expensesFile);
         printf("Expense updated in memory and file.\n");
@@ -3002,82 +6835,88 @@ void Update_delete_expense(ExpenseNode** expenseRoot, FamilyTree* familyTree, Us
         return;
     }
 
-    // Update family expenses for the user associated with this expense
-    UpdateFamilyExpenses(familyTree, *expenseRoot, original_user_id);
-
-    // Save updated family information
+    // The expense hooks already moved the family totals; save updated family information
     saveFamiliesToFile(familyTree, familiesFile, "temp.txt");
 
     printf("Operation completed successfully!\n");
 }
 
-Expense* FindExpenseByID(ExpenseNode* root, int expense_id) 
+int FindExpenseByID(ExpenseNode* root, int expense_id, Expense* out) 
 {
     if (root == NULL) {
-        return NULL;
+        return 0;
     }
     
     ExpenseNode* current = root;
     
     // Traverse down to the leaf level
     while (!current->is_leaf) {
+        ExpenseInnerNode* inner = EXP_INNER(current);
         int i = 0;
         
         // Debug output
         printf("Level %d (Internal): Keys [", current->num_keys);
         for (int j = 0; j < current->num_keys; j++) {
-            printf("%d", current->keys[j]);
+            printf("%d", inner->keys[j]);
             if (j < current->num_keys - 1) printf(", ");
         }
         printf("]\n");
         
         // Find the appropriate child to traverse
-        while (i < current->num_keys && expense_id > current->keys[i]) {
-            i++;
-        }
+        i = findChildIndex(current, expense_id);
         
         printf("Taking child %d\n", i);
-        current = current->children[i];
+        current = inner->children[i];
     }
     
+    ExpenseLeafNode* leaf = EXP_LEAF(current);
+    
     // At leaf level, search for the expense
-    printf("Level %d (Leaf): Keys [", current->num_keys);
-    for (int j = 0; j < current->num_keys; j++) {
-        printf("%d", current->keys[j]);
-        if (j < current->num_keys - 1) printf(", ");
+    printf("Level %d (Leaf): Keys [", leaf->header.num_keys);
+    for (int j = 0; j < leaf->header.num_keys; j++) {
+        printf("%d", leaf->keys[j]);
+        if (j < leaf->header.num_keys - 1) printf(", ");
     }
     printf("]\n");
     
-    // Linear search in the leaf node
-    for (int i = 0; i < current->num_keys; i++) {
-        printf("Checking position %d: %d\n", i, current->keys[i]);
-        if (current->keys[i] == expense_id) {
+    // Search in the leaf node
+    int i = keyLowerBound(leaf->keys, leaf->header.num_keys, expense_id);
+    if (i < leaf->header.num_keys) {
+        printf("Checking position %d: %d\n", i, leaf->keys[i]);
+        if (leaf->keys[i] == expense_id) {
             printf("Found expense ID %d at position %d\n", expense_id, i);
-            return &(current->expenses[i]);
-        }
-    }
-    
-    // If the expense is not found in this leaf, check if there are more leaves
-    while (current->next != NULL) {
-        current = current->next;
-        printf("Checking next leaf node: Keys [");
-        for (int j = 0; j < current->num_keys; j++) {
-            printf("%d", current->keys[j]);
-            if (j < current->num_keys - 1) printf(", ");
-        }
-        printf("]\n");
-        
-        for (int i = 0; i < current->num_keys; i++) {
-            printf("Checking position %d: %d\n", i, current->keys[i]);
-            if (current->keys[i] == expense_id) {
-                printf("Found expense ID %d at position %d in next leaf\n", expense_id, i);
-                return &(current->expenses[i]);
-            }
+            *out = getLeafExpense(leaf, i);
+            return 1;
         }
     }
     
     printf("Expense ID %d not found in any leaf node\n", expense_id);
-    return NULL;
+    return 0;
+}
+
+// Function to write an edited expense back into its leaf (the expense_id itself cannot change)
+int UpdateExpenseRecord(ExpenseNode* root, Expense updated)
+{
+    Expense previous;
+    if (!storeExpenseInTree(root, updated, &previous)) return 0;
+    indexExpenseUpdated(&previous, &updated);
+    return 1;
+}
+
+// Overwrite a record in any expense tree without touching the indexes, handing back the old one
+int storeExpenseInTree(ExpenseNode* root, Expense updated, Expense* previous)
+{
+    if (root == NULL) return 0;
+    
+    ExpenseLeafNode* leaf = findExpenseLeaf(root, updated.expense_id);
+    int pos = findPosition(&leaf->header, updated.expense_id);
+    if (pos >= leaf->header.num_keys || leaf->keys[pos] != updated.expense_id) {
+        return 0;
+    }
+    if (previous) *previous = getLeafExpense(leaf, pos);
+    setLeafExpense(leaf, pos, updated);
+    refreshExpenseAggregatesOnPath(root, updated.expense_id);
+    return 1;
 }
 
 void saveFamiliesToFile(FamilyTree* tree, const char* filename, const char* tempFilename) {
@@ -3107,36 +6946,40 @@ UserNode* deleteUserNode(UserNode* root, int user_id)
     } else if (user_id > root->user_id) {
         root->right = deleteUserNode(root->right, user_id);
     } else {
-        UserNode* temp = NULL;
-
-        // Node with one child or no child
-        if (!root->left || !root->right) {
-            temp = root->left ? root->left : root->right;
-
-            if (!temp) { // No child
-                temp = root;
-                root = NULL;
-            } else { // One child: copy data, not struct
-                root->user_id = temp->user_id;
-                strcpy(root->user_name, temp->user_name);
-                root->income = temp->income;
-                root->left = temp->left;
-                root->right = temp->right;
-            }
-            free(temp);
-        } else { // Two children
-            UserNode* successor = root->right;
-            while (successor->left) successor = successor->left;
-            
-            // Copy data without struct assignment
-            root->user_id = successor->user_id;
-            strcpy(root->user_name, successor->user_name);
-            root->income = successor->income;
-            
-            root->right = deleteUserNode(root->right, successor->user_id);
+        // Nodes are relinked rather than having their data copied, so the
+        // UserNode pointers families hold for other users stay valid
+        UserNode* temp = root;
+
+        if (!root->left || !root->right) { // Node with one child or no child
+            root = root->left ? root->left : root->right;
+        } else { // Two children: the in-order successor takes this node's place
+            UserNode* successor = NULL;
+            UserNode* right = detachMinUser(root->right, &successor);
+            successor->left = root->left;
+            successor->right = right;
+            root = successor;
         }
+        releaseUserSlot(temp->slot);
+        poolFree(&userNodePool, temp);
+    }
+
+    return rebalanceUserNode(root);
+}
+
+// Helper function to unlink the smallest user of a subtree; returns the rebalanced subtree
+UserNode* detachMinUser(UserNode* root, UserNode** minOut)
+{
+    if (!root->left) {
+        *minOut = root;
+        return root->right;
     }
+    root->left = detachMinUser(root->left, minOut);
+    return rebalanceUserNode(root);
+}
 
+// Helper function to restore the AVL balance of a node after a removal below it
+UserNode* rebalanceUserNode(UserNode* root)
+{
     if (!root) return root;
 
     // Update height and balance factor
@@ -3186,68 +7029,57 @@ int userExistsInFile(const char* filename, int user_id) {
 
 
 
-void removeUserFromFamilies(FamilyTree* tree, int user_id) {
-    if (!tree || !tree->root) return;
-
-    FamilyNode* node = tree->root;
-    int familiesToDelete[MAX_FAMILIES] = {0};
-    int deleteCount = 0;
+void removeUserFromFamilies(FamilyTree* tree, ExpenseNode* expenseRoot, int user_id) {
+    removeUsersFromFamilies(tree, expenseRoot, &user_id, 1);
+}
 
-    // Use proper B-tree traversal (this is simplified)
-    // In a real implementation, you'd need to traverse the entire tree
-    traverseAndUpdateFamilies(tree->root, user_id, familiesToDelete, &deleteCount);
+// Function to take a batch of users out of their families, then delete the families
+// that were left empty in one batch
+void removeUsersFromFamilies(FamilyTree* tree, ExpenseNode* expenseRoot, const int* user_ids, int count) {
+    if (!tree || !tree->root) return;
 
-    // Delete empty families
-    for (int i = 0; i < deleteCount; i++) {
-        deleteFamilyFromTree(tree, familiesToDelete[i]);
+    int capacity = 64, emptied = 0;
+    int* familiesToDelete = (int*)malloc(capacity * sizeof(int));
+    if (!familiesToDelete) {
+        printf("Memory allocation failed\n");
+        return;
     }
-}
 
-// New helper function for proper tree traversal
-void traverseAndUpdateFamilies(FamilyNode* node, int user_id, int* familiesToDelete, int* deleteCount) {
-    if (!node) return;
-    
-    // Process current node
-    for (int i = 0; i < node->num_keys; i++) {
-        Family* family = node->families[i];
-        float incomeReduction = 0.0;
-        int memberRemoved = 0;
-        
-        for (int j = 0; j < family->member_count; j++) {
-            if (family->members[j] && family->members[j]->user_id == user_id) {
-                // Store income before removing
-                incomeReduction = family->members[j]->income;
-                
-                // Shift members left
-                for (int k = j; k < family->member_count-1; k++) {
-                    family->members[k] = family->members[k+1];
+    for (int i = 0; i < count; i++) {
+        int user_id = user_ids[i];
+        Family* family = familyOfUser(user_id);
+        if (!family) continue;
+        int j = findMemberIndex(family, user_id);
+        if (j < 0) continue;
+
+        // Adjust income before removing
+        family->total_income -= familyMember(family, j)->income;
+        if (family->total_income < 0) family->total_income = 0;
+
+        // The user's expenses stay behind, so take them out of the family total
+        familyMemberLeaving(family, expenseRoot, user_id);
+
+        // Shift members left and reduce count
+        removeFamilyMemberAt(family, j);
+        clearFamilyOfUser(user_id, family);
+
+        // Mark the family for deletion once it is empty
+        if (family->member_count == 0) {
+            if (emptied == capacity) {
+                capacity *= 2;
+                int* grown = (int*)realloc(familiesToDelete, capacity * sizeof(int));
+                if (!grown) {
+                    printf("Memory allocation failed\n");
+                    break;
                 }
-                
-                // Set last member to NULL and reduce count
-                family->members[family->member_count-1] = NULL;
-                family->member_count--;
-                
-                // Adjust income
-                family->total_income -= incomeReduction;
-                if (family->total_income < 0) family->total_income = 0;
-                
-                memberRemoved = 1;
-                break;  // Each user should appear only once in a family
+                familiesToDelete = grown;
             }
-        }
-        
-        // Mark empty families for deletion
-        if (memberRemoved && family->member_count == 0) {
-            familiesToDelete[(*deleteCount)++] = family->family_id;
-        }
-    }
-    
-    // If not leaf, traverse children
-    if (!node->is_leaf) {
-        for (int i = 0; i <= node->num_keys; i++) {
-            traverseAndUpdateFamilies(node->children[i], user_id, familiesToDelete, deleteCount);
+            familiesToDelete[emptied++] = family->family_id;
         }
     }
+
+    deleteFamiliesFromTree(tree, familiesToDelete, emptied);
+    free(familiesToDelete);
 }
 
 void writeFamiliesRecursiveToFile(FamilyNode* node, FILE* file) {
@@ -3272,13 +7104,14 @@ void writeFamiliesRecursiveToFile(FamilyNode* node, FILE* file) {
               family->family_id, 
               family->family_name,
               family->member_count,
-              family->total_income,
-              family->total_monthly_expense);
+              centsToUnits(family->total_income),
+              centsToUnits(family->total_monthly_expense));
         
         // Write member IDs (only for valid members)
         for (int j = 0; j < family->member_count; j++) {
-            if (family->members[j] != NULL) {
-                fprintf(file, "%d", family->members[j]->user_id);
+            UserNode* member = familyMember(family, j);
+            if (member != NULL) {
+                fprintf(file, "%d", member->user_id);
             } else {
                 fprintf(file, "0");  // Backup for any NULL pointers
             }
@@ -3297,6 +7130,886 @@ void writeFamiliesRecursiveToFile(FamilyNode* node, FILE* file) {
 }
 
 
+#ifdef EXPENSE_BENCHMARK
+// Benchmark driver, built instead of the interactive menu with -DEXPENSE_BENCHMARK.
+// Rebuild with different -DEXPENSE_LEAF_KEYS / -DEXPENSE_INNER_KEYS to compare fanouts.
+#define BENCH_EXPENSES 1000000
+#define BENCH_LOOKUPS 1000000
+#define BENCH_USERS 1000
+#define BENCH_FAMILY_MEMBERS 4
+
+// Function to get elapsed seconds since a clock() reading
+double benchElapsed(clock_t start) {
+    return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+// Function to fill a shuffled array of expense IDs 1..count
+int* benchShuffledIDs(int count, unsigned int seed) {
+    int* ids = (int*)malloc(count * sizeof(int));
+    if (!ids) {
+        printf("Memory allocation failed\n");
+        exit(1);
+    }
+    for (int i = 0; i < count; i++) ids[i] = i + 1;
+    srand(seed);
+    for (int i = count - 1; i > 0; i--) {
+        int j = (int)(((unsigned long)rand() * RAND_MAX + rand()) % (unsigned long)(i + 1));
+        int temp = ids[i];
+        ids[i] = ids[j];
+        ids[j] = temp;
+    }
+    return ids;
+}
+
+// Function to make synthetic expense records for a list of IDs
+Expense* benchMakeExpenses(const int* ids, int count) {
+    Expense* expenses = (Expense*)malloc(count * sizeof(Expense));
+    if (!expenses) {
+        printf("Memory allocation failed\n");
+        exit(1);
+    }
+    for (int i = 0; i < count; i++) {
+        expenses[i].expense_id = ids[i];
+        expenses[i].user_id = ids[i] % BENCH_USERS + 1;
+        // Not tied to user_id, so every user has expenses in every category
+        expenses[i].category = (ExpenseCategory)(ids[i] / BENCH_USERS % MAX_CATEGORY + 1);
+        expenses[i].amount = ids[i] % 100000;
+        sprintf(expenses[i].date, "2025-%02d-%02d", ids[i] % 12 + 1, ids[i] % 28 + 1);
+        expenses[i].date_key = packDate(expenses[i].date);
+    }
+    return expenses;
+}
+
+// Function to build a synthetic expense tree from a list of IDs, one insert at a time
+ExpenseNode* benchBuildTree(const int* ids, int count) {
+    Expense* expenses = benchMakeExpenses(ids, count);
+    ExpenseNode* root = NULL;
+    for (int i = 0; i < count; i++) {
+        int duplicate = 0;
+        root = InsertExpenseRoot(root, expenses[i], &duplicate);
+    }
+    free(expenses);
+    return root;
+}
+
+// Function to get the average leaf occupancy of a tree, in percent
+double benchLeafFill(ExpenseNode* root) {
+    long records = 0, leaves = 0;
+    for (ExpenseLeafNode* leaf = leftmostExpenseLeaf(root); leaf; leaf = leaf->next) {
+        records += leaf->header.num_keys;
+        leaves++;
+    }
+    return leaves ? 100.0 * records / ((double)leaves * EXPENSE_LEAF_KEYS) : 0.0;
+}
+
+// Compare one-at-a-time inserts with the bottom-up bulk loader
+void benchBulkLoad(void) {
+    int* ids = benchShuffledIDs(BENCH_EXPENSES, 42);
+    Expense* expenses = benchMakeExpenses(ids, BENCH_EXPENSES);
+
+    clock_t start = clock();
+    ExpenseNode* incremental = benchBuildTree(ids, BENCH_EXPENSES);
+    double insertTime = benchElapsed(start);
+
+    ExpenseNode* bulk = NULL;
+    start = clock();
+    bulkInsert(&bulk, expenses, BENCH_EXPENSES);
+    double bulkTime = benchElapsed(start);
+
+    int min_key, max_key;
+    printf("\n=== Bulk Load (fill %d%%) ===\n", EXPENSE_BULK_FILL_PERCENT);
+    printf("%-14s %-10s %-8s %-10s %-6s\n", "Method", "Time (s)", "Depth", "Leaf fill", "Valid");
+    printf("%-14s %-10.3f %-8d %5.1f%%     %-6s\n", "InsertExpense", insertTime, ExpenseTreeHeight(incremental),
+           benchLeafFill(incremental), ValidateExpenseTree(incremental, 1, &min_key, &max_key) ? "yes" : "NO");
+    printf("%-14s %-10.3f %-8d %5.1f%%     %-6s\n", "bulkInsert", bulkTime, ExpenseTreeHeight(bulk),
+           benchLeafFill(bulk), ValidateExpenseTree(bulk, 1, &min_key, &max_key) ? "yes" : "NO");
+
+    freeExpenseTree(incremental);
+    freeExpenseTree(bulk);
+    free(expenses);
+    free(ids);
+}
+
+// Ingest increasing IDs with and without the tail append fast path, and shuffled IDs for reference
+void benchAppendIngest(void) {
+    int* sequential = (int*)malloc(BENCH_EXPENSES * sizeof(int));
+    if (!sequential) {
+        printf("Memory allocation failed\n");
+        exit(1);
+    }
+    for (int i = 0; i < BENCH_EXPENSES; i++) sequential[i] = i + 1;
+    int* shuffled = benchShuffledIDs(BENCH_EXPENSES, 42);
+
+    // Start from empty pools so the first run shows how many slabs a full ingest needs
+    poolReleaseAll(&expenseLeafPool);
+    poolReleaseAll(&expenseInnerPool);
+
+    printf("\n=== Ingest ===\n");
+    printf("%-26s %-10s %-12s %-10s %-12s\n", "Workload", "Time (s)", "ns/insert", "Leaf fill", "Slab mallocs");
+    const char* names[] = {"increasing, fast path", "increasing, descent only", "shuffled"};
+    for (int run = 0; run < 3; run++) {
+        expenseAppendFastPath = (run != 1);
+        long slabs = expenseLeafPool.slab_count + expenseInnerPool.slab_count;
+        clock_t start = clock();
+        ExpenseNode* root = benchBuildTree(run == 2 ? shuffled : sequential, BENCH_EXPENSES);
+        double elapsed = benchElapsed(start);
+        printf("%-26s %-10.3f %-12.0f %5.1f%%     %-12ld\n", names[run], elapsed,
+               elapsed * 1e9 / BENCH_EXPENSES, benchLeafFill(root),
+               expenseLeafPool.slab_count + expenseInnerPool.slab_count - slabs);
+        if (run == 2) printNodePoolStats();
+        freeExpenseTree(root);
+    }
+    expenseAppendFastPath = 1;
+
+    free(sequential);
+    free(shuffled);
+}
+
+// Report tree depth and point lookup latency for the compiled fanout
+void benchExpenseFanout(void) {
+    int* ids = benchShuffledIDs(BENCH_EXPENSES, 42);
+
+    clock_t start = clock();
+    ExpenseNode* root = benchBuildTree(ids, BENCH_EXPENSES);
+    double buildTime = benchElapsed(start);
+
+    int min_key, max_key;
+    int valid = ValidateExpenseTree(root, 1, &min_key, &max_key);
+
+    int* probes = benchShuffledIDs(BENCH_EXPENSES, 7);
+    int found = 0;
+    start = clock();
+    for (int i = 0; i < BENCH_LOOKUPS; i++) {
+        found += SearchExpenseID(root, probes[i % BENCH_EXPENSES]);
+    }
+    double lookupTime = benchElapsed(start);
+
+    printf("\n=== Expense B+ Tree Fanout ===\n");
+    printf("Leaf keys: %d, Inner keys: %d, Leaf size: %zu bytes, Inner size: %zu bytes\n",
+           EXPENSE_LEAF_KEYS, EXPENSE_INNER_KEYS, sizeof(ExpenseLeafNode), sizeof(ExpenseInnerNode));
+    printf("Expenses: %d, Depth: %d, Valid: %s\n",
+           CountExpenses(root), ExpenseTreeHeight(root), valid ? "yes" : "NO");
+    printf("Build: %.3f s (%.0f ns/insert)\n", buildTime, buildTime * 1e9 / BENCH_EXPENSES);
+    printf("Lookup: %.0f ns/lookup (%d/%d found)\n",
+           lookupTime * 1e9 / BENCH_LOOKUPS, found, BENCH_LOOKUPS);
+
+    free(ids);
+    free(probes);
+}
+
+// Compare the scalar key loop with the dispatched node search kernel
+void benchNodeSearch(void) {
+    int sizes[] = {4, 16, 64, 256};
+    int searches = 4000000;
+    int* keys = (int*)malloc(256 * sizeof(int));
+    int* probes = (int*)malloc(searches * sizeof(int));
+    if (!keys || !probes) {
+        printf("Memory allocation failed\n");
+        exit(1);
+    }
+
+    printf("\n=== Node Search Kernel (%s) ===\n", keySearchKernelName());
+    printf("%-6s %-14s %-14s\n", "Keys", "Scalar ns", "Kernel ns");
+    for (int s = 0; s < 4; s++) {
+        int n = sizes[s];
+        for (int i = 0; i < n; i++) keys[i] = i * 2 + 1;
+        srand(11);
+        for (int i = 0; i < searches; i++) probes[i] = rand() % (n * 2 + 2);
+
+        long checksum = 0;
+        clock_t start = clock();
+        for (int i = 0; i < searches; i++) checksum += keyLowerBoundScalar(keys, n, probes[i]);
+        double scalarTime = benchElapsed(start);
+
+        start = clock();
+        for (int i = 0; i < searches; i++) checksum -= keyLowerBound(keys, n, probes[i]);
+        double kernelTime = benchElapsed(start);
+
+        printf("%-6d %-14.2f %-14.2f%s\n", n, scalarTime * 1e9 / searches, kernelTime * 1e9 / searches,
+               checksum == 0 ? "" : "  (MISMATCH)");
+    }
+
+    free(keys);
+    free(probes);
+}
+
+// Compare the scalar leaf scan with the dispatched kernel on family totals over every leaf:
+// all time, one month, and one category (no index or bitmap to skip ahead with). The tree is
+// bulk built, so the leaves sit in memory in chain order and the scan is not waiting on misses
+void benchLeafScan(void) {
+    int* ids = (int*)malloc(BENCH_EXPENSES * sizeof(int));
+    if (!ids) {
+        printf("Memory allocation failed\n");
+        exit(1);
+    }
+    for (int i = 0; i < BENCH_EXPENSES; i++) ids[i] = i + 1;
+    Expense* expenses = benchMakeExpenses(ids, BENCH_EXPENSES);
+    ExpenseNode* root = buildExpenseTree(expenses, BENCH_EXPENSES);
+    free(expenses);
+    int queries = 50;
+    const char* names[] = { "All time", "Month", "Category" };
+
+    printf("\n=== Leaf Scan Kernel (%s) ===\n", leafScanKernelName());
+    printf("%-10s %-16s %-16s %-8s\n", "Filter", "Scalar Mrows/s", "Kernel Mrows/s", "Match");
+    for (int f = 0; f < 3; f++) {
+        long long totals[2] = {0, 0};
+        double times[2];
+        for (int k = 0; k < 2; k++) {
+            if (k == 0) leafScanImpl = scanLeafRowsScalar;
+            else selectLeafScanKernel();
+            srand(5);
+            clock_t start = clock();
+            for (int q = 0; q < queries; q++) {
+                int members[SCAN_MEMBERS];
+                for (int j = 0; j < SCAN_MEMBERS; j++) members[j] = rand() % BENCH_USERS + 1;
+                ExpenseScanFilter filter;
+                initScanFilter(&filter, members, SCAN_MEMBERS);
+                if (f == 1) scanFilterMonth(&filter, 2025, rand() % 12 + 1);
+                if (f == 2) filter.category_mask = 1u << (rand() % MAX_CATEGORY + 1);
+                ExpenseScanTotals scanned;
+                scanExpenseTotals(root, &filter, 0, &scanned);
+                totals[k] += scanned.sum;
+            }
+            times[k] = benchElapsed(start);
+        }
+        double rows = (double)BENCH_EXPENSES * queries;
+        printf("%-10s %-16.0f %-16.0f %-8s\n", names[f], rows / times[0] / 1e6, rows / times[1] / 1e6,
+               totals[0] == totals[1] ? "yes" : "no");
+    }
+
+    freeExpenseTree(root);
+    free(ids);
+}
+
+// Compare range totals from the inner-node aggregates against summing the records with a cursor
+void benchRangeAggregate(void) {
+    int* ids = benchShuffledIDs(BENCH_EXPENSES, 42);
+    ExpenseNode* root = benchBuildTree(ids, BENCH_EXPENSES);
+    int queries = 10000;
+    int widths[] = {100, 10000, BENCH_EXPENSES / 2};
+
+    printf("\n=== ID Range Totals ===\n");
+    printf("%-10s %-16s %-16s %-8s\n", "Width", "Aggregate (ns)", "Scan (ns)", "Match");
+    for (int w = 0; w < 3; w++) {
+        srand(11);
+        long long aggTotal = 0, scanTotal = 0;
+        clock_t start = clock();
+        for (int q = 0; q < queries; q++) {
+            int lo = rand() % BENCH_EXPENSES + 1;
+            aggTotal += aggregateExpenseRange(root, lo, lo + widths[w] - 1).sum;
+        }
+        double aggTime = benchElapsed(start);
+
+        srand(11);
+        int scanQueries = w == 2 ? queries / 100 : queries;
+        start = clock();
+        for (int q = 0; q < scanQueries; q++) {
+            int lo = rand() % BENCH_EXPENSES + 1;
+            int hi = lo + widths[w] - 1;
+            for (ExpenseCursor c = expenseCursorSeek(root, lo); expenseCursorValid(&c) && expenseCursorKey(&c) <= hi; expenseCursorNext(&c)) {
+                scanTotal += c.leaf->amounts[c.index];
+            }
+        }
+        double scanTime = benchElapsed(start);
+
+        // The scan runs fewer queries on the widest range, so compare against the same prefix
+        srand(11);
+        long long expected = 0;
+        for (int q = 0; q < scanQueries; q++) {
+            int lo = rand() % BENCH_EXPENSES + 1;
+            expected += aggregateExpenseRange(root, lo, lo + widths[w] - 1).sum;
+        }
+        printf("%-10d %-16.0f %-16.0f %-8s\n", widths[w], aggTime * 1e9 / queries,
+               scanTime * 1e9 / scanQueries, expected == scanTotal ? "yes" : "no");
+    }
+
+    freeExpenseTree(root);
+    free(ids);
+}
+
+// Compare period queries through the date index against scanning the date column
+void benchPeriodQuery(void) {
+    int* ids = benchShuffledIDs(BENCH_EXPENSES, 42);
+    ExpenseNode* root = benchBuildTree(ids, BENCH_EXPENSES);
+    int queries = 200;
+    int spans[] = {1, 7, 28};
+
+    printf("\n=== Period Queries ===\n");
+    printf("%-10s %-12s %-16s %-16s %-8s\n", "Days", "Rows", "Index (us)", "Scan (us)", "Match");
+    for (int s = 0; s < 3; s++) {
+        long indexRows = 0, scanRows = 0;
+        ExpenseList found;
+        initExpenseList(&found);
+
+        attachExpenseIndexes(root);
+        clock_t start = clock();
+        for (int q = 0; q < queries; q++) {
+            int from = 20250000 + (q % 12 + 1) * 100 + 1;
+            found.count = 0;
+            collectExpensesInDateRange(root, from, from + spans[s] - 1, 0, &found);
+            indexRows += found.count;
+        }
+        double indexTime = benchElapsed(start);
+
+        detachExpenseIndexes();
+        start = clock();
+        for (int q = 0; q < queries; q++) {
+            int from = 20250000 + (q % 12 + 1) * 100 + 1;
+            found.count = 0;
+            collectExpensesInDateRange(root, from, from + spans[s] - 1, 0, &found);
+            scanRows += found.count;
+        }
+        double scanTime = benchElapsed(start);
+
+        printf("%-10d %-12ld %-16.1f %-16.1f %-8s\n", spans[s], indexRows / queries,
+               indexTime * 1e6 / queries, scanTime * 1e6 / queries, indexRows == scanRows ? "yes" : "no");
+        freeExpenseList(&found);
+    }
+
+    freeExpenseTree(root);
+    free(ids);
+}
+
+// Compare a family's month total read from its month partition against the user index and a full scan
+void benchMonthReport(void) {
+    int* ids = benchShuffledIDs(BENCH_EXPENSES, 42);
+    ExpenseNode* root = benchBuildTree(ids, BENCH_EXPENSES);
+    int queries = 2000;
+    const char* names[] = { "Partition", "User index", "Scan" };
+
+    printf("\n=== Family Month Totals ===\n");
+    printf("%-12s %-16s %-12s\n", "Path", "Query (us)", "Total");
+    for (int path = 0; path < 3; path++) {
+        if (path == 0) attachExpensePartitions(root);
+        if (path == 1) attachExpenseIndexes(root);
+        srand(5);
+        long long total = 0;
+        clock_t start = clock();
+        for (int q = 0; q < queries; q++) {
+            int members[SCAN_MEMBERS];
+            for (int j = 0; j < SCAN_MEMBERS; j++) members[j] = rand() % BENCH_USERS + 1;
+            int month = rand() % 12 + 1;
+            for (MemberExpenseCursor c = monthMemberCursorStart(root, members, SCAN_MEMBERS, 2025, month); memberCursorValid(&c); memberCursorNext(&c)) {
+                if (c.rec.leaf->date_keys[c.rec.index] / 100 == 202500 + month) total += c.rec.leaf->amounts[c.rec.index];
+            }
+        }
+        printf("%-12s %-16.1f %-12.0f\n", names[path], benchElapsed(start) * 1e6 / queries, centsToUnits(total));
+        if (path == 0) detachExpensePartitions();
+        if (path == 1) detachExpenseIndexes();
+    }
+
+    // Unload a third of the months and freeze another third, then check every month's
+    // partition still totals what a scan of the main tree finds; the unloaded months are
+    // rebuilt through the date index on first use
+    long long scanned[13] = {0};
+    for (ExpenseLeafNode* leaf = leftmostExpenseLeaf(root); leaf; leaf = leaf->next) {
+        for (int i = 0; i < leaf->header.num_keys; i++) {
+            int month_key = expenseMonthKey(leaf->date_keys[i]);
+            if (month_key / 100 == 2025) scanned[month_key % 100] += leaf->amounts[i];
+        }
+    }
+    attachExpensePartitions(root);
+    attachExpenseIndexes(root);
+    int failed = 0;
+    clock_t start = clock();
+    for (int month = 1; month <= 12; month++) {
+        if (month % 3 == 1) failed += !unloadExpensePartition(202500 + month);
+        if (month % 3 == 2) failed += !freezeExpensePartition(root, 202500 + month);
+    }
+    double changeTime = benchElapsed(start);
+    int mismatches = 0;
+    start = clock();
+    for (int month = 1; month <= 12; month++) {
+        long long total = 0;
+        for (ExpenseLeafNode* leaf = leftmostExpenseLeaf(expensePartitionRoot(root, 2025, month)); leaf; leaf = leaf->next) {
+            for (int i = 0; i < leaf->header.num_keys; i++) total += leaf->amounts[i];
+        }
+        mismatches += total != scanned[month];
+    }
+    printf("Unload/freeze: %.1f ms, reload and total: %.1f ms, failed: %d, months off the scan: %d\n",
+           changeTime * 1e3, benchElapsed(start) * 1e3, failed, mismatches);
+    detachExpenseIndexes();
+    detachExpensePartitions();
+
+    freeExpenseTree(root);
+    free(ids);
+}
+
+// Compare report totals read from the rollup against summing the records, then check that
+// the rollup still matches a rescan after a burst of updates and deletes
+void benchRollupReports(void) {
+    int* ids = benchShuffledIDs(BENCH_EXPENSES, 42);
+    ExpenseNode* root = benchBuildTree(ids, BENCH_EXPENSES);
+    int queries = 2000;
+    const char* names[] = { "Rollup", "User index", "Scan" };
+
+    printf("\n=== Rollup Reports ===\n");
+    clock_t start = clock();
+    attachExpenseRollup(root);
+    printf("Rollup build: %.1f ms, %d cells\n", benchElapsed(start) * 1e3, expenseRollup.used);
+    detachExpenseRollup();
+
+    printf("%-12s %-16s %-12s\n", "Path", "Query (us)", "Total");
+    for (int path = 0; path < 3; path++) {
+        if (path == 0) attachExpenseRollup(root);
+        if (path == 1) attachExpenseIndexes(root);
+        srand(5);
+        long long total = 0;
+        start = clock();
+        for (int q = 0; q < queries; q++) {
+            int members[SCAN_MEMBERS];
+            for (int j = 0; j < SCAN_MEMBERS; j++) members[j] = rand() % BENCH_USERS + 1;
+            int month_key = 202500 + rand() % 12 + 1;
+            if (path == 0) {
+                // A member drawn twice counts once, as it does for the cursor
+                for (int j = 0; j < SCAN_MEMBERS; j++) {
+                    int repeated = 0;
+                    for (int k = 0; k < j; k++) repeated |= members[k] == members[j];
+                    if (!repeated) total += rollupTotal(members[j], month_key, 0);
+                }
+                continue;
+            }
+            for (MemberExpenseCursor c = memberCursorStart(root, members, SCAN_MEMBERS, INT_MIN); memberCursorValid(&c); memberCursorNext(&c)) {
+                if (c.rec.leaf->date_keys[c.rec.index] / 100 == month_key) total += c.rec.leaf->amounts[c.rec.index];
+            }
+        }
+        printf("%-12s %-16.1f %-12.0f\n", names[path], benchElapsed(start) * 1e6 / queries, centsToUnits(total));
+        if (path == 1) detachExpenseIndexes();
+    }
+
+    // Maintenance: every update and delete below goes through the rollup hooks
+    int updates = 100000;
+    Expense* changes = benchMakeExpenses(ids, updates);
+    srand(9);
+    for (int i = 0; i < updates; i++) {
+        changes[i].user_id = rand() % BENCH_USERS + 1;
+        changes[i].category = (ExpenseCategory)(rand() % MAX_CATEGORY + 1);
+        changes[i].amount = rand() % 100000;
+    }
+    start = clock();
+    for (int i = 0; i < updates; i++) {
+        if (i % 2) DeleteExpense(&root, changes[i].expense_id);
+        else UpdateExpenseRecord(root, changes[i]);
+    }
+    free(changes);
+    printf("Maintained %d updates/deletes in %.1f ms; rescan mismatches: %d\n",
+           updates, benchElapsed(start) * 1e3, verifyExpenseRollup(root));
+    detachExpenseRollup();
+
+    freeExpenseTree(root);
+    free(ids);
+}
+
+// Time category-filtered queries with and without the category bitmaps: family category
+// totals over the member cursor, and one-week periods restricted to a category
+void benchCategoryFilters(void) {
+    int* ids = benchShuffledIDs(BENCH_EXPENSES, 42);
+    ExpenseNode* root = benchBuildTree(ids, BENCH_EXPENSES);
+    int queries = 2000;
+    const char* names[] = { "Index+bitmap", "Index", "Bitmap", "Scan" };
+
+    printf("\n=== Category Filters ===\n");
+    clock_t start = clock();
+    attachCategoryBitmaps(root);
+    long bytes = 0;
+    for (int category = RENT; category <= LEISURE; category++) {
+        const CategoryBitmap* bitmap = &categoryBitmaps[category];
+        for (int i = 0; i < bitmap->count; i++) {
+            const BitmapContainer* container = &bitmap->containers[i];
+            bytes += container->bits ? BITMAP_WORDS * 8 : container->capacity * 2;
+        }
+    }
+    printf("Bitmap build: %.1f ms, %.1f KB\n", benchElapsed(start) * 1e3, bytes / 1024.0);
+
+    // Every path runs the same first queries / 10 family queries (same seed) and the same
+    // period queries, and only those go into the checksum, so it must match across rows
+    int checked = queries / 10;
+    printf("%-14s %-16s %-16s %-12s\n", "Path", "Family (us)", "Period (us)", "Checksum");
+    for (int path = 0; path < 4; path++) {
+        if (path < 2) attachExpenseIndexes(root);
+        if (path % 2 == 0) attachCategoryBitmaps(root);
+        srand(5);
+        long long total = 0;
+        // The paths without the user index walk every record, so they get fewer queries
+        int familyQueries = path < 2 ? queries : queries / 10;
+        start = clock();
+        for (int q = 0; q < familyQueries; q++) {
+            int members[SCAN_MEMBERS];
+            for (int j = 0; j < SCAN_MEMBERS; j++) members[j] = rand() % BENCH_USERS + 1;
+            int category = rand() % MAX_CATEGORY + 1;
+            for (MemberExpenseCursor c = categoryMemberCursorStart(root, members, SCAN_MEMBERS, INT_MIN, category); memberCursorValid(&c); memberCursorNext(&c)) {
+                if (q < checked && c.rec.leaf->categories[c.rec.index] == (ExpenseCategory)category) total += c.rec.leaf->amounts[c.rec.index];
+            }
+        }
+        double familyTime = benchElapsed(start);
+        int periodQueries = checked;
+        srand(7);
+        start = clock();
+        for (int q = 0; q < periodQueries; q++) {
+            ExpenseList found;
+            initExpenseList(&found);
+            int from = 20250000 + (rand() % 12 + 1) * 100 + rand() % 21 + 1;
+            collectExpensesInDateRange(root, from, from + 6, (ExpenseCategory)(rand() % MAX_CATEGORY + 1), &found);
+            for (int i = 0; i < found.count; i++) total += found.items[i].amount;
+            freeExpenseList(&found);
+        }
+        printf("%-14s %-16.1f %-16.1f %-12.0f\n", names[path], familyTime * 1e6 / familyQueries,
+               benchElapsed(start) * 1e6 / periodQueries, centsToUnits(total));
+        detachExpenseIndexes();
+        detachCategoryBitmaps();
+    }
+
+    freeExpenseTree(root);
+    free(ids);
+}
+
+// Time grouping every record by day with the hash table against the linear search over
+// date strings that get_highest_expense_day used before, then ranking the top days
+void benchDayGrouping(void) {
+    int* ids = benchShuffledIDs(BENCH_EXPENSES, 42);
+    ExpenseNode* root = benchBuildTree(ids, BENCH_EXPENSES);
+
+    printf("\n=== Group By Day ===\n");
+    clock_t start = clock();
+    DayTotals days;
+    initDayTotals(&days);
+    for (ExpenseCursor c = expenseCursorFirst(root); expenseCursorValid(&c); expenseCursorNext(&c)) {
+        addDayTotal(&days, c.leaf->date_keys[c.index], c.leaf->amounts[c.index]);
+    }
+    double hashTime = benchElapsed(start);
+    TopK top;
+    initTopK(&top, 10);
+    start = clock();
+    offerDayTotals(&days, &top);
+    int ranked = topKFinish(&top);
+    double topTime = benchElapsed(start);
+
+    // The old way: one entry per date string, found by strcmp
+    typedef struct { char date[DATE_LENGTH]; long long total; } DateExpense;
+    DateExpense* list = (DateExpense*)malloc(days.days * sizeof(DateExpense));
+    int listed = 0;
+    start = clock();
+    for (ExpenseCursor c = expenseCursorFirst(root); expenseCursorValid(&c); expenseCursorNext(&c)) {
+        int k = 0;
+        while (k < listed && strcmp(list[k].date, c.leaf->dates[c.index]) != 0) k++;
+        if (k == listed) {
+            strcpy(list[listed].date, c.leaf->dates[c.index]);
+            list[listed++].total = 0;
+        }
+        list[k].total += c.leaf->amounts[c.index];
+    }
+    double linearTime = benchElapsed(start);
+
+    printf("%-10s %-12s %-12s\n", "Path", "Time (ms)", "Days");
+    printf("%-10s %-12.1f %-12d\n", "Hash", hashTime * 1e3, days.days);
+    printf("%-10s %-12.1f %-12d\n", "Linear", linearTime * 1e3, listed);
+    printf("Top %d of %d days in %.3f ms; highest %d: %.2f\n", ranked, days.days, topTime * 1e3,
+           top.items[0].id, centsToUnits(top.items[0].score));
+
+    freeTopK(&top);
+    free(list);
+    freeDayTotals(&days);
+    freeExpenseTree(root);
+    free(ids);
+}
+
+// Time the top-K rankings against sorting every candidate: the 10 biggest expenses from
+// the leaf chain, and the 10 biggest spenders from the rollup or from a rollup built on the spot
+void benchTopK(void) {
+    int* ids = benchShuffledIDs(BENCH_EXPENSES, 42);
+    ExpenseNode* root = benchBuildTree(ids, BENCH_EXPENSES);
+    TopK top;
+
+    printf("\n=== Top-K Rankings ===\n");
+    printf("%-28s %-12s %-12s\n", "Query", "Time (ms)", "Top score");
+    int sizes[] = { 10, 1000 };
+    for (int s = 0; s < 2; s++) {
+        initTopK(&top, sizes[s]);
+        clock_t start = clock();
+        rankExpensesByAmount(root, 0, &top);
+        topKFinish(&top);
+        printf("Top %-4d expenses (heap)     %-12.1f %-12.2f\n", sizes[s], benchElapsed(start) * 1e3, centsToUnits(top.items[0].score));
+        freeTopK(&top);
+    }
+
+    // Sorting everything, as a by-hand ranking would: the amount above the ID
+    long long* keys = (long long*)malloc(BENCH_EXPENSES * sizeof(long long));
+    clock_t start = clock();
+    int n = 0;
+    for (ExpenseCursor c = expenseCursorFirst(root); expenseCursorValid(&c); expenseCursorNext(&c)) {
+        keys[n++] = makeIndexKey((int)c.leaf->amounts[c.index], c.leaf->keys[c.index]);
+    }
+    sortIndexKeys(keys, n);
+    printf("%-28s %-12.1f %-12.2f\n", "All expenses (full sort)", benchElapsed(start) * 1e3, indexKeyMajor(keys[n - 1]) / 100.0);
+    free(keys);
+
+    for (int path = 0; path < 2; path++) {
+        if (path == 0) attachExpenseRollup(root);
+        initTopK(&top, 10);
+        start = clock();
+        rankUsersBySpend(root, NULL, 0, &top);
+        topKFinish(&top);
+        printf("%-28s %-12.1f %-12.2f\n", path == 0 ? "Top 10 spenders (rollup)" : "Top 10 spenders (rebuild)",
+               benchElapsed(start) * 1e3, centsToUnits(top.items[0].score));
+        freeTopK(&top);
+        if (path == 0) detachExpenseRollup();
+    }
+
+    freeExpenseTree(root);
+    free(ids);
+}
+
+// Time deleting half of a large family tree: one top-down delete per family in random
+// order, against one batch that rebuilds the survivors bottom-up
+void benchFamilyDelete(void) {
+    int families = 200000;
+    int* ids = benchShuffledIDs(families, 42);
+    Family** sorted = (Family**)malloc(families * sizeof(Family*));
+    if (!sorted) {
+        printf("Memory allocation failed\n");
+        exit(1);
+    }
+
+    printf("\n=== Family Delete ===\n");
+    printf("%-14s %-12s %-12s\n", "Path", "Time (ms)", "Left");
+    for (int path = 0; path < 2; path++) {
+        // The deletes free their families, so each path starts from new records
+        for (int i = 0; i < families; i++) sorted[i] = createFamilyN(i + 1, "bench");
+        FamilyTree tree = { buildFamilyTree(sorted, families), families };
+        clock_t start = clock();
+        if (path == 0) {
+            for (int i = 0; i < families / 2; i++) deleteFamilyFromTree(&tree, ids[i]);
+        } else {
+            deleteFamiliesFromTree(&tree, ids, families / 2);
+        }
+        printf("%-14s %-12.1f %-12d\n", path == 0 ? "One by one" : "Batch", benchElapsed(start) * 1e3, tree.count);
+        int left = collectFamilies(tree.root, sorted, 0);
+        for (int i = 0; i < left; i++) freeFamily(sorted[i]);
+        freeFamilyNodes(tree.root);
+    }
+
+    free(sorted);
+    free(ids);
+    poolReleaseAll(&familyNodePool);
+}
+
+void benchFreeFamilies(FamilyNode* node) {
+    if (!node) return;
+    for (int i = 0; i < node->num_keys; i++) freeFamily(node->families[i]);
+    if (!node->is_leaf) {
+        for (int i = 0; i <= node->num_keys; i++) benchFreeFamilies(node->children[i]);
+    }
+}
+
+// Time keeping family expense totals current across expense edits: recomputing the old and
+// new owners' families after each edit (over the leaf chain, then through the user index)
+// against the +/- deltas the expense hooks apply
+void benchFamilyTotals(void) {
+    int* ids = benchShuffledIDs(BENCH_EXPENSES, 42);
+    ExpenseNode* root = benchBuildTree(ids, BENCH_EXPENSES);
+    int families = BENCH_USERS / BENCH_FAMILY_MEMBERS;
+
+    // One family for every BENCH_FAMILY_MEMBERS consecutive users
+    char name[MAX_NAME_LENGTH] = "bench";
+    UserNode* users = NULL;
+    for (int u = 1; u <= BENCH_USERS; u++) users = insertUser(users, u, name, 0);
+    FamilyTree* tree = createFamilyTree();
+    for (int i = 0; i < families; i++) {
+        Family* family = createFamilyN(i + 1, name);
+        for (int j = 0; j < BENCH_FAMILY_MEMBERS; j++) {
+            addFamilyMember(family, userHandleOf(findUserById(users, i * BENCH_FAMILY_MEMBERS + j + 1)));
+        }
+        insertFamily(tree, i + 1, family);
+        mapFamilyMembers(family);
+    }
+
+    printf("\n=== Family Totals ===\n");
+    printf("Family record: %d bytes, %d members inline\n", (int)sizeof(Family), FAMILY_INLINE_MEMBERS);
+    clock_t start = clock();
+    attachFamilyExpenseTotals(tree, root);
+    printf("One-pass build: %.1f ms for %d families\n", benchElapsed(start) * 1e3, families);
+    detachFamilyExpenseTotals();
+
+    // A rescan costs far more per edit, so those paths get fewer edits
+    int edits[] = { 100, 1000, 200000 };
+    const char* names[] = { "Rescan", "Rescan+index", "Delta" };
+    printf("%-14s %-16s\n", "Path", "Edit (us)");
+    for (int path = 0; path < 3; path++) {
+        if (path == 1) attachExpenseIndexes(root);
+        if (path == 2) attachFamilyExpenseTotals(tree, root);
+        Expense* changes = benchMakeExpenses(ids, edits[path]);
+        srand(9);
+        for (int i = 0; i < edits[path]; i++) {
+            changes[i].user_id = rand() % BENCH_USERS + 1;
+            changes[i].amount = rand() % 100000;
+        }
+        start = clock();
+        for (int i = 0; i < edits[path]; i++) {
+            if (path == 2) {
+                UpdateExpenseRecord(root, changes[i]);
+                continue;
+            }
+            ExpenseLeafNode* leaf = findExpenseLeaf(root, changes[i].expense_id);
+            Expense previous = getLeafExpense(leaf, findPosition(&leaf->header, changes[i].expense_id));
+            UpdateExpenseRecord(root, changes[i]);
+            Family* family = familyOfUser(previous.user_id);
+            family->total_monthly_expense = calculateTotalMonthlyExpense(root, family);
+            if (familyOfUser(changes[i].user_id) != family) {
+                family = familyOfUser(changes[i].user_id);
+                family->total_monthly_expense = calculateTotalMonthlyExpense(root, family);
+            }
+        }
+        printf("%-14s %-16.2f\n", names[path], benchElapsed(start) * 1e6 / edits[path]);
+        free(changes);
+        if (path == 1) detachExpenseIndexes();
+    }
+    printf("Rescan mismatches after the delta edits: %d\n", verifyFamilyExpenseTotals(tree, root));
+    detachFamilyExpenseTotals();
+
+    releaseUserFamilies();
+    benchFreeFamilies(tree->root);
+    free(tree);
+    poolReleaseAll(&familyNodePool);
+    poolReleaseAll(&userNodePool);
+    releaseUserSlots();
+    freeExpenseTree(root);
+    free(ids);
+}
+
+// Function to time one parse-only pass over a data file with the tokenizer (kind 0: expenses,
+// 1: individuals, 2: families) and with the fgets + sscanf parsing the loaders used before
+void benchParseFile(const char* filename, int kind, long bytes, double* tokenizerMBps, double* sscanfMBps) {
+    LineReader reader;
+    const char *line, *lineEnd;
+    Expense expense;
+    Family family;
+    int members[128]; // Room for every member ID a 256-byte line can hold
+    int user_id;
+    char user_name[MAX_NAME_LENGTH];
+    long long income;
+    double units[2];
+    long parsed = 0;
+
+    clock_t start = clock();
+    lineReaderOpen(&reader, filename);
+    while (lineReaderNext(&reader, &line, &lineEnd)) {
+        if (kind == 0) parsed += parseExpenseLine(line, lineEnd, &expense);
+        else if (kind == 1) parsed += parseUserLine(line, lineEnd, &user_id, user_name, &income);
+        else parsed += parseFamilyLine(line, lineEnd, &family, user_name, members, 128);
+    }
+    lineReaderClose(&reader);
+    *tokenizerMBps = bytes / 1e6 / benchElapsed(start);
+
+    char buf[256];
+    FILE* file = fopen(filename, "r");
+    start = clock();
+    while (fgets(buf, sizeof(buf), file)) {
+        if (kind == 0) {
+            parsed -= sscanf(buf, "%d %d %d %lf %s", &expense.expense_id, &expense.user_id,
+                             (int*)&expense.category, &units[0], expense.date) == 5;
+            expense.amount = unitsToCents(units[0]);
+        } else if (kind == 1) {
+            parsed -= sscanf(buf, "%d, %49[^,], %lf", &user_id, user_name, &units[0]) == 3;
+            income = unitsToCents(units[0]);
+        } else {
+            int count = sscanf(buf, "%d,%49[^,],%d,%lf,%lf", &family.family_id, user_name,
+                               &family.member_count, &units[0], &units[1]);
+            family.total_income = unitsToCents(units[0]);
+            family.total_monthly_expense = unitsToCents(units[1]);
+            char* ptr = buf;
+            for (int i = 0; i < 5 && ptr; i++) ptr = strchr(ptr + 1, ',');
+            for (int i = 0; ptr && i < family.member_count && i < 128; i++) {
+                sscanf(ptr + 1, "%d", &members[i]);
+                ptr = strchr(ptr + 1, ',');
+            }
+            parsed -= count == 5;
+        }
+    }
+    fclose(file);
+    *sscanfMBps = bytes / 1e6 / benchElapsed(start);
+    if (parsed != 0) printf("Warning: parsers disagree on %s\n", filename);
+}
+
+// Measure loader throughput for each data file type on synthetic files
+void benchLoaders(void) {
+    const char* files[] = { "bench_expenses.txt", "bench_individuals.txt", "bench_families.txt" };
+    int rows[] = { BENCH_EXPENSES, 200000, 200000 };
+
+    FILE* out = fopen(files[0], "w");
+    for (int i = 0; i < rows[0]; i++) {
+        fprintf(out, "%d %d %d %.2f 2025-%02d-%02d\n", i + 1, i % BENCH_USERS + 1, i % MAX_CATEGORY + 1,
+                (i % 100000) / 100.0, i % 12 + 1, i % 28 + 1);
+    }
+    fclose(out);
+    out = fopen(files[1], "w");
+    for (int i = 0; i < rows[1]; i++) {
+        fprintf(out, "%d,User%d,%.2f\n", i + 1, i + 1, (i % 1000000) / 100.0);
+    }
+    fclose(out);
+    out = fopen(files[2], "w");
+    for (int i = 0; i < rows[2]; i++) {
+        int first = (i * BENCH_FAMILY_MEMBERS) % rows[1] + 1;
+        fprintf(out, "%d,Family%d,%d,%.2f,%.2f,%d,%d,%d,%d\n", i + 1, i + 1, BENCH_FAMILY_MEMBERS,
+                (i % 100000) * 4 / 100.0, (i % 100000) / 100.0, first, first + 1, first + 2, first + 3);
+    }
+    fclose(out);
+
+    printf("\n=== Loader Throughput ===\n");
+    printf("%-24s %-10s %-16s %-16s %-16s\n", "File", "MB", "Tokenizer MB/s", "sscanf MB/s", "Load MB/s");
+    ExpenseNode* expenseRoot = NULL;
+    UserNode* userRoot = NULL;
+    FamilyTree* familyTree = NULL;
+    for (int k = 0; k < 3; k++) {
+        LineReader reader;
+        const char *line, *lineEnd;
+        lineReaderOpen(&reader, files[k]);
+        while (lineReaderNext(&reader, &line, &lineEnd)) {
+        }
+        long bytes = reader.bytes;
+        lineReaderClose(&reader);
+
+        double tokenizerMBps, sscanfMBps;
+        benchParseFile(files[k], k, bytes, &tokenizerMBps, &sscanfMBps);
+
+        clock_t start = clock();
+        if (k == 0) readExpensesFromFile(&expenseRoot, files[k]);
+        else if (k == 1) userRoot = loadUsersFromFile(files[k], userRoot);
+        else familyTree = loadFamiliesFromFile(files[k], userRoot);
+        double loadMBps = bytes / 1e6 / benchElapsed(start);
+
+        printf("%-24s %-10.1f %-16.1f %-16.1f %-16.1f\n", files[k], bytes / 1e6,
+               tokenizerMBps, sscanfMBps, loadMBps);
+        remove(files[k]);
+    }
+
+    freeExpenseTree(expenseRoot);
+    benchFreeFamilies(familyTree->root);
+    free(familyTree);
+    releaseUserFamilies();
+    poolReleaseAll(&familyNodePool);
+    poolReleaseAll(&userNodePool);
+    releaseUserSlots();
+}
+
+int main() {
+    benchExpenseFanout();
+    benchNodeSearch();
+    benchBulkLoad();
+    benchAppendIngest();
+    benchRangeAggregate();
+    benchLeafScan();
+    benchPeriodQuery();
+    benchMonthReport();
+    benchRollupReports();
+    benchCategoryFilters();
+    benchDayGrouping();
+    benchTopK();
+    benchFamilyTotals();
+    benchFamilyDelete();
+    benchLoaders();
+    return 0;
+}
+#else
 int main() {
     // Initialize data structures
     UserNode* userRoot = NULL;
@@ -3313,7 +8026,14 @@ int main() {
     printf("Loading data...\n");
     userRoot = loadUsersFromFile(usersFile, userRoot);
     readExpensesFromFile(&expenseRoot, expensesFile);
+    attachExpenseIndexes(expenseRoot);
+    attachExpenseRollup(expenseRoot);
+    attachCategoryBitmaps(expenseRoot);
+#ifdef EXPENSE_PARTITIONED
+    attachExpensePartitions(expenseRoot);
+#endif
     familyTree = loadFamiliesFromFile(familiesFile, userRoot);
+    attachFamilyExpenseTotals(familyTree, expenseRoot);
     printf("Data loaded successfully.\n\n");
 
     int choice;
@@ -3332,8 +8052,11 @@ int main() {
         printf("11. Get Expenses in Date Range\n");
         printf("12. Get Expenses in ID Range\n");
         printf("13. Update/Delete Records\n");
-        printf("14. Exit\n");
-        printf("Enter your choice (1-14): ");
+        printf("14. Show Latest Expenses\n");
+        printf("15. Get Expense Totals in ID Range\n");
+        printf("16. Show Top Rankings\n");
+        printf("17. Exit\n");
+        printf("Enter your choice (1-17): ");
         
         if (scanf("%d", &choice) != 1) {
             printf("Invalid input! Please enter a number.\n");
@@ -3399,7 +8122,7 @@ int main() {
                 printFamiliesTable(familyTree);
                 printf("Enter Family ID: ");
                 scanf("%d", &family_id);
-                get_highest_expense_day(familyTree, expenseRoot, family_id);
+                get_highest_expense_day(familyTree, expenseRoot, family_id, 0);
                 break;
             }
 
@@ -3454,7 +8177,7 @@ int main() {
                     case 1: { // Update User
                         int user_id;
                         char new_name[MAX_NAME_LENGTH];
-                        float new_income;
+                        double new_income;
                         
                         printUserTable(userRoot);
                         printf("Enter User ID to update: ");
@@ -3462,9 +8185,9 @@ int main() {
                         printf("Enter new name: ");
                         scanf(" %49[^\n]", new_name);
                         printf("Enter new income: ");
-                        scanf("%f", &new_income);
+                        scanf("%lf", &new_income);
                         
-                        userRoot = updateUser(userRoot, user_id, new_name, new_income);
+                        userRoot = updateUser(userRoot, user_id, new_name, unitsToCents(new_income));
                         saveUsersToFile(userRoot, usersFile);
                         break;
                     }
@@ -3482,7 +8205,7 @@ int main() {
                         }
 
                         // Remove from families
-                        removeUserFromFamilies(familyTree, user_id);
+                        removeUserFromFamilies(familyTree, expenseRoot, user_id);
                         
                         // Delete from AVL tree
                         userRoot = deleteUserNode(userRoot, user_id);
@@ -3507,7 +8230,7 @@ int main() {
                         
                         Family* family = searchFamily(familyTree->root, family_id);
                         if (family) {
-                            strcpy(family->family_name, new_name);
+                            setFamilyName(family, new_name);
                             saveFamiliesToFile(familyTree, familiesFile, tempFile);
                         } else {
                             printf("Family not found!\n");
@@ -3533,18 +8256,20 @@ int main() {
                         printf("Enter Expense ID to update: ");
                         scanf("%d", &expense_id);
                         
-                        Expense* exp = FindExpenseByID(expenseRoot, expense_id);
-                        if (exp) {
+                        Expense found;
+                        Expense* exp = &found;
+                        if (FindExpenseByID(expenseRoot, expense_id, exp)) {
                             printf("Enter new amount (-1 to keep current): ");
-                            float new_amount;
-                            scanf("%f", &new_amount);
-                            if (new_amount != -1) exp->amount = new_amount;
+                            double new_amount;
+                            scanf("%lf", &new_amount);
+                            if (new_amount != -1) exp->amount = unitsToCents(new_amount);
                             
                             printf("Enter new category (1-5, -1 to keep): ");
                             int new_cat;
                             scanf("%d", &new_cat);
                             if (new_cat != -1) exp->category = (ExpenseCategory)new_cat;
                             
+                            UpdateExpenseRecord(expenseRoot, *exp);
                             writeExpensesToFile(expenseRoot, expensesFile);
                             printf("Expense updated successfully.\n");
                         } else {
@@ -3558,14 +8283,13 @@ int main() {
                         printf("Enter Expense ID to delete: ");
                         scanf("%d", &expense_id);
                         
-                        Expense* exp = FindExpenseByID(expenseRoot, expense_id);
-                        if (exp) {
-                            int user_id = exp->user_id;
+                        Expense found;
+                        Expense* exp = &found;
+                        if (FindExpenseByID(expenseRoot, expense_id, exp)) {
                             DeleteExpense(&expenseRoot, expense_id);
                             writeExpensesToFile(expenseRoot, expensesFile);
                             
-                            // Update family expenses
-                            UpdateFamilyExpenses(familyTree, expenseRoot, user_id);
+                            // The family total was adjusted by the delete itself
                             saveFamiliesToFile(familyTree, familiesFile, tempFile);
                             printf("Expense deleted successfully.\n");
                         } else {
@@ -3579,18 +8303,67 @@ int main() {
                 break;
             }
 
-            case 14: // Exit
+            case 14: { // Show Latest Expenses
+                int n;
+                printf("How many of the latest expenses to show: ");
+                scanf("%d", &n);
+                get_latest_expenses(expenseRoot, n);
+                break;
+            }
+
+            case 15: { // Get Expense Totals in ID Range
+                int start_id, end_id;
+                printf("Enter Start Expense ID: ");
+                scanf("%d", &start_id);
+                printf("Enter End Expense ID: ");
+                scanf("%d", &end_id);
+                get_expense_totals_in_range(expenseRoot, start_id, end_id);
+                break;
+            }
+
+            case 16: { // Show Top Rankings
+                int kind, k, month, year, family_id = 0;
+                printf("1. Biggest Expenses\n2. Top Spenders\n3. Top Families\n4. Top Expense Days\n");
+                printf("Choice: ");
+                scanf("%d", &kind);
+                printf("How many to show: ");
+                scanf("%d", &k);
+                printf("Enter month (1-12, 0 for all time): ");
+                scanf("%d", &month);
+                year = 0;
+                if (month != 0) {
+                    printf("Enter year: ");
+                    scanf("%d", &year);
+                }
+                if (kind == RANK_USERS || kind == RANK_DAYS) {
+                    printf("Enter Family ID (0 for all families): ");
+                    scanf("%d", &family_id);
+                }
+                get_top_rankings(userRoot, familyTree, expenseRoot, (RankingKind)kind, k, family_id, month, year);
+                break;
+            }
+
+            case 17: // Exit
                 printf("\nSaving data...\n");
                 saveUsersToFile(userRoot, usersFile);
                 writeExpensesToFile(expenseRoot, expensesFile);
                 saveFamiliesToFile(familyTree, familiesFile, tempFile);
+                detachExpenseRollup();
+                detachCategoryBitmaps();
+                releaseUserFamilies();
+                releaseNodePools();
                 printf("Goodbye!\n");
                 exit(0);
 
             default:
                 printf("Invalid choice! Please try again.\n");
         }
+#ifdef EXPENSE_VERIFY_FAMILY_TOTALS
+        // Check the maintained family totals against a full recompute after every command
+        verifyFamilyExpenseTotals(familyTree, expenseRoot);
+#endif
     }
 
     return 0;
 }
+#endif